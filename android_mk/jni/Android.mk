@@ -6,7 +6,9 @@ LOCAL_C_INCLUDES := \
     ../source/
 LOCAL_SRC_FILES:= \
     ../../apps/synthmark.cpp \
+    ../../source/tools/CpuFrequencyEstimator.cpp \
     ../../source/tools/HostTools.cpp \
+    ../../source/tools/PerfCounterAnalyzer.cpp \
     ../../source/aaudio/AAudioHostThread.cpp
 LOCAL_CFLAGS += -g -std=c++11 -Ofast -Wall -Werror
 LOCAL_LDLIBS := -laaudio
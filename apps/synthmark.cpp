@@ -25,14 +25,28 @@
 #include "synth/IncludeMeOnce.h"
 #include "synth/Synthesizer.h"
 #include "tools/ClockRampHarness.h"
+#include "tools/CpuFrequencyEstimator.h"
+#include "tools/DmaAudioSink.h"
+#include "tools/FileAudioSink.h"
+#include "tools/HardwareTimingModel.h"
 #include "tools/JitterMarkHarness.h"
 #include "tools/ITestHarness.h"
 #include "tools/LatencyMarkHarness.h"
+#include "tools/OfflineAudioSink.h"
+#include "tools/GraphMarkHarness.h"
+#include "tools/MultiStreamHarness.h"
+#include "tools/PerfCounterAnalyzer.h"
+#include "tools/PluginHostHarness.h"
+#include "tools/SyncMarkHarness.h"
+#include "tools/WakeupMarkHarness.h"
+#include "tools/ThroughputHarness.h"
 #include "tools/TimingAnalyzer.h"
+#include "tools/TraceReplayHarness.h"
 #include "tools/UtilizationMarkHarness.h"
 #include "tools/UtilizationSeriesHarness.h"
 #include "tools/VirtualAudioSink.h"
 #include "tools/VoiceMarkHarness.h"
+#include "tools/VoiceMarkSeriesHarness.h"
 
 constexpr char kDefaultTestCode         = 'v';
 constexpr int  kDefaultSeconds          = 10;
@@ -41,22 +55,34 @@ constexpr int  kDefaultBufferSizeBursts = 1;
 constexpr int  kDefaultNumVoices        = 8;
 constexpr int  kDefaultNoteOnDelay      = 0;
 constexpr int  kDefaultPercentCpu       = 50;
+constexpr int  kDefaultOversampling     = 1;
+constexpr int  kDefaultChannelCount     = SAMPLES_PER_FRAME;
+constexpr int  kDefaultNumStreams       = 2;
+constexpr int  kDefaultNumInstances     = 32;
 
 void usage(const char *name) {
     printf("SynthMark version %d.%d\n", SYNTHMARK_MAJOR_VERSION, SYNTHMARK_MINOR_VERSION);
     printf("%s -t{test} -n{numVoices} -d{noteOnDelay} -p{percentCPU} -r{sampleRate}"
            " -s{seconds} -b{burstSize} -c{cpuAffinity}\n", name);
     printf("    -t{test}, v=voice, l=latency, j=jitter, u=utilization"
-           ", s=series_util, c=clock_ramp, default is %c\n",
+           ", s=series_util, c=clock_ramp,\n"
+           "      o=offline throughput, m=multiple streams, p=plugin host, g=graph,\n"
+           "      b=thread wakeup primitives, w=wakeup handoff mechanisms, r=replay trace,\n"
+           "      default is %c\n",
            kDefaultTestCode);
     printf("    -n{numVoices} to render, default = %d\n", kDefaultNumVoices);
-    printf("    -N{numVoices} to render for toggling high load, LatencyMark only\n");
+    printf("    -N{numVoices} to render for toggling high load, LatencyMark only,\n"
+           "      or the voices of the last stream for -tm\n");
     printf("    -m{voicesMode} algorithm to choose the number of voices in the range\n"
            "      [-n, -N]. This value can be 'l' for a linear increment, 'r' for a\n"
            "      random choice, or 's' to switch between -n and -N. default = s\n");
     printf("    -d{noteOnDelay} seconds to delay the first NoteOn, default = %d\n",
            kDefaultNoteOnDelay);
     printf("    -w{workloadHintsEnabled} 0 = no (default), 1 = give workload hints to scheduler\n");
+    printf("    -k{perfCountersEnabled} 0 = no (default), 1 = count cycles, cache misses, etc.\n"
+           "      of each burst with perf_event_open\n");
+    printf("    -f{frequencyEnabled} 0 = no (default), 1 = estimate the CPU frequency of each\n"
+           "      burst from the cycle counter, or from a short spin loop if there is none\n");
     printf("    -p{percentCPU} target load, default = %d\n", kDefaultPercentCpu);
     printf("    -r{sampleRate} should be typical, 44100, 48000, etc. default is %d\n",
            kSynthmarkSampleRate);
@@ -68,6 +94,54 @@ void usage(const char *name) {
            kDefaultBufferSizeBursts);
     printf("    -c{cpuAffinity} index of CPU to run on, default = UNSPECIFIED\n");
     printf("    -a{enable} 0 for normal thread, 1 for audio callback, default = 1\n");
+    printf("    -F{sampleType} f=float, d=double, q=Q31, h=Q15 fixed-point,\n"
+           "      a=all, VoiceMark only, default = f\n");
+    printf("    -o{oversampling} render voices at 1, 2, 4 or 8 times the sample rate,\n"
+           "      0=all, VoiceMark only, default = %d\n", kDefaultOversampling);
+    printf("    -e{effects} master effects after the mix, any of c=chorus, d=delay,\n"
+           "      r=reverb, v=convolution, for example -ecdr, default = none\n");
+    printf("    -C{channels} output channels, 1 to %d, 4, 9 or 16 for ambisonics,"
+           " default = %d\n", kSynthmarkMaxChannels, kDefaultChannelCount);
+    printf("    -H{model} simulate irregular hardware timing, comma separated list of\n"
+           "      d{ppm} clock drift, j{usec} uniform or g{usec} gaussian jitter,\n"
+           "      u{msec} read in large chunks, p{msec} stall period, l{msec} stall length,\n"
+           "      for example -Hd200,g300,u10,p1000,l20, default = ideal\n");
+    printf("    -L{bursts} render this many bursts ahead on a helper thread, 0 to %d,\n"
+           "      default = 0 renders in the callback\n", kPipelineMaxDepth);
+    printf("    -R{enable} 1 to request random callback sizes that average one burst,"
+           " default = 0\n");
+    printf("    -S{streams} independent synthesizers for -tm, 1 to %d, default = %d\n",
+           kMultiStreamMaxStreams, kDefaultNumStreams);
+    printf("    -P{instances} synthesizers rendered each burst for -tp, 1 to %d, default = %d\n",
+           kPluginHostMaxInstances, kDefaultNumInstances);
+    printf("    -K{threads} maximum render threads for -tp, render threads for -tg,\n"
+           "      default = number of CPUs\n");
+    printf("    -G{shape}{size} graph for -tg, w=wide voices, d=deep effects chain,\n"
+           "      m=diamond of parallel effects, size 1 to %d, default = w%d\n",
+           kGraphMaxSize, kDefaultGraphSize);
+    printf("    -W{strategy} how to sleep until the next burst, u=usleep (default),\n"
+           "      n=clock_nanosleep, t=timerfd with epoll, h{usec}=nanosleep then spin\n"
+           "      for the last usec, default spin = %d\n",
+           (int) (kDefaultSleepSpinNanos / SYNTHMARK_NANOS_PER_MICROSECOND));
+    printf("    -T{nanos} timer slack for sleeping threads, default = 0 for the kernel default\n");
+    printf("    -E{rate} note events per second from each control thread, default = 0 for none\n");
+    printf("    -M{file} play a Standard MIDI File in a loop instead of toggling all notes,\n"
+           "      -n limits the polyphony\n");
+    printf("    -X{percent} tempo of the MIDI file, %d to %d, default = 100\n",
+           kMidiMinTempoPercent, kMidiMaxTempoPercent);
+    printf("    -Y{file} workload trace to replay with -tr, otherwise capture the\n"
+           "      notes and render time of each burst, -tv, -tj, -tc or -tu only\n");
+    printf("    -Z{file} save the timing of the last %d bursts, and of those before the\n"
+           "      first glitch, -tv, -tj, -tc, -tu or -tr, -tl saves only glitched runs\n",
+           kFlightRecorderCapacity);
+    printf("    -Q{queue}{threads} note event queue, l=lock-free (default), m=mutex,\n"
+           "      and number of control threads, 1 to %d, default = 1\n",
+           kNoteEventMaxProducers);
+    printf("    -D{enable} 1 to consume the audio on a simulated DMA thread, default = 0\n");
+    printf("    -O{file} save the output as 32-bit float, WAV if the name ends in .wav,\n"
+           "      otherwise raw, not with -to\n");
+    printf("    -I{seconds} impulse response length for convolution, 1 to 5, default = %d\n",
+           (int) kDefaultImpulseSeconds);
 }
 
 #define TEXT_ERROR "ERROR: "
@@ -89,6 +163,64 @@ long stringToPositiveInteger(const char *input, const char *message) {
     return result;
 }
 
+/**
+ * Parameters for the hardware timing model, in the units used on the command line.
+ */
+struct TimingModelOptions {
+    int32_t driftPpm = 0;
+    HardwareTimingModel::JitterType jitterType = HardwareTimingModel::JitterType::None;
+    int32_t jitterMicros = 0;
+    int32_t readMillis = 0;
+    int32_t stallPeriodMillis = 0;
+    int32_t stallLengthMillis = 0;
+};
+
+/**
+ * Parse a comma separated list like "d100,g300,u10,p1000,l20".
+ * @return true if valid, otherwise print an error and return false
+ */
+bool parseTimingModel(const char *spec, TimingModelOptions *options) {
+    const char *cursor = spec;
+    while (*cursor != 0) {
+        char key = *cursor++;
+        char *end;
+        errno = 0;
+        long value = strtol(cursor, &end, 10);
+        if (errno != 0 || end == cursor || (*end != ',' && *end != 0)
+                || (value < 0 && key != 'd')) {
+            printf(TEXT_ERROR "hardware model %s invalid near '%c'\n", spec, key);
+            return false;
+        }
+        switch (key) {
+            case 'd':
+                options->driftPpm = (int32_t) value;
+                break;
+            case 'j':
+                options->jitterType = HardwareTimingModel::JitterType::Uniform;
+                options->jitterMicros = (int32_t) value;
+                break;
+            case 'g':
+                options->jitterType = HardwareTimingModel::JitterType::Gaussian;
+                options->jitterMicros = (int32_t) value;
+                break;
+            case 'u':
+                options->readMillis = (int32_t) value;
+                break;
+            case 'p':
+                options->stallPeriodMillis = (int32_t) value;
+                break;
+            case 'l':
+                options->stallLengthMillis = (int32_t) value;
+                break;
+            default:
+                printf(TEXT_ERROR "hardware model %s has unknown key '%c'\n", spec, key);
+                return false;
+        }
+        cursor = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     int32_t percentCpu = kDefaultPercentCpu;
@@ -101,14 +233,47 @@ int main(int argc, char **argv)
     int32_t cpuAffinity = SYNTHMARK_CPU_UNSPECIFIED;
     bool    useAudioThread = true;
     bool    workloadHintsEnabled = false;
+    bool    perfCountersEnabled = false;
+    bool    frequencyEnabled = false;
     int32_t bufferSizeBursts = kDefaultBufferSizeBursts;
     VoicesMode voicesMode = VOICES_UNDEFINED;
     char testCode = kDefaultTestCode;
+    SampleType sampleType = SampleType::Float;
+    bool    allSampleTypes = false;
+    int32_t oversampling = kDefaultOversampling;
+    int32_t effectsFlags = EFFECTS_NONE;
+    int32_t impulseSeconds = (int32_t) kDefaultImpulseSeconds;
+    int32_t channelCount = kDefaultChannelCount;
+    const char *outputFileName = nullptr;
+    bool    useDmaThread = false;
+    TimingModelOptions timingOptions;
+    bool    randomCallbackSizes = false;
+    int32_t pipelineDepth = 0;
+    int32_t numStreams = kDefaultNumStreams;
+    SleepStrategy sleepStrategy = SleepStrategy::USleep;
+    int64_t sleepSpinNanos = kDefaultSleepSpinNanos;
+    int64_t timerSlackNanos = 0;
+    int32_t numInstances = kDefaultNumInstances;
+    GraphShape graphShape = GraphShape::Wide;
+    int32_t graphSize = kDefaultGraphSize;
+    int32_t maxThreads = (HostTools::getCpuCount() > 0) ? HostTools::getCpuCount() : 1;
+    int32_t eventsPerSecond = 0;
+    NoteQueueType noteQueueType = NoteQueueType::LockFree;
+    int32_t numEventProducers = 1;
+    const char *midiFileName = nullptr;
+    int32_t midiTempoPercent = 100;
+    const char *traceFileName = nullptr;
+    const char *flightFileName = nullptr;
 
     ITestHarness *harness = nullptr;
+    TestHarnessBase *captureHarness = nullptr;
+    TestHarnessParameters *flightHarness = nullptr;
 
     SynthMarkResult result;
     VirtualAudioSink audioSink;
+    FileAudioSink fileSink;
+    DmaAudioSink dmaSink;
+    OfflineAudioSink offlineSink;
 
     printf("# SynthMark V%d.%d\n", SYNTHMARK_MAJOR_VERSION, SYNTHMARK_MINOR_VERSION);
 
@@ -172,6 +337,182 @@ int main(int argc, char **argv)
                     if (temp < 0) return 1;
                     workloadHintsEnabled = (temp > 0);
                     break;
+                case 'k':
+                    temp = stringToPositiveInteger(&arg[2], "-k");
+                    if (temp < 0) return 1;
+                    perfCountersEnabled = (temp > 0);
+                    break;
+                case 'f':
+                    temp = stringToPositiveInteger(&arg[2], "-f");
+                    if (temp < 0) return 1;
+                    frequencyEnabled = (temp > 0);
+                    break;
+                case 'o':
+                    if ((oversampling = stringToPositiveInteger(&arg[2], "-o")) < 0) return 1;
+                    break;
+                case 'e':
+                    for (const char *c = &arg[2]; *c != 0; c++) {
+                        switch (*c) {
+                            case 'c':
+                                effectsFlags |= EFFECTS_CHORUS;
+                                break;
+                            case 'd':
+                                effectsFlags |= EFFECTS_DELAY;
+                                break;
+                            case 'r':
+                                effectsFlags |= EFFECTS_REVERB;
+                                break;
+                            case 'v':
+                                effectsFlags |= EFFECTS_CONVOLUTION;
+                                break;
+                            default:
+                                printf(TEXT_ERROR "Invalid effect: %s\n", arg);
+                                usage(argv[0]);
+                                return 1;
+                        }
+                    }
+                    break;
+                case 'C':
+                    if ((channelCount = stringToPositiveInteger(&arg[2], "-C")) < 0) return 1;
+                    break;
+                case 'H':
+                    if (!parseTimingModel(&arg[2], &timingOptions)) {
+                        usage(argv[0]);
+                        return 1;
+                    }
+                    break;
+                case 'L':
+                    if ((pipelineDepth = stringToPositiveInteger(&arg[2], "-L")) < 0) return 1;
+                    break;
+                case 'R':
+                    temp = stringToPositiveInteger(&arg[2], "-R");
+                    if (temp < 0) return 1;
+                    randomCallbackSizes = (temp > 0);
+                    break;
+                case 'S':
+                    if ((numStreams = stringToPositiveInteger(&arg[2], "-S")) < 0) return 1;
+                    break;
+                case 'P':
+                    if ((numInstances = stringToPositiveInteger(&arg[2], "-P")) < 0) return 1;
+                    break;
+                case 'K':
+                    if ((maxThreads = stringToPositiveInteger(&arg[2], "-K")) < 0) return 1;
+                    break;
+                case 'G':
+                    switch (arg[2]) {
+                        case 'w':
+                            graphShape = GraphShape::Wide;
+                            break;
+                        case 'd':
+                            graphShape = GraphShape::Deep;
+                            break;
+                        case 'm':
+                            graphShape = GraphShape::Diamond;
+                            break;
+                        default:
+                            printf(TEXT_ERROR "invalid graph shape %c\n", arg[2]);
+                            usage(argv[0]);
+                            return 1;
+                    }
+                    if (arg[3] != 0
+                            && (graphSize = stringToPositiveInteger(&arg[3], "-G")) < 0) {
+                        return 1;
+                    }
+                    break;
+                case 'M':
+                    midiFileName = &arg[2];
+                    break;
+                case 'Y':
+                    traceFileName = &arg[2];
+                    break;
+                case 'Z':
+                    flightFileName = &arg[2];
+                    break;
+                case 'X':
+                    if ((midiTempoPercent = stringToPositiveInteger(&arg[2], "-X")) < 0) return 1;
+                    break;
+                case 'E':
+                    if ((eventsPerSecond = stringToPositiveInteger(&arg[2], "-E")) < 0) return 1;
+                    break;
+                case 'Q':
+                    switch (arg[2]) {
+                        case 'l':
+                            noteQueueType = NoteQueueType::LockFree;
+                            break;
+                        case 'm':
+                            noteQueueType = NoteQueueType::Mutex;
+                            break;
+                        default:
+                            printf(TEXT_ERROR "invalid note queue %c\n", arg[2]);
+                            usage(argv[0]);
+                            return 1;
+                    }
+                    if (arg[3] != 0
+                            && (numEventProducers = stringToPositiveInteger(&arg[3], "-Q")) < 0) {
+                        return 1;
+                    }
+                    break;
+                case 'W':
+                    switch (arg[2]) {
+                        case 'u':
+                            sleepStrategy = SleepStrategy::USleep;
+                            break;
+                        case 'n':
+                            sleepStrategy = SleepStrategy::NanoSleep;
+                            break;
+                        case 't':
+                            sleepStrategy = SleepStrategy::TimerFd;
+                            break;
+                        case 'h':
+                            sleepStrategy = SleepStrategy::Hybrid;
+                            if (arg[3] != 0) {
+                                if ((temp = stringToPositiveInteger(&arg[3], "-W")) < 0) return 1;
+                                sleepSpinNanos = temp * SYNTHMARK_NANOS_PER_MICROSECOND;
+                            }
+                            break;
+                        default:
+                            printf(TEXT_ERROR "invalid sleep strategy %c\n", arg[2]);
+                            usage(argv[0]);
+                            return 1;
+                    }
+                    break;
+                case 'T':
+                    if ((timerSlackNanos = stringToPositiveInteger(&arg[2], "-T")) < 0) return 1;
+                    break;
+                case 'D':
+                    temp = stringToPositiveInteger(&arg[2], "-D");
+                    if (temp < 0) return 1;
+                    useDmaThread = (temp > 0);
+                    break;
+                case 'O':
+                    outputFileName = &arg[2];
+                    break;
+                case 'I':
+                    if ((impulseSeconds = stringToPositiveInteger(&arg[2], "-I")) < 0) return 1;
+                    break;
+                case 'F':
+                    switch (arg[2]) {
+                        case 'f':
+                            sampleType = SampleType::Float;
+                            break;
+                        case 'd':
+                            sampleType = SampleType::Double;
+                            break;
+                        case 'q':
+                            sampleType = SampleType::Q31;
+                            break;
+                        case 'h':
+                            sampleType = SampleType::Q15;
+                            break;
+                        case 'a':
+                            allSampleTypes = true;
+                            break;
+                        default:
+                            printf(TEXT_ERROR "Invalid sample type: %s\n", arg);
+                            usage(argv[0]);
+                            return 1;
+                    }
+                    break;
 
                 case 'h': // help
                 case '?': // help
@@ -220,65 +561,226 @@ int main(int argc, char **argv)
         printf(TEXT_ERROR "Invalid delay for note on = %d\n", numSecondsDelayNoteOn);
         return 1;
     }
+    if (allSampleTypes && testCode != 'v') {
+        printf(TEXT_ERROR "-Fa can only be used with VoiceMark\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (oversampling != 0 && oversampling != 1 && oversampling != 2
+            && oversampling != 4 && oversampling != 8) {
+        printf(TEXT_ERROR "Invalid oversampling = %d\n", oversampling);
+        usage(argv[0]);
+        return 1;
+    }
+    if (oversampling == 0 && testCode != 'v') {
+        printf(TEXT_ERROR "-o0 can only be used with VoiceMark\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (channelCount < 1 || channelCount > kSynthmarkMaxChannels) {
+        printf(TEXT_ERROR "Invalid channel count = %d\n", channelCount);
+        usage(argv[0]);
+        return 1;
+    }
+    if (effectsFlags != EFFECTS_NONE && channelCount != SAMPLES_PER_FRAME) {
+        printf(TEXT_ERROR "-e can only be used with %d channels\n", SAMPLES_PER_FRAME);
+        usage(argv[0]);
+        return 1;
+    }
+    if (impulseSeconds < 1 || impulseSeconds > 5) {
+        printf(TEXT_ERROR "Invalid impulse response seconds = %d\n", impulseSeconds);
+        usage(argv[0]);
+        return 1;
+    }
+    if (outputFileName != nullptr && (*outputFileName == 0 || testCode == 'o')) {
+        printf(TEXT_ERROR "-O needs a file name and cannot be used with -to\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (useDmaThread && (outputFileName != nullptr || testCode == 'o')) {
+        printf(TEXT_ERROR "-D1 cannot be used with -O or -to\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (timingOptions.stallPeriodMillis > 0
+            && timingOptions.stallLengthMillis >= timingOptions.stallPeriodMillis) {
+        printf(TEXT_ERROR "hardware stall must be shorter than its period\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (testCode == 'o' && (timingOptions.driftPpm != 0 || timingOptions.jitterMicros != 0
+            || timingOptions.readMillis != 0 || timingOptions.stallPeriodMillis != 0)) {
+        printf(TEXT_ERROR "-H cannot be used with -to\n");
+        usage(argv[0]);
+        return 1;
+    }
+    // VoiceMark adjusts the voices using the callback load, which does not
+    // include the rendering when pipelined.
+    if (pipelineDepth > kPipelineMaxDepth || (pipelineDepth > 0
+            && (testCode == 'o' || testCode == 'v' || testCode == 'a'))) {
+        printf(TEXT_ERROR "Invalid pipeline depth = %d, max is %d, not with -to, -tv or -ta\n",
+               pipelineDepth, kPipelineMaxDepth);
+        usage(argv[0]);
+        return 1;
+    }
+    if (randomCallbackSizes && testCode == 'o') {
+        printf(TEXT_ERROR "-R1 cannot be used with -to\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (midiTempoPercent < kMidiMinTempoPercent || midiTempoPercent > kMidiMaxTempoPercent) {
+        printf(TEXT_ERROR "Invalid MIDI tempo = %d%%\n", midiTempoPercent);
+        usage(argv[0]);
+        return 1;
+    }
+    if (midiFileName != nullptr && *midiFileName == 0) {
+        printf(TEXT_ERROR "-M needs a file name\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (traceFileName != nullptr && *traceFileName == 0) {
+        printf(TEXT_ERROR "-Y needs a file name\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (flightFileName != nullptr && *flightFileName == 0) {
+        printf(TEXT_ERROR "-Z needs a file name\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (testCode == 'r' && traceFileName == nullptr) {
+        printf(TEXT_ERROR "-tr needs a trace file, use -Y\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (testCode == 'r' && (pipelineDepth > 0 || midiFileName != nullptr
+            || eventsPerSecond > 0)) {
+        printf(TEXT_ERROR "-tr cannot be combined with -L, -M or -E\n");
+        usage(argv[0]);
+        return 1;
+    }
+    // The pool and graph harnesses render their own voices, so events would time the wrong synth.
+    if ((testCode == 'p' || testCode == 'g') && (midiFileName != nullptr || eventsPerSecond > 0)) {
+        printf(TEXT_ERROR "-t%c cannot be combined with -M or -E\n", testCode);
+        usage(argv[0]);
+        return 1;
+    }
+    if (numEventProducers < 1 || numEventProducers > kNoteEventMaxProducers) {
+        printf(TEXT_ERROR "Invalid number of note event threads = %d\n", numEventProducers);
+        usage(argv[0]);
+        return 1;
+    }
+    if (numStreams < 1 || numStreams > kMultiStreamMaxStreams) {
+        printf(TEXT_ERROR "Invalid number of streams = %d\n", numStreams);
+        usage(argv[0]);
+        return 1;
+    }
+    if (numInstances < 1 || numInstances > kPluginHostMaxInstances) {
+        printf(TEXT_ERROR "Invalid number of instances = %d\n", numInstances);
+        usage(argv[0]);
+        return 1;
+    }
+    if (maxThreads < 1 || maxThreads > kRenderThreadPoolMaxWorkers) {
+        printf(TEXT_ERROR "Invalid number of threads = %d\n", maxThreads);
+        usage(argv[0]);
+        return 1;
+    }
+    if (graphSize < 1 || graphSize > kGraphMaxSize) {
+        printf(TEXT_ERROR "Invalid graph size = %d\n", graphSize);
+        usage(argv[0]);
+        return 1;
+    }
     if (framesPerBurst < 4) {
         printf(TEXT_ERROR "Block size too small = %d\n", framesPerBurst);
         usage(argv[0]);
         return 1;
     }
 
-    audioSink.setRequestedCpu(cpuAffinity);
-    audioSink.setDefaultBufferSizeInBursts(bufferSizeBursts);
+    // Save the rendered audio if requested, otherwise it is discarded.
+    VirtualAudioSink *pacedSink = &audioSink;
+    if (outputFileName != nullptr) {
+        fileSink.setFileName(outputFileName);
+        pacedSink = &fileSink;
+    } else if (useDmaThread) {
+        pacedSink = &dmaSink;
+    }
+    AudioSinkBase *activeSink = pacedSink;
+
+    HardwareTimingModel timingModel;
+    timingModel.setDriftPpm(timingOptions.driftPpm);
+    timingModel.setJitter(timingOptions.jitterType,
+                          timingOptions.jitterMicros * SYNTHMARK_NANOS_PER_MICROSECOND);
+    timingModel.setFramesPerRead(
+            (int32_t) (timingOptions.readMillis * (int64_t) sampleRate / SYNTHMARK_MILLIS_PER_SECOND));
+    timingModel.setStall(timingOptions.stallPeriodMillis * SYNTHMARK_NANOS_PER_MILLISECOND,
+                         timingOptions.stallLengthMillis * SYNTHMARK_NANOS_PER_MILLISECOND);
+    pacedSink->setTimingModel(timingModel);
+    pacedSink->setRandomCallbackSizes(randomCallbackSizes);
+    pacedSink->setRequestedCpu(cpuAffinity);
+    pacedSink->setDefaultBufferSizeInBursts(bufferSizeBursts);
 
     // Create a test harness and set the parameters.
     switch(testCode) {
         case 'v':
-            {
-                VoiceMarkHarness *voiceHarness = new VoiceMarkHarness(&audioSink, &result);
+            if (allSampleTypes || oversampling == 0) {
+                VoiceMarkSeriesHarness *seriesHarness
+                        = new VoiceMarkSeriesHarness(pacedSink, &result);
+                seriesHarness->setTargetCpuLoad(percentCpu * 0.01);
+                seriesHarness->setSweepSampleTypes(allSampleTypes);
+                seriesHarness->setSweepOversampling(oversampling == 0);
+                harness = seriesHarness;
+            } else {
+                VoiceMarkHarness *voiceHarness = new VoiceMarkHarness(pacedSink, &result);
                 voiceHarness->setTargetCpuLoad(percentCpu * 0.01);
                 voiceHarness->setInitialVoiceCount(numVoices);
                 harness = voiceHarness;
+                captureHarness = voiceHarness;
             }
             break;
 
         case 'l':
             {
-                LatencyMarkHarness *latencyHarness = new LatencyMarkHarness(&audioSink, &result);
+                LatencyMarkHarness *latencyHarness = new LatencyMarkHarness(pacedSink, &result);
                 latencyHarness->setNumVoicesHigh(numVoicesHigh);
                 latencyHarness->setVoicesMode(voicesMode);
                 latencyHarness->setInitialBursts(bufferSizeBursts);
                 harness = latencyHarness;
+                flightHarness = latencyHarness;
             }
             break;
 
         case 'j':
             {
-                JitterMarkHarness *jitterHarness = new JitterMarkHarness(&audioSink, &result);
+                JitterMarkHarness *jitterHarness = new JitterMarkHarness(pacedSink, &result);
                 jitterHarness->setNumVoicesHigh(numVoicesHigh);
                 jitterHarness->setVoicesMode(voicesMode);
                 harness = jitterHarness;
+                captureHarness = jitterHarness;
             }
             break;
 
         case 'c':
             {
-                ClockRampHarness *clockHarness = new ClockRampHarness(&audioSink, &result);
+                ClockRampHarness *clockHarness = new ClockRampHarness(pacedSink, &result);
                 clockHarness->setNumVoicesHigh(numVoicesHigh);
                 clockHarness->setVoicesMode(voicesMode);
                 harness = clockHarness;
+                captureHarness = clockHarness;
             }
             break;
 
         case 'u':
             {
                 UtilizationMarkHarness *utilizationHarness
-                        = new UtilizationMarkHarness(&audioSink, &result);
+                        = new UtilizationMarkHarness(pacedSink, &result);
                 harness = utilizationHarness;
+                captureHarness = utilizationHarness;
             }
             break;
 
         case 'a':
             {
-                AutomatedTestSuite *testSuite = new AutomatedTestSuite(&audioSink, &result);
+                AutomatedTestSuite *testSuite = new AutomatedTestSuite(pacedSink, &result);
                 harness = testSuite;
             }
             break;
@@ -286,24 +788,124 @@ int main(int argc, char **argv)
         case 's':
             {
                 UtilizationSeriesHarness *seriesHarness
-                        = new UtilizationSeriesHarness(&audioSink, &result);
+                        = new UtilizationSeriesHarness(pacedSink, &result);
                 seriesHarness->setNumVoicesHigh(numVoicesHigh);
                 harness = seriesHarness;
             }
             break;
 
+        case 'o':
+            {
+                // Render flat out on this thread with no real-time pacing.
+                ThroughputHarness *throughputHarness
+                        = new ThroughputHarness(&offlineSink, &result);
+                harness = throughputHarness;
+                activeSink = &offlineSink;
+            }
+            break;
+
+        case 'm':
+            {
+                MultiStreamHarness *multiHarness = new MultiStreamHarness(pacedSink, &result);
+                multiHarness->setNumStreams(numStreams);
+                multiHarness->setNumVoicesHigh(numVoicesHigh);
+                harness = multiHarness;
+            }
+            break;
+
+        case 'p':
+            {
+                PluginHostHarness *pluginHarness = new PluginHostHarness(pacedSink, &result);
+                pluginHarness->setNumInstances(numInstances);
+                pluginHarness->setMaxThreads(maxThreads);
+                harness = pluginHarness;
+            }
+            break;
+
+        case 'g':
+            {
+                GraphMarkHarness *graphHarness = new GraphMarkHarness(pacedSink, &result);
+                graphHarness->setShape(graphShape, graphSize);
+                graphHarness->setNumThreads(maxThreads);
+                harness = graphHarness;
+            }
+            break;
+
+        case 'b':
+            {
+                SyncMarkHarness *syncHarness = new SyncMarkHarness(pacedSink, &result);
+                harness = syncHarness;
+            }
+            break;
+
+        case 'w':
+            {
+                WakeupMarkHarness *wakeupHarness = new WakeupMarkHarness(pacedSink, &result);
+                harness = wakeupHarness;
+            }
+            break;
+
+        case 'r':
+            {
+                TraceReplayHarness *replayHarness = new TraceReplayHarness(pacedSink, &result);
+                if (replayHarness->loadTrace(traceFileName) < 0) {
+                    printf(TEXT_ERROR "could not load trace %s\n", traceFileName);
+                    delete replayHarness;
+                    return 1;
+                }
+                harness = replayHarness;
+                flightHarness = replayHarness;
+            }
+            break;
+
         default:
             printf(TEXT_ERROR "unrecognized testCode = %c\n", testCode);
             usage(argv[0]);
             return 1;
             break;
     }
+    if (traceFileName != nullptr && testCode != 'r') {
+        if (captureHarness == nullptr) {
+            printf(TEXT_ERROR "-Y can only capture a trace with -tv, -tj, -tc or -tu\n");
+            usage(argv[0]);
+            return 1;
+        }
+        captureHarness->setTraceFile(traceFileName);
+    }
+    if (flightHarness == nullptr) {
+        flightHarness = captureHarness;
+    }
+    if (flightFileName != nullptr) {
+        if (flightHarness == nullptr) {
+            printf(TEXT_ERROR "-Z only works with -tv, -tj, -tc, -tu, -tl or -tr\n");
+            usage(argv[0]);
+            return 1;
+        }
+        flightHarness->setFlightRecorderFile(flightFileName);
+    }
     harness->setNumVoices(numVoices);
     harness->setDelayNoteOnSeconds(numSecondsDelayNoteOn);
+    harness->setSampleType(sampleType);
+    harness->setOversampling((oversampling == 0) ? 1 : oversampling);
+    harness->setEffects(effectsFlags);
+    harness->setImpulseSeconds((float) impulseSeconds);
+    harness->setChannelCount(channelCount);
+    harness->setPipelineDepth(pipelineDepth);
+    harness->setNoteEvents(eventsPerSecond, noteQueueType, numEventProducers);
+    harness->setMidiFile((midiFileName != nullptr) ? midiFileName : "", midiTempoPercent);
     harness->setThreadType(useAudioThread
                            ? HostThreadFactory::ThreadType::Audio
                            : HostThreadFactory::ThreadType::Default);
     HostCpuManager::setWorkloadHintsEnabled(workloadHintsEnabled);
+    // The frequency is estimated from the cycle counter when there is one.
+    PerfCounterAnalyzer::setEnabled(perfCountersEnabled || frequencyEnabled);
+    CpuFrequencyEstimator::setEnabled(frequencyEnabled);
+    if (frequencyEnabled) {
+        // Before any harness starts its threads, which share the calibration.
+        CpuFrequencyEstimator::calibrate();
+    }
+    HostTools::setSleepStrategy(sleepStrategy, sleepSpinNanos);
+    HostTools::setTimerSlackNanos(timerSlackNanos);
 
     // Print specified parameters.
     printf("  test.name            = %s\n",  harness->getName());
@@ -319,18 +921,80 @@ int main(int argc, char **argv)
     printf("  cpu.count            = %6d\n", HostTools::getCpuCount());
     printf("  audio.thread         = %6d\n", (useAudioThread ? 1 : 0));
     printf("  workload.hints       = %6d\n", (workloadHintsEnabled ? 1 : 0));
+    printf("  perf.counters        = %6d\n", (perfCountersEnabled ? 1 : 0));
+    printf("  cpu.frequency        = %6d\n", (frequencyEnabled ? 1 : 0));
+    printf("  sample.type          = %s\n",
+           allSampleTypes ? "all" : sampleTypeToString(sampleType));
+    printf("  oversampling         = %6d\n", oversampling);
+    printf("  effects              = %s\n", EffectsChain::flagsToString(effectsFlags).c_str());
+    printf("  impulse.seconds      = %6d\n", impulseSeconds);
+    printf("  channel.count        = %6d\n", channelCount);
+    printf("  hardware.model       = %s\n", timingModel.toString().c_str());
+    printf("  pipeline.depth       = %6d\n", pipelineDepth);
+    if (midiFileName != nullptr) {
+        printf("  midi.file            = %s\n", midiFileName);
+        printf("  midi.tempo.percent   = %6d\n", midiTempoPercent);
+    }
+    if (traceFileName != nullptr) {
+        printf("  trace.file           = %s\n", traceFileName);
+    }
+    if (flightFileName != nullptr) {
+        printf("  flight.file          = %s\n", flightFileName);
+    }
+    if (eventsPerSecond > 0) {
+        printf("  events.per.second    = %6d\n", eventsPerSecond);
+        printf("  events.queue         = %s\n", noteQueueTypeToString(noteQueueType));
+        printf("  events.producers     = %6d\n", numEventProducers);
+    }
+    printf("  random.callbacks     = %6d\n", randomCallbackSizes ? 1 : 0);
+    printf("  dma.thread           = %6d\n", useDmaThread ? 1 : 0);
+    printf("  sleep.strategy       = %s\n", HostTools::sleepStrategyToString(sleepStrategy));
+    if (sleepStrategy == SleepStrategy::Hybrid) {
+        printf("  sleep.spin.usec      = %6d\n",
+               (int) (sleepSpinNanos / SYNTHMARK_NANOS_PER_MICROSECOND));
+    }
+    printf("  timer.slack.nanos    = %6d\n", (int) timerSlackNanos);
+    if (testCode == 'm') {
+        printf("  num.streams          = %6d\n", numStreams);
+    }
+    if (testCode == 'g') {
+        printf("  graph.shape          = %s\n", graphShapeToString(graphShape));
+        printf("  graph.size           = %6d\n", graphSize);
+        printf("  render.threads       = %6d\n", maxThreads);
+    }
+    if (testCode == 'p') {
+        printf("  num.instances        = %6d\n", numInstances);
+        printf("  max.threads          = %6d\n", maxThreads);
+    }
+    if (outputFileName != nullptr) {
+        printf("  output.file          = %s\n", outputFileName);
+    }
     printf("# wait at least %d seconds for benchmark to complete\n", numSeconds);
     fflush(stdout);
 
     // Run the benchmark.
     harness->runTest(sampleRate, framesPerBurst, numSeconds);
 
-    printf("scheduler              = %s\n",  audioSink.wasSchedFifoUsed() ? "SCHED_FIFO" : "unknown");
-    printf("buffer.size.frames     = %6d\n", audioSink.getBufferSizeInFrames());
-    printf("buffer.size.bursts     = %6d\n", audioSink.getBufferSizeInFrames() / audioSink.getFramesPerBurst());
-    printf("buffer.capacity.frames = %6d\n", audioSink.getBufferCapacityInFrames());
-    printf("sample.rate            = %6d\n", audioSink.getSampleRate());
-    printf("cpu.affinity           = %6d\n", audioSink.getActualCpu());
+    // Some tests, like -tb and -tw, never open the sink.
+    if (activeSink->getFramesPerBurst() > 0) {
+        printf("scheduler              = %s\n",  activeSink->wasSchedFifoUsed() ? "SCHED_FIFO" : "unknown");
+        printf("buffer.size.frames     = %6d\n", activeSink->getBufferSizeInFrames());
+        printf("buffer.size.bursts     = %6d\n", activeSink->getBufferSizeInFrames() / activeSink->getFramesPerBurst());
+        printf("buffer.capacity.frames = %6d\n", activeSink->getBufferCapacityInFrames());
+        printf("sample.rate            = %6d\n", activeSink->getSampleRate());
+        printf("cpu.affinity           = %6d\n", activeSink->getActualCpu());
+    }
+    if (activeSink->terminate() < 0) {
+        printf(TEXT_ERROR "could not finish writing %s\n", outputFileName);
+    }
+    if (useDmaThread) {
+        printf("dma.cpu.affinity       = %6d\n", dmaSink.getConsumerCpu());
+    }
+    if (outputFileName != nullptr) {
+        printf("file.bytes.written     = %lld\n", (long long) fileSink.getBytesWritten());
+        printf("file.underrun.count    = %6d\n", fileSink.getFileUnderrunCount());
+        printf("file.write.errors      = %6d\n", fileSink.getWriteErrorCount());
+    }
     fflush(stdout);
 
     // Print the test results.
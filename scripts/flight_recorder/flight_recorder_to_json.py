@@ -0,0 +1,120 @@
+"""
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+"""
+
+'''
+Convert a SynthMark flight recorder file, saved with -Z, into
+Chrome trace JSON that can be opened in chrome://tracing or ui.perfetto.dev.
+
+usage: python3 flight_recorder_to_json.py input.smfr [output.json]
+'''
+import json
+import struct
+import sys
+
+# Must match FlightRecorderHeader and FlightRecord in source/tools/FlightRecorder.h
+HEADER_FORMAT = '=4sIiiii'
+RECORD_FORMAT = '=qqqqihH'
+MAGIC = b'SMFR'
+VERSION = 1
+UNDERRUN_FLAG = 1
+
+PID = 1
+
+
+def readFlightRecorder(fileName):
+    with open(fileName, 'rb') as f:
+        data = f.read()
+    headerSize = struct.calcsize(HEADER_FORMAT)
+    recordSize = struct.calcsize(RECORD_FORMAT)
+    if len(data) < headerSize:
+        raise ValueError(fileName + ' is too short')
+    magic, version, sampleRate, framesPerBurst, numRecords, glitchIndex = \
+        struct.unpack_from(HEADER_FORMAT, data, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(fileName + ' is not a SynthMark flight recorder file')
+    numRecords = min(numRecords, (len(data) - headerSize) // recordSize)
+    records = []
+    for i in range(numRecords):
+        ideal, entry, exit, sleepTarget, cpu, voices, flags = \
+            struct.unpack_from(RECORD_FORMAT, data, headerSize + i * recordSize)
+        records.append({'ideal': ideal, 'entry': entry, 'exit': exit,
+                        'sleepTarget': sleepTarget, 'cpu': cpu,
+                        'voices': voices, 'flags': flags})
+    header = {'sampleRate': sampleRate, 'framesPerBurst': framesPerBurst,
+              'glitchIndex': glitchIndex}
+    return header, records
+
+
+def toMicros(nanos, baseNanos):
+    return (nanos - baseNanos) / 1000.0
+
+
+def convert(header, records):
+    events = [{'name': 'process_name', 'ph': 'M', 'pid': PID,
+               'args': {'name': 'SynthMark %d Hz, %d frames per burst'
+                                % (header['sampleRate'], header['framesPerBurst'])}}]
+    if not records:
+        return {'traceEvents': events}
+    baseNanos = records[0]['entry']
+    cpus = set()
+    previousExit = 0
+    for index, record in enumerate(records):
+        cpu = record['cpu']
+        cpus.add(cpu)
+        entry = toMicros(record['entry'], baseNanos)
+        lateMicros = (record['entry'] - record['ideal']) / 1000.0 if record['ideal'] > 0 else 0.0
+        if record['sleepTarget'] > 0 and previousExit > 0:
+            events.append({'name': 'sleep', 'ph': 'X', 'pid': PID, 'tid': cpu,
+                           'ts': toMicros(previousExit, baseNanos),
+                           'dur': (record['entry'] - previousExit) / 1000.0,
+                           'args': {'overshoot.usec':
+                                    (record['entry'] - record['sleepTarget']) / 1000.0}})
+        events.append({'name': 'render', 'ph': 'X', 'pid': PID, 'tid': cpu,
+                       'ts': entry,
+                       'dur': (record['exit'] - record['entry']) / 1000.0,
+                       'args': {'burst': index, 'voices': record['voices'],
+                                'late.usec': lateMicros}})
+        events.append({'name': 'voices', 'ph': 'C', 'pid': PID, 'ts': entry,
+                       'args': {'voices': record['voices']}})
+        events.append({'name': 'late.usec', 'ph': 'C', 'pid': PID, 'ts': entry,
+                       'args': {'late.usec': lateMicros}})
+        if record['flags'] & UNDERRUN_FLAG:
+            events.append({'name': 'underrun', 'ph': 'i', 's': 'g', 'pid': PID,
+                           'tid': cpu, 'ts': entry})
+        previousExit = record['exit']
+    for cpu in sorted(cpus):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': PID, 'tid': cpu,
+                       'args': {'name': 'render on cpu %d' % cpu}})
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        print('usage: python3 flight_recorder_to_json.py input.smfr [output.json]')
+        return 1
+    header, records = readFlightRecorder(sys.argv[1])
+    outputName = sys.argv[2] if len(sys.argv) > 2 else sys.argv[1] + '.json'
+    with open(outputName, 'w') as f:
+        json.dump(convert(header, records), f)
+    print('wrote %d bursts to %s' % (len(records), outputName))
+    if header['glitchIndex'] >= 0:
+        print('first glitch at burst %d' % header['glitchIndex'])
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -34,7 +34,8 @@
 // #define SYNTHMARK_MINOR_VERSION        17  /* Add -N to JitterMark. */
 // #define SYNTHMARK_MINOR_VERSION        18  /* Add "-tc", ClockRamp test. Add harness to Android app. */
 // #define SYNTHMARK_MINOR_VERSION        19  /* Add -w1 for SCHED_DEADLINE. */
-#define SYNTHMARK_MINOR_VERSION        20  /* Optimize search for LatencyMark. */
+// #define SYNTHMARK_MINOR_VERSION        20  /* Optimize search for LatencyMark. */
+#define SYNTHMARK_MINOR_VERSION        21  /* Add -F for double and fixed-point synthesis. */
 
 // This may be increased without invalidating the benchmark.
 constexpr int kSynthmarkMaxVoices   = 512;
@@ -46,6 +47,12 @@ constexpr int kSynthmarkFramesPerRender  =  8;
 
 constexpr int kSynthmarkSampleRate = 48000;
 
+// Maximum number of interleaved output channels, enough for 3rd order ambisonics.
+constexpr int kSynthmarkMaxChannels = 16;
+
+// Voices may be rendered at up to this multiple of the output sample rate.
+constexpr int kSynthmarkMaxOversampling = 8;
+
 // These should not be changed.
 constexpr int64_t SYNTHMARK_MILLIS_PER_SECOND      = 1000;
 constexpr int64_t SYNTHMARK_MICROS_PER_SECOND      = 1000 * 1000;
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_AUDIO_GRAPH_H
+#define SYNTHMARK_AUDIO_GRAPH_H
+
+#include <cstdint>
+#include <string.h>
+#include <vector>
+
+#include "SynthMark.h"
+#include "SampleTraits.h"
+#include "StereoChorus.h"
+#include "Synthesizer.h"
+#include "tools/HostTools.h"
+
+/**
+ * A processing step in an AudioGraph.
+ * Every node writes interleaved stereo into its own output buffer.
+ */
+class GraphNode
+{
+public:
+    virtual ~GraphNode() = default;
+
+    /**
+     * @param inputs output buffers of the nodes connected to this one
+     */
+    virtual void process(const float * const *inputs, int32_t numInputs,
+                         float *output, int32_t numFrames) = 0;
+
+    virtual int32_t notesOn(int32_t numVoices) {
+        return 0;
+    }
+
+    virtual void allNotesOff() {}
+
+    virtual const char *getTypeName() const = 0;
+
+    /**
+     * Add the inputs into the output.
+     */
+    static void mixInputs(const float * const *inputs, int32_t numInputs,
+                          float *output, int32_t numSamples) {
+        if (numInputs == 0) {
+            memset(output, 0, numSamples * sizeof(float));
+            return;
+        }
+        memcpy(output, inputs[0], numSamples * sizeof(float));
+        for (int32_t i = 1; i < numInputs; i++) {
+            const float *input = inputs[i];
+            for (int32_t n = 0; n < numSamples; n++) {
+                output[n] += input[n];
+            }
+        }
+    }
+};
+
+/**
+ * Source node that renders a few voices with its own Synthesizer.
+ */
+class VoiceNode : public GraphNode
+{
+public:
+    int32_t setup(int32_t sampleRate, int32_t maxVoices,
+                  SampleType sampleType, int32_t oversampling) {
+        return mSynth.setup(sampleRate, maxVoices, sampleType, oversampling, SAMPLES_PER_FRAME);
+    }
+
+    void process(const float * const *inputs, int32_t numInputs,
+                 float *output, int32_t numFrames) override {
+        mSynth.render(output, numFrames);
+    }
+
+    int32_t notesOn(int32_t numVoices) override {
+        return mSynth.notesOn(numVoices);
+    }
+
+    void allNotesOff() override {
+        mSynth.allNotesOff();
+    }
+
+    const char *getTypeName() const override {
+        return "voice";
+    }
+
+private:
+    Synthesizer mSynth;
+};
+
+/**
+ * Sum the inputs with a fixed gain, like a submix bus.
+ */
+class BusNode : public GraphNode
+{
+public:
+    explicit BusNode(float gain = 1.0f) : mGain(gain) {}
+
+    void process(const float * const *inputs, int32_t numInputs,
+                 float *output, int32_t numFrames) override {
+        int32_t numSamples = numFrames * SAMPLES_PER_FRAME;
+        mixInputs(inputs, numInputs, output, numSamples);
+        for (int32_t n = 0; n < numSamples; n++) {
+            output[n] *= mGain;
+        }
+    }
+
+    const char *getTypeName() const override {
+        return "bus";
+    }
+
+private:
+    float mGain;
+};
+
+/**
+ * Mix the inputs and run them through a chorus, like an insert effect.
+ */
+class EffectNode : public GraphNode
+{
+public:
+    void setup(int32_t sampleRate) {
+        mChorus.setup(sampleRate);
+    }
+
+    void process(const float * const *inputs, int32_t numInputs,
+                 float *output, int32_t numFrames) override {
+        mixInputs(inputs, numInputs, output, numFrames * SAMPLES_PER_FRAME);
+        mChorus.process(output, numFrames);
+    }
+
+    const char *getTypeName() const override {
+        return "effect";
+    }
+
+private:
+    StereoChorus mChorus;
+};
+
+/**
+ * A directed acyclic graph of nodes that is processed once per burst.
+ *
+ * compile() sorts the nodes and assigns the output buffers. A buffer is only
+ * reused by a node when every reader of the previous owner is an ancestor of
+ * that node. So the reuse is also safe when independent nodes run in parallel.
+ *
+ * The graph owns its nodes.
+ */
+class AudioGraph
+{
+public:
+    AudioGraph() {}
+
+    ~AudioGraph() {
+        clear();
+    }
+
+    void clear() {
+        for (Node &node : mNodes) {
+            delete node.node;
+        }
+        mNodes.clear();
+        mOrder.clear();
+        mBuffers.clear();
+        mNumBuffers = 0;
+        mOutputIndex = -1;
+        mEdgeCount = 0;
+    }
+
+    /**
+     * @return index of the node
+     */
+    int32_t addNode(GraphNode *node) {
+        Node entry;
+        entry.node = node;
+        mNodes.push_back(entry);
+        return (int32_t) mNodes.size() - 1;
+    }
+
+    /**
+     * Feed the output of the source node into the destination node.
+     */
+    int32_t connect(int32_t source, int32_t destination) {
+        if (source < 0 || source >= getNodeCount()
+                || destination < 0 || destination >= getNodeCount()
+                || source == destination) {
+            return -1;
+        }
+        mNodes[source].outputs.push_back(destination);
+        mNodes[destination].inputs.push_back(source);
+        mEdgeCount++;
+        return 0;
+    }
+
+    /**
+     * The output of this node is copied out by render().
+     */
+    void setOutputNode(int32_t index) {
+        mOutputIndex = index;
+    }
+
+    int32_t getOutputNode() const {
+        return mOutputIndex;
+    }
+
+    /**
+     * Sort the nodes and allocate the buffers.
+     * Do not call this from the audio callback.
+     * @param maxFrames largest number of frames passed to processNode()
+     * @return 0 or -1 if there is a cycle or no output
+     */
+    int32_t compile(int32_t maxFrames) {
+        int32_t numNodes = getNodeCount();
+        if (mOutputIndex < 0 || mOutputIndex >= numNodes) {
+            return -1;
+        }
+        // Kahn's algorithm.
+        mOrder.clear();
+        std::vector<int32_t> pending(numNodes);
+        for (int32_t i = 0; i < numNodes; i++) {
+            pending[i] = (int32_t) mNodes[i].inputs.size();
+            if (pending[i] == 0) {
+                mOrder.push_back(i);
+            }
+        }
+        for (size_t cursor = 0; cursor < mOrder.size(); cursor++) {
+            for (int32_t next : mNodes[mOrder[cursor]].outputs) {
+                if (--pending[next] == 0) {
+                    mOrder.push_back(next);
+                }
+            }
+        }
+        if ((int32_t) mOrder.size() != numNodes) {
+            return -1; // cycle
+        }
+
+        // ancestors[i * numNodes + j] is true if j must finish before i starts.
+        std::vector<bool> ancestors(numNodes * numNodes, false);
+        for (int32_t index : mOrder) {
+            for (int32_t input : mNodes[index].inputs) {
+                ancestors[index * numNodes + input] = true;
+                for (int32_t j = 0; j < numNodes; j++) {
+                    if (ancestors[input * numNodes + j]) {
+                        ancestors[index * numNodes + j] = true;
+                    }
+                }
+            }
+        }
+
+        // Allocate the buffers in order, reusing any whose readers are all done.
+        std::vector<int32_t> bufferOwners;
+        for (int32_t index : mOrder) {
+            int32_t bufferIndex = -1;
+            for (size_t b = 0; b < bufferOwners.size() && bufferIndex < 0; b++) {
+                const Node &owner = mNodes[bufferOwners[b]];
+                bool isFree = !owner.outputs.empty() && bufferOwners[b] != mOutputIndex;
+                for (int32_t reader : owner.outputs) {
+                    if (!ancestors[index * numNodes + reader]) {
+                        isFree = false;
+                        break;
+                    }
+                }
+                if (isFree) {
+                    bufferIndex = (int32_t) b;
+                }
+            }
+            if (bufferIndex < 0) {
+                bufferIndex = (int32_t) bufferOwners.size();
+                bufferOwners.push_back(index);
+            } else {
+                bufferOwners[bufferIndex] = index;
+            }
+            mNodes[index].bufferIndex = bufferIndex;
+        }
+        mNumBuffers = (int32_t) bufferOwners.size();
+        mSamplesPerBuffer = maxFrames * SAMPLES_PER_FRAME;
+        mBuffers.assign(mNumBuffers * mSamplesPerBuffer, 0.0f);
+
+        for (Node &node : mNodes) {
+            node.inputBuffers.clear();
+            for (int32_t input : node.inputs) {
+                node.inputBuffers.push_back(getBuffer(input));
+            }
+        }
+        resetTiming();
+        return 0;
+    }
+
+    /**
+     * Process one node. Its inputs must already be processed for this burst.
+     * This may be called from any thread.
+     */
+    void processNode(int32_t index, int32_t numFrames) {
+        Node &node = mNodes[index];
+        int64_t startNanos = HostTools::getNanoTime();
+        node.node->process(node.inputBuffers.data(), (int32_t) node.inputBuffers.size(),
+                           getBuffer(index), numFrames);
+        node.totalNanos += HostTools::getNanoTime() - startNanos;
+    }
+
+    /**
+     * Process every node in order on the calling thread.
+     */
+    void processSerial(int32_t numFrames) {
+        for (int32_t index : mOrder) {
+            processNode(index, numFrames);
+        }
+    }
+
+    /**
+     * Copy the output node after the graph has been processed.
+     */
+    void readOutput(float *output, int32_t numFrames) const {
+        memcpy(output, getBuffer(mOutputIndex), numFrames * SAMPLES_PER_FRAME * sizeof(float));
+    }
+
+    int32_t notesOn(int32_t numVoices) {
+        for (Node &node : mNodes) {
+            if (node.node->notesOn(numVoices) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void allNotesOff() {
+        for (Node &node : mNodes) {
+            node.node->allNotesOff();
+        }
+    }
+
+    int32_t getNodeCount() const {
+        return (int32_t) mNodes.size();
+    }
+
+    int32_t getEdgeCount() const {
+        return mEdgeCount;
+    }
+
+    int32_t getBufferCount() const {
+        return mNumBuffers;
+    }
+
+    const std::vector<int32_t> &getOrder() const {
+        return mOrder;
+    }
+
+    const std::vector<int32_t> &getInputs(int32_t index) const {
+        return mNodes[index].inputs;
+    }
+
+    const std::vector<int32_t> &getOutputs(int32_t index) const {
+        return mNodes[index].outputs;
+    }
+
+    void resetTiming() {
+        for (Node &node : mNodes) {
+            node.totalNanos = 0;
+        }
+    }
+
+    /**
+     * @return total time spent processing all the nodes since resetTiming()
+     */
+    int64_t getTotalWorkNanos() const {
+        int64_t total = 0;
+        for (const Node &node : mNodes) {
+            total += node.totalNanos;
+        }
+        return total;
+    }
+
+    /**
+     * @return time of the slowest chain of dependent nodes since resetTiming().
+     *         No number of threads can process the graph faster than this.
+     */
+    int64_t getCriticalPathNanos() const {
+        std::vector<int64_t> finish(mNodes.size(), 0);
+        int64_t longest = 0;
+        for (int32_t index : mOrder) {
+            int64_t start = 0;
+            for (int32_t input : mNodes[index].inputs) {
+                if (finish[input] > start) {
+                    start = finish[input];
+                }
+            }
+            finish[index] = start + mNodes[index].totalNanos;
+            if (finish[index] > longest) {
+                longest = finish[index];
+            }
+        }
+        return longest;
+    }
+
+    /**
+     * @return number of nodes in the longest chain of dependent nodes
+     */
+    int32_t getDepth() const {
+        std::vector<int32_t> depth(mNodes.size(), 0);
+        int32_t deepest = 0;
+        for (int32_t index : mOrder) {
+            int32_t start = 0;
+            for (int32_t input : mNodes[index].inputs) {
+                if (depth[input] > start) {
+                    start = depth[input];
+                }
+            }
+            depth[index] = start + 1;
+            if (depth[index] > deepest) {
+                deepest = depth[index];
+            }
+        }
+        return deepest;
+    }
+
+private:
+    struct Node {
+        GraphNode                 *node = nullptr;
+        std::vector<int32_t>       inputs;
+        std::vector<int32_t>       outputs;
+        std::vector<const float *> inputBuffers;
+        int32_t                    bufferIndex = 0;
+        int64_t                    totalNanos = 0; // written by the thread that processes it
+    };
+
+    float *getBuffer(int32_t index) {
+        return &mBuffers[mNodes[index].bufferIndex * mSamplesPerBuffer];
+    }
+
+    const float *getBuffer(int32_t index) const {
+        return &mBuffers[mNodes[index].bufferIndex * mSamplesPerBuffer];
+    }
+
+    std::vector<Node>     mNodes;
+    std::vector<int32_t>  mOrder;
+    std::vector<float>    mBuffers;
+    int32_t               mNumBuffers = 0;
+    int32_t               mSamplesPerBuffer = 0;
+    int32_t               mOutputIndex = -1;
+    int32_t               mEdgeCount = 0;
+};
+
+#endif // SYNTHMARK_AUDIO_GRAPH_H
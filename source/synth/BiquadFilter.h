@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <math.h>
 #include "SynthMark.h"
+#include "SampleTraits.h"
 #include "UnitGenerator.h"
 
 #define BIQUAD_MIN_FREQ      (0.00001f) // REVIEW
@@ -33,15 +34,22 @@
 
 /**
  * Time varying lowpass resonant filter.
+ * The coefficients are calculated using synth_float_t and then
+ * converted to the coefficient type for T.
  */
-class BiquadFilter : public UnitGenerator
+template <typename T = synth_float_t>
+class BiquadFilter : public UnitGenerator<T>
 {
 public:
+    typedef typename SampleTraits<T>::coefficient_type coefficient_type;
+    typedef typename SampleTraits<T>::state_type state_type;
+
     BiquadFilter()
     : mQ(1.0)
     {
-        xn1 = xn2 = yn1 = yn2 = (synth_float_t) 0;
-        a0 = a1 = a2 = b1 = b2 = (synth_float_t) 0;
+        xn1 = xn2 = (T) 0;
+        yn1 = yn2 = (state_type) 0;
+        a0 = a1 = a2 = b1 = b2 = (coefficient_type) 0;
     }
 
     virtual ~BiquadFilter() = default;
@@ -61,10 +69,10 @@ public:
         return mQ;
     }
 
-    void generate(synth_float_t *input,
+    void generate(T *input,
                   synth_float_t *frequencies,
                   int32_t numSamples) {
-        synth_float_t xn, yn;
+        T xn, yn;
 
 #if RECALCULATE_PER_SAMPLE == 0
         calculateCoefficients(frequencies[0], mQ);
@@ -75,38 +83,38 @@ public:
 #endif
             // Generate outputs by filtering inputs.
             xn = input[i];
-            synth_float_t finite = (a0 * xn) + (a1 * xn1) + (a2 * xn2);
-            // Use double precision for recursive portion.
-            yn = finite - (b1 * yn1) - (b2 * yn2);
-            output[i] = (synth_float_t) yn;
+            T finite = (xn * a0) + (xn1 * a1) + (xn2 * a2);
+            // Use higher precision for recursive portion if available.
+            yn = (T) (state_type(finite) - (yn1 * b1) - (yn2 * b2));
+            this->output[i] = yn;
 
             // Delay input and output values.
             xn2 = xn1;
             xn1 = xn;
             yn2 = yn1;
-            yn1 = yn;
+            yn1 = (state_type) yn;
         }
 
         // Apply a small bipolar impulse to filter to prevent arithmetic underflow.
-        yn1 += (synth_float_t) 1.0E-26;
-        yn2 -= (synth_float_t) 1.0E-26;
+        yn1 += (state_type) 1.0E-26;
+        yn2 -= (state_type) 1.0E-26;
     }
 
 
 private:
     synth_float_t      mQ;
 
-    synth_float_t      xn1;    // delay lines
-    synth_float_t      xn2;
-    double             yn1;
-    double             yn2;
+    T                  xn1;    // delay lines
+    T                  xn2;
+    state_type         yn1;
+    state_type         yn2;
 
-    synth_float_t      a0;    // coefficients
-    synth_float_t      a1;
-    synth_float_t      a2;
+    coefficient_type   a0;    // coefficients
+    coefficient_type   a1;
+    coefficient_type   a2;
 
-    synth_float_t      b1;
-    synth_float_t      b2;
+    coefficient_type   b1;
+    coefficient_type   b2;
 
     synth_float_t      cos_omega;
     synth_float_t      sin_omega;
@@ -144,7 +152,7 @@ private:
 
         if( frequency  < BIQUAD_MIN_FREQ )  frequency  = BIQUAD_MIN_FREQ;
 
-        calcCommon( frequency * mSamplePeriod, Q );
+        calcCommon( frequency * this->mSamplePeriod, Q );
 
         scalar = 1.0f / (1.0f + alpha);
         omc = (1.0f - cos_omega);
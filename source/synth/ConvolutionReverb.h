@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_CONVOLUTION_REVERB_H
+#define SYNTHMARK_CONVOLUTION_REVERB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <math.h>
+#include <mutex>
+#include <string.h>
+#include <vector>
+#include "SynthMark.h"
+#include "PartitionedConvolver.h"
+#include "tools/HostTools.h"
+
+/**
+ * Stereo convolution reverb with a non-uniformly partitioned impulse response.
+ *
+ * The head of the impulse response is convolved in the audio callback using
+ * short partitions, which sets the latency. The tail is convolved with long
+ * partitions on a background thread. Each tail block has a deadline one tail
+ * block after its input is complete. The audio callback waits if a tail
+ * block is late, and the miss is counted.
+ */
+class ConvolutionReverb
+{
+public:
+    // Frames per partition for the head, processed in the callback.
+    static constexpr int32_t kHeadBlockSize = 128;
+    // Frames per partition for the tail, processed on the background thread.
+    static constexpr int32_t kTailBlockSize = 4096;
+    // The head covers this much of the impulse response so the tail has time to finish.
+    static constexpr int32_t kHeadLength = 2 * kTailBlockSize;
+
+    static constexpr int kNumChannels = 2;
+
+    ConvolutionReverb()
+    : mMix(0.3f)
+    {}
+
+    virtual ~ConvolutionReverb() {
+        stopThread();
+    }
+
+    /**
+     * Use a synthetic impulse response of exponentially decaying noise.
+     * Do not call this from the audio callback.
+     */
+    void setup(int32_t sampleRate, float seconds) {
+        int32_t numFrames = (int32_t) (seconds * sampleRate);
+        if (numFrames < 1) {
+            numFrames = 1;
+        }
+        std::vector<float> left(numFrames);
+        std::vector<float> right(numFrames);
+        // Use separate generators so the channels are not correlated.
+        generateImpulse(left.data(), numFrames, sampleRate, seconds, 12345);
+        generateImpulse(right.data(), numFrames, sampleRate, seconds, 67890);
+        setImpulseResponse(left.data(), right.data(), numFrames);
+    }
+
+    /**
+     * Use an impulse response supplied by the caller.
+     * Do not call this from the audio callback.
+     */
+    void setImpulseResponse(const float *left, const float *right, int32_t numFrames) {
+        stopThread();
+        const float *impulses[kNumChannels] = {left, right};
+
+        int32_t headLength = (numFrames < kHeadLength) ? numFrames : kHeadLength;
+        mHasTail = (numFrames > kHeadLength);
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            mHead[channel].setup(impulses[channel], headLength, kHeadBlockSize);
+            memset(mInput[channel], 0, sizeof(mInput[channel]));
+            memset(mOutput[channel], 0, sizeof(mOutput[channel]));
+            if (mHasTail) {
+                mTail[channel].setup(&impulses[channel][kHeadLength],
+                                     numFrames - kHeadLength, kTailBlockSize);
+            }
+        }
+        mFifoIndex = 0;
+        mBlockCounter = 0;
+        mRequestedTail = -1;
+        mCompletedTail = -1;
+        mDeadlineMisses = 0;
+        mTailNanos = 0;
+        mTailCount = 0;
+        if (mHasTail) {
+            startThread();
+        }
+    }
+
+    /**
+     * @param mix 0.0 for dry only, 1.0 for wet only
+     */
+    void setMix(float mix) {
+        mMix = mix;
+    }
+
+    /**
+     * Process interleaved stereo in place.
+     * The wet signal is delayed by kHeadBlockSize frames.
+     */
+    void process(float *buffer, int32_t numFrames) {
+        const float dryGain = 1.0f - mMix;
+        const float wetGain = mMix;
+        for (int frame = 0; frame < numFrames; frame++) {
+            for (int channel = 0; channel < kNumChannels; channel++) {
+                float input = buffer[channel];
+                mInput[channel][mFifoIndex] = input;
+                buffer[channel] = (input * dryGain) + (mOutput[channel][mFifoIndex] * wetGain);
+            }
+            buffer += kNumChannels;
+            if (++mFifoIndex == kHeadBlockSize) {
+                processBlock();
+                mFifoIndex = 0;
+            }
+        }
+    }
+
+    /**
+     * @return number of times the callback had to wait for the background thread
+     */
+    int32_t getDeadlineMisses() const {
+        return mDeadlineMisses;
+    }
+
+    /**
+     * @return average time spent by the background thread on one tail block
+     */
+    int64_t getTailNanosPerBlock() const {
+        int32_t count = mTailCount;
+        return (count > 0) ? (mTailNanos / count) : 0;
+    }
+
+private:
+    void processBlock() {
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            mHead[channel].process(mInput[channel], mOutput[channel]);
+        }
+        if (mHasTail) {
+            int64_t startFrame = mBlockCounter * kHeadBlockSize;
+            int32_t offset = (int32_t) (startFrame % kTailBlockSize);
+
+            // Add the tail output that lines up with this block.
+            int64_t outputIndex = (startFrame - kHeadLength) / kTailBlockSize;
+            if (startFrame >= kHeadLength) {
+                waitForTail(outputIndex);
+                int slot = (int) (outputIndex & 1);
+                for (int channel = 0; channel < kNumChannels; channel++) {
+                    const float *tail = &mTailOutput[slot][channel][offset];
+                    float *output = mOutput[channel];
+                    for (int i = 0; i < kHeadBlockSize; i++) {
+                        output[i] += tail[i];
+                    }
+                }
+            }
+
+            // Collect input for the tail and hand off full blocks.
+            int64_t inputIndex = startFrame / kTailBlockSize;
+            int slot = (int) (inputIndex & 1);
+            for (int channel = 0; channel < kNumChannels; channel++) {
+                memcpy(&mTailInput[slot][channel][offset], mInput[channel],
+                       kHeadBlockSize * sizeof(float));
+            }
+            if ((offset + kHeadBlockSize) == kTailBlockSize) {
+                requestTail(inputIndex);
+            }
+        }
+        mBlockCounter++;
+    }
+
+    void requestTail(int64_t index) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mRequestedTail = index;
+        }
+        mCondition.notify_all();
+    }
+
+    void waitForTail(int64_t index) {
+        if (mCompletedTail.load() >= index) {
+            return;
+        }
+        mDeadlineMisses++;
+        std::unique_lock<std::mutex> lock(mLock);
+        mCondition.wait(lock, [this, index] { return mCompletedTail.load() >= index; });
+    }
+
+    static void *threadProc(void *arg) {
+        ((ConvolutionReverb *) arg)->runTailThread();
+        return NULL;
+    }
+
+    void runTailThread() {
+        while (true) {
+            int64_t index;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mCondition.wait(lock, [this] {
+                    return !mThreadEnabled || (mRequestedTail > mCompletedTail.load());
+                });
+                if (!mThreadEnabled) {
+                    break;
+                }
+                index = mCompletedTail.load() + 1;
+            }
+
+            int64_t startNanos = HostTools::getNanoTime();
+            int slot = (int) (index & 1);
+            for (int channel = 0; channel < kNumChannels; channel++) {
+                mTail[channel].process(mTailInput[slot][channel], mTailOutput[slot][channel]);
+            }
+            mTailNanos += HostTools::getNanoTime() - startNanos;
+            mTailCount++;
+
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                mCompletedTail = index;
+            }
+            mCondition.notify_all();
+        }
+    }
+
+    void startThread() {
+        mThreadEnabled = true;
+        mThread = new HostThread();
+        mThread->start(threadProc, this);
+    }
+
+    void stopThread() {
+        if (mThread != NULL) {
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                mThreadEnabled = false;
+            }
+            mCondition.notify_all();
+            mThread->join();
+            delete mThread;
+            mThread = NULL;
+        }
+    }
+
+    static void generateImpulse(float *impulse, int32_t numFrames, int32_t sampleRate,
+                                float seconds, uint32_t seed) {
+        // Decay by 60 dB over the length of the impulse.
+        double decayPerFrame = pow(0.001, 1.0 / (seconds * sampleRate));
+        double amplitude = 1.0;
+        double sumSquares = 0.0;
+        for (int i = 0; i < numFrames; i++) {
+            seed = (seed * 1664525) + 1013904223; // linear congruential
+            double noise = ((int32_t) seed) * (1.0 / 2147483648.0);
+            impulse[i] = (float) (noise * amplitude);
+            sumSquares += impulse[i] * impulse[i];
+            amplitude *= decayPerFrame;
+        }
+        // Normalize the energy so the reverb has about unity gain.
+        float scaler = (float) (1.0 / sqrt(sumSquares));
+        for (int i = 0; i < numFrames; i++) {
+            impulse[i] *= scaler;
+        }
+    }
+
+    float mMix;
+    bool  mHasTail = false;
+
+    PartitionedConvolver mHead[kNumChannels];
+    PartitionedConvolver mTail[kNumChannels];
+
+    // Used by the audio callback.
+    float   mInput[kNumChannels][kHeadBlockSize];
+    float   mOutput[kNumChannels][kHeadBlockSize];
+    int32_t mFifoIndex = 0;
+    int64_t mBlockCounter = 0;
+    int32_t mDeadlineMisses = 0;
+
+    // Double buffered so the callback can fill one block while the thread works on the other.
+    float   mTailInput[2][kNumChannels][kTailBlockSize];
+    float   mTailOutput[2][kNumChannels][kTailBlockSize];
+
+    // Shared with the background thread.
+    HostThread              *mThread = NULL;
+    std::mutex               mLock;
+    std::condition_variable  mCondition;
+    bool                     mThreadEnabled = false;
+    int64_t                  mRequestedTail = -1;
+    std::atomic<int64_t>     mCompletedTail{-1};
+    std::atomic<int64_t>     mTailNanos{0};
+    std::atomic<int32_t>     mTailCount{0};
+};
+
+#endif // SYNTHMARK_CONVOLUTION_REVERB_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_DELAY_LINE_H
+#define SYNTHMARK_DELAY_LINE_H
+
+#include <cstdint>
+#include <string.h>
+#include "SynthMark.h"
+
+/**
+ * Circular buffer of float samples used by the effects.
+ * The capacity is a power of two so the index can be wrapped with a mask.
+ */
+class DelayLine
+{
+public:
+    DelayLine()
+    : mBuffer(NULL)
+    , mMask(0)
+    , mWriteIndex(0)
+    {}
+
+    virtual ~DelayLine() {
+        delete[] mBuffer;
+    }
+
+    /**
+     * Allocate memory and clear the line. Do not call this from the audio callback.
+     * @param maxDelay largest delay in frames that will be read
+     */
+    void allocate(int32_t maxDelay) {
+        int32_t capacity = 1;
+        while (capacity < (maxDelay + 2)) {
+            capacity <<= 1;
+        }
+        delete[] mBuffer;
+        mBuffer = new float[capacity];
+        memset(mBuffer, 0, capacity * sizeof(float));
+        mMask = capacity - 1;
+        mWriteIndex = 0;
+    }
+
+    inline void write(float sample) {
+        mBuffer[mWriteIndex] = sample;
+        mWriteIndex = (mWriteIndex + 1) & mMask;
+    }
+
+    /**
+     * @param delay number of writes ago, at least 1
+     */
+    inline float read(int32_t delay) const {
+        return mBuffer[(mWriteIndex - delay) & mMask];
+    }
+
+    /**
+     * Read between two samples using linear interpolation.
+     * @param delay fractional number of writes ago, at least 1.0
+     */
+    inline float readInterpolated(float delay) const {
+        int32_t whole = (int32_t) delay;
+        float fraction = delay - whole;
+        float a = read(whole);
+        float b = read(whole + 1);
+        return a + (fraction * (b - a));
+    }
+
+private:
+    float   *mBuffer;
+    int32_t  mMask;
+    int32_t  mWriteIndex;
+};
+
+#endif // SYNTHMARK_DELAY_LINE_H
@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <math.h>
 #include "SynthMark.h"
+#include "SampleTraits.h"
 #include "tools/SynthTools.h"
 
 constexpr double kDPWVeryLowFrequency  = 2.0 * 0.1 / kSynthmarkSampleRate;
@@ -33,6 +34,7 @@ constexpr double kDPWVeryLowFrequency  = 2.0 * 0.1 / kSynthmarkSampleRate;
  * based on a paper by Antti Huovilainen and Vesa Valimaki:
  *  "New Approaches to Digital Subtractive Synthesis"
  */
+template <typename T = synth_float_t>
 class DifferentiatedParabola
 {
 public:
@@ -42,9 +44,9 @@ public:
 
     virtual ~DifferentiatedParabola() = default;
 
-    synth_float_t next(synth_float_t phase, synth_float_t phaseIncrement) {
-        synth_float_t dpw;
-        synth_float_t positivePhaseIncrement = (phaseIncrement < 0.0)
+    T next(T phase, T phaseIncrement) {
+        T dpw;
+        T positivePhaseIncrement = (phaseIncrement < 0.0)
                 ? phaseIncrement
                 : 0.0 - phaseIncrement;
 
@@ -54,9 +56,9 @@ public:
             dpw = phase;
         } else {
             // Calculate the parabola.
-            synth_float_t squared = phase * phase;
+            T squared = phase * phase;
             // Differentiate using a delayed value.
-            synth_float_t diffed = squared - mZ2;
+            T diffed = squared - mZ2;
             // Delay line.
             // TODO - Why Z2. Vesa's paper says use Z1?
             mZ2 = mZ1;
@@ -69,8 +71,8 @@ public:
     }
 
 private:
-    synth_float_t mZ1;
-    synth_float_t mZ2;
+    T mZ1;
+    T mZ2;
 };
 
 #endif // SYNTHMARK_DIFFERENTIATED_PARABOLA_H
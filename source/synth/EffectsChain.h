@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_EFFECTS_CHAIN_H
+#define SYNTHMARK_EFFECTS_CHAIN_H
+
+#include <cstdint>
+#include <string>
+#include "SynthMark.h"
+#include "ConvolutionReverb.h"
+#include "FdnReverb.h"
+#include "StereoChorus.h"
+#include "TempoDelay.h"
+#include "tools/HostTools.h"
+
+// Bits for selecting the effects.
+enum EffectsFlags {
+    EFFECTS_NONE   = 0,
+    EFFECTS_CHORUS = 1 << 0,
+    EFFECTS_DELAY  = 1 << 1,
+    EFFECTS_REVERB = 1 << 2,
+    EFFECTS_CONVOLUTION = 1 << 3,
+};
+
+// One stage for each bit in EffectsFlags, in the order they are processed.
+constexpr int32_t kEffectsNumStages = 4;
+
+constexpr float kDefaultImpulseSeconds = 3.0f;
+
+/**
+ * Master effects that process the stereo mix after the Synthesizer.
+ * The cost is fixed per frame and does not depend on the number of voices.
+ */
+class EffectsChain
+{
+public:
+    EffectsChain() {}
+
+    virtual ~EffectsChain() {
+        delete mConvolution;
+    }
+
+    /**
+     * Allocate the delay lines for the enabled effects.
+     * Do not call this from the audio callback.
+     * @param impulseSeconds length of the synthetic impulse response for the convolution
+     */
+    void setup(int32_t sampleRate, int32_t flags,
+               float impulseSeconds = kDefaultImpulseSeconds) {
+        mFlags = flags;
+        resetTiming();
+        delete mConvolution;
+        mConvolution = NULL;
+        if (mFlags & EFFECTS_CONVOLUTION) {
+            // Allocated only when needed because the buffers are large.
+            mConvolution = new ConvolutionReverb();
+            mConvolution->setup(sampleRate, impulseSeconds);
+        }
+        if (mFlags & EFFECTS_CHORUS) {
+            mChorus.setup(sampleRate);
+        }
+        if (mFlags & EFFECTS_DELAY) {
+            mDelay.setup(sampleRate);
+        }
+        if (mFlags & EFFECTS_REVERB) {
+            mReverb.setup(sampleRate);
+        }
+    }
+
+    bool isEnabled() const {
+        return mFlags != EFFECTS_NONE;
+    }
+
+    int32_t getFlags() const {
+        return mFlags;
+    }
+
+    /**
+     * Process interleaved stereo in place. Each stage is timed separately.
+     */
+    void process(float *buffer, int32_t numFrames) {
+        if (mFlags & EFFECTS_CHORUS) {
+            processStage(mChorus, 0, buffer, numFrames);
+        }
+        if (mFlags & EFFECTS_DELAY) {
+            processStage(mDelay, 1, buffer, numFrames);
+        }
+        if (mFlags & EFFECTS_REVERB) {
+            processStage(mReverb, 2, buffer, numFrames);
+        }
+        if (mConvolution != NULL) {
+            processStage(*mConvolution, 3, buffer, numFrames);
+        }
+    }
+
+    void resetTiming() {
+        for (int32_t stage = 0; stage < kEffectsNumStages; stage++) {
+            mStageNanos[stage] = 0;
+        }
+    }
+
+    /**
+     * @param stage 0 to kEffectsNumStages - 1, the bit number in EffectsFlags
+     * @return time spent in the stage since the last resetTiming()
+     */
+    int64_t getStageNanos(int32_t stage) const {
+        return mStageNanos[stage];
+    }
+
+    static const char *stageToString(int32_t stage) {
+        static const char *kNames[kEffectsNumStages] = {
+            "chorus", "delay", "reverb", "convolution"
+        };
+        return (stage >= 0 && stage < kEffectsNumStages) ? kNames[stage] : "?";
+    }
+
+    /**
+     * @return the convolution reverb or NULL if it is not enabled
+     */
+    ConvolutionReverb *getConvolution() {
+        return mConvolution;
+    }
+
+    static std::string flagsToString(int32_t flags) {
+        std::string text;
+        if (flags & EFFECTS_CHORUS) text += "chorus,";
+        if (flags & EFFECTS_DELAY) text += "delay,";
+        if (flags & EFFECTS_REVERB) text += "reverb,";
+        if (flags & EFFECTS_CONVOLUTION) text += "convolution,";
+        if (text.empty()) {
+            return "none";
+        }
+        text.pop_back(); // trailing comma
+        return text;
+    }
+
+private:
+    template <typename Effect>
+    void processStage(Effect &effect, int32_t stage, float *buffer, int32_t numFrames) {
+        int64_t start = HostTools::getNanoTime();
+        effect.process(buffer, numFrames);
+        mStageNanos[stage] += HostTools::getNanoTime() - start;
+    }
+
+    int32_t      mFlags = EFFECTS_NONE;
+    int64_t      mStageNanos[kEffectsNumStages] = {};
+    StereoChorus mChorus;
+    TempoDelay   mDelay;
+    FdnReverb    mReverb;
+    ConvolutionReverb *mConvolution = NULL;
+};
+
+#endif // SYNTHMARK_EFFECTS_CHAIN_H
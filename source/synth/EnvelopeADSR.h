@@ -32,7 +32,8 @@
  * other parameters.
  */
 
-class EnvelopeADSR  : public UnitGenerator
+template <typename T = synth_float_t>
+class EnvelopeADSR  : public UnitGenerator<T>
 {
 public:
     EnvelopeADSR()
@@ -88,7 +89,7 @@ public:
             switch (mState) {
                 case IDLE:
                     for (; i < numSamples; i++) {
-                        output[i] = mLevel;
+                        this->output[i] = mLevel;
                         if (triggered) {
                             startAttack();
                             break;
@@ -102,11 +103,11 @@ public:
                         mLevel += increment;
                         if (mLevel >= 1.0) {
                             mLevel = 1.0;
-                            output[i] = mLevel;
+                            this->output[i] = mLevel;
                             startDecay();
                             break;
                         } else {
-                            output[i] = mLevel;
+                            this->output[i] = mLevel;
                             if (!triggered) {
                                 startRelease();
                                 break;
@@ -117,7 +118,7 @@ public:
 
                 case DECAYING:
                     for (; i < numSamples; i++) {
-                        output[i] = mLevel;
+                        this->output[i] = mLevel;
                         mLevel *= mScaler; // exponential decay
                         if (mLevel < kAmplitudeDb96) {
                             startIdle();
@@ -136,7 +137,7 @@ public:
                 case SUSTAINING:
                     for (; i < numSamples; i++) {
                         mLevel = mSustainLevel;
-                        output[i] = mLevel;
+                        this->output[i] = mLevel;
                         if (!triggered) {
                             startRelease();
                             break;
@@ -146,7 +147,7 @@ public:
 
                 case RELEASING:
                     for (; i < numSamples; i++) {
-                        output[i] = mLevel;
+                        this->output[i] = mLevel;
                         mLevel *= mScaler; // exponential decay
                         if (triggered) {
                             startAttack();
@@ -173,7 +174,7 @@ private:
             mLevel = 1.0;
             startDecay();
         } else {
-            increment = mSamplePeriod / mAttack;
+            increment = this->mSamplePeriod / mAttack;
             mState = State::ATTACKING;
         }
     }
@@ -183,7 +184,7 @@ private:
         if (duration < MIN_DURATION) {
             startSustain();
         } else {
-            mScaler = SynthTools::convertTimeToExponentialScaler(duration, mSampleRate);
+            mScaler = SynthTools::convertTimeToExponentialScaler(duration, this->mSampleRate);
             mState = State::DECAYING;
         }
     }
@@ -197,7 +198,7 @@ private:
         if (duration < MIN_DURATION) {
             duration = MIN_DURATION;
         }
-        mScaler = SynthTools::convertTimeToExponentialScaler(duration, mSampleRate);
+        mScaler = SynthTools::convertTimeToExponentialScaler(duration, this->mSampleRate);
         mState = State::RELEASING;
     }
 
@@ -207,7 +208,7 @@ private:
      * Level for the sustain stage. The envelope will hold here until the input goes to zero or
      * less. This should be set between 0.0 and 1.0.
      */
-    synth_float_t mSustainLevel;
+    T mSustainLevel;
     /**
      * Time in seconds to go from 0 dB to -90 dB. This stage is triggered when the input goes to
      * zero or less. The release stage will start from the sustain level. But we calculate the time
@@ -217,9 +218,9 @@ private:
     synth_float_t mRelease;
 
     State mState = State::IDLE;
-    synth_float_t mScaler = 1.0;
-    synth_float_t mLevel = 0.0;
-    synth_float_t increment = 0;
+    T mScaler = 1.0;
+    T mLevel = 0.0;
+    T increment = 0;
     bool triggered = false;
 
 };
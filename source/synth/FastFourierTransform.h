@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_FAST_FOURIER_TRANSFORM_H
+#define SYNTHMARK_FAST_FOURIER_TRANSFORM_H
+
+#include <cassert>
+#include <cstdint>
+#include <math.h>
+#include <vector>
+#include "SynthMark.h"
+
+/**
+ * Complex FFT for a power of two size.
+ *
+ * This uses the Stockham autosort algorithm with radix-4 butterflies and a
+ * final radix-2 stage when the size is not a power of four. Stockham does
+ * not need a bit reversal pass. The real and imaginary parts are kept in
+ * separate arrays and the inner loop runs over contiguous memory so the
+ * compiler can vectorize the butterflies with NEON or SSE.
+ */
+class FastFourierTransform
+{
+public:
+    explicit FastFourierTransform(int32_t size)
+    : mSize(size)
+    , mTwiddleReal(size)
+    , mTwiddleImag(size)
+    , mScratchReal(size)
+    , mScratchImag(size)
+    {
+        assert(size >= 2 && (size & (size - 1)) == 0);
+        for (int k = 0; k < size; k++) {
+            double angle = -2.0 * M_PI * k / size;
+            mTwiddleReal[k] = (float) cos(angle);
+            mTwiddleImag[k] = (float) sin(angle);
+        }
+    }
+
+    virtual ~FastFourierTransform() = default;
+
+    int32_t getSize() const {
+        return mSize;
+    }
+
+    /**
+     * Forward transform in place, not normalized.
+     */
+    void forward(float *real, float *imag) {
+        transform(real, imag);
+    }
+
+    /**
+     * Inverse transform in place, scaled by 1/size.
+     */
+    void inverse(float *real, float *imag) {
+        // Use the forward transform on the complex conjugate.
+        for (int i = 0; i < mSize; i++) {
+            imag[i] = -imag[i];
+        }
+        transform(real, imag);
+        const float scaler = 1.0f / mSize;
+        for (int i = 0; i < mSize; i++) {
+            real[i] *= scaler;
+            imag[i] *= -scaler;
+        }
+    }
+
+private:
+    void transform(float *real, float *imag) {
+        float *ar = real;
+        float *ai = imag;
+        float *br = mScratchReal.data();
+        float *bi = mScratchImag.data();
+        int32_t n = mSize;
+        int32_t s = 1; // stride
+        while (n >= 4) {
+            const int32_t n1 = n / 4;
+            for (int p = 0; p < n1; p++) {
+                const float w1r = mTwiddleReal[p * s];
+                const float w1i = mTwiddleImag[p * s];
+                const float w2r = mTwiddleReal[2 * p * s];
+                const float w2i = mTwiddleImag[2 * p * s];
+                const float w3r = mTwiddleReal[3 * p * s];
+                const float w3i = mTwiddleImag[3 * p * s];
+                const float *xar = &ar[s * p];
+                const float *xai = &ai[s * p];
+                const float *xbr = &ar[s * (p + n1)];
+                const float *xbi = &ai[s * (p + n1)];
+                const float *xcr = &ar[s * (p + 2 * n1)];
+                const float *xci = &ai[s * (p + 2 * n1)];
+                const float *xdr = &ar[s * (p + 3 * n1)];
+                const float *xdi = &ai[s * (p + 3 * n1)];
+                float *y0r = &br[s * (4 * p)];
+                float *y0i = &bi[s * (4 * p)];
+                float *y1r = &br[s * (4 * p + 1)];
+                float *y1i = &bi[s * (4 * p + 1)];
+                float *y2r = &br[s * (4 * p + 2)];
+                float *y2i = &bi[s * (4 * p + 2)];
+                float *y3r = &br[s * (4 * p + 3)];
+                float *y3i = &bi[s * (4 * p + 3)];
+                for (int q = 0; q < s; q++) {
+                    const float apcr = xar[q] + xcr[q];
+                    const float apci = xai[q] + xci[q];
+                    const float amcr = xar[q] - xcr[q];
+                    const float amci = xai[q] - xci[q];
+                    const float bpdr = xbr[q] + xdr[q];
+                    const float bpdi = xbi[q] + xdi[q];
+                    // j * (b - d)
+                    const float jbmdr = xdi[q] - xbi[q];
+                    const float jbmdi = xbr[q] - xdr[q];
+
+                    y0r[q] = apcr + bpdr;
+                    y0i[q] = apci + bpdi;
+
+                    const float t1r = amcr - jbmdr;
+                    const float t1i = amci - jbmdi;
+                    y1r[q] = (w1r * t1r) - (w1i * t1i);
+                    y1i[q] = (w1r * t1i) + (w1i * t1r);
+
+                    const float t2r = apcr - bpdr;
+                    const float t2i = apci - bpdi;
+                    y2r[q] = (w2r * t2r) - (w2i * t2i);
+                    y2i[q] = (w2r * t2i) + (w2i * t2r);
+
+                    const float t3r = amcr + jbmdr;
+                    const float t3i = amci + jbmdi;
+                    y3r[q] = (w3r * t3r) - (w3i * t3i);
+                    y3i[q] = (w3r * t3i) + (w3i * t3r);
+                }
+            }
+            // The output of this stage is the input of the next.
+            float *tempr = ar;
+            float *tempi = ai;
+            ar = br;
+            ai = bi;
+            br = tempr;
+            bi = tempi;
+            n = n1;
+            s *= 4;
+        }
+
+        // Write the final stage to the caller's arrays.
+        float *dr = (ar == real) ? ar : br;
+        float *di = (ar == real) ? ai : bi;
+        if (n == 2) {
+            for (int q = 0; q < s; q++) {
+                const float xr0 = ar[q];
+                const float xi0 = ai[q];
+                const float xr1 = ar[q + s];
+                const float xi1 = ai[q + s];
+                dr[q] = xr0 + xr1;
+                di[q] = xi0 + xi1;
+                dr[q + s] = xr0 - xr1;
+                di[q + s] = xi0 - xi1;
+            }
+        } else if (ar != real) {
+            for (int i = 0; i < mSize; i++) {
+                dr[i] = ar[i];
+                di[i] = ai[i];
+            }
+        }
+    }
+
+    int32_t mSize;
+    std::vector<float> mTwiddleReal;
+    std::vector<float> mTwiddleImag;
+    std::vector<float> mScratchReal;
+    std::vector<float> mScratchImag;
+};
+
+/**
+ * FFT of a real signal using a complex FFT of half the size.
+ * The even samples are packed into the real part and the odd samples
+ * into the imaginary part, then the two spectra are separated.
+ */
+class RealFastFourierTransform
+{
+public:
+    explicit RealFastFourierTransform(int32_t size)
+    : mSize(size)
+    , mHalfSize(size / 2)
+    , mComplex(size / 2)
+    , mTwiddleReal((size / 2) + 1)
+    , mTwiddleImag((size / 2) + 1)
+    , mPackedReal(size / 2)
+    , mPackedImag(size / 2)
+    {
+        assert(size >= 4);
+        for (int k = 0; k <= mHalfSize; k++) {
+            double angle = -2.0 * M_PI * k / size;
+            mTwiddleReal[k] = (float) cos(angle);
+            mTwiddleImag[k] = (float) sin(angle);
+        }
+    }
+
+    virtual ~RealFastFourierTransform() = default;
+
+    int32_t getSize() const {
+        return mSize;
+    }
+
+    /**
+     * @return number of complex bins in the spectrum, size/2 + 1
+     */
+    int32_t getNumBins() const {
+        return mHalfSize + 1;
+    }
+
+    /**
+     * @param input size real samples
+     * @param real getNumBins() values
+     * @param imag getNumBins() values
+     */
+    void forward(const float *input, float *real, float *imag) {
+        float *zr = mPackedReal.data();
+        float *zi = mPackedImag.data();
+        for (int i = 0; i < mHalfSize; i++) {
+            zr[i] = input[2 * i];
+            zi[i] = input[(2 * i) + 1];
+        }
+        mComplex.forward(zr, zi);
+
+        for (int k = 0; k <= mHalfSize; k++) {
+            const int k1 = (k == mHalfSize) ? 0 : k;
+            const int k2 = (k == 0) ? 0 : (mHalfSize - k);
+            // Z[k] and conj(Z[N/2 - k])
+            const float ar = zr[k1];
+            const float ai = zi[k1];
+            const float br = zr[k2];
+            const float bi = -zi[k2];
+            // Spectrum of the even samples.
+            const float er = 0.5f * (ar + br);
+            const float ei = 0.5f * (ai + bi);
+            // Spectrum of the odd samples, -j * (a - b) / 2
+            const float orr = 0.5f * (ai - bi);
+            const float oi = -0.5f * (ar - br);
+            const float wr = mTwiddleReal[k];
+            const float wi = mTwiddleImag[k];
+            real[k] = er + (wr * orr) - (wi * oi);
+            imag[k] = ei + (wr * oi) + (wi * orr);
+        }
+    }
+
+    /**
+     * Inverse of forward(), scaled so that inverse(forward(x)) == x.
+     */
+    void inverse(const float *real, const float *imag, float *output) {
+        float *zr = mPackedReal.data();
+        float *zi = mPackedImag.data();
+        for (int k = 0; k < mHalfSize; k++) {
+            const float ar = real[k];
+            const float ai = imag[k];
+            const float br = real[mHalfSize - k];
+            const float bi = -imag[mHalfSize - k];
+            const float er = 0.5f * (ar + br);
+            const float ei = 0.5f * (ai + bi);
+            const float tr = 0.5f * (ar - br);
+            const float ti = 0.5f * (ai - bi);
+            // Multiply by the conjugate twiddle to get the odd spectrum.
+            const float wr = mTwiddleReal[k];
+            const float wi = mTwiddleImag[k];
+            const float orr = (tr * wr) + (ti * wi);
+            const float oi = (ti * wr) - (tr * wi);
+            zr[k] = er - oi;
+            zi[k] = ei + orr;
+        }
+        mComplex.inverse(zr, zi);
+        for (int i = 0; i < mHalfSize; i++) {
+            output[2 * i] = zr[i];
+            output[(2 * i) + 1] = zi[i];
+        }
+    }
+
+private:
+    int32_t mSize;
+    int32_t mHalfSize;
+    FastFourierTransform mComplex;
+    std::vector<float> mTwiddleReal;
+    std::vector<float> mTwiddleImag;
+    std::vector<float> mPackedReal;
+    std::vector<float> mPackedImag;
+};
+
+#endif // SYNTHMARK_FAST_FOURIER_TRANSFORM_H
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_FDN_REVERB_H
+#define SYNTHMARK_FDN_REVERB_H
+
+#include <cstdint>
+#include <math.h>
+#include <string.h>
+#include "SynthMark.h"
+#include "DelayLine.h"
+
+/**
+ * Stereo reverb based on a Feedback Delay Network.
+ * The delay lines are mixed with a Hadamard matrix, which is lossless
+ * and can be calculated with a butterfly network using only adds.
+ *
+ * The per-line math is done on small fixed-size arrays so the compiler
+ * can vectorize it with NEON or SSE.
+ */
+class FdnReverb
+{
+public:
+    // Must be a power of two for the Hadamard matrix.
+    static constexpr int kNumLines = 8;
+
+    FdnReverb()
+    : mDecayTime(2.0f)
+    , mDamping(0.3f)
+    , mMix(0.25f)
+    {
+        memset(mLowpass, 0, sizeof(mLowpass));
+    }
+
+    virtual ~FdnReverb() = default;
+
+    void setup(int32_t sampleRate) {
+        // Mutually prime lengths in frames at 48000 Hz, about 23 to 58 msec.
+        static const int32_t kLengths48000[kNumLines] = {
+                1109, 1327, 1559, 1801, 2017, 2269, 2521, 2797
+        };
+        mSampleRate = sampleRate;
+        for (int i = 0; i < kNumLines; i++) {
+            mLengths[i] = (int32_t) (((int64_t) kLengths48000[i] * sampleRate) / 48000);
+            mLines[i].allocate(mLengths[i]);
+            // Alternate input polarity so the lines do not start out correlated.
+            mInputGains[i] = (i & 1) ? -1.0f : 1.0f;
+        }
+        memset(mLowpass, 0, sizeof(mLowpass));
+        calculateGains();
+    }
+
+    /**
+     * Time in seconds for the reverb tail to decay by 60 dB.
+     */
+    void setDecayTime(float seconds) {
+        mDecayTime = seconds;
+        calculateGains();
+    }
+
+    /**
+     * @param mix 0.0 for dry only, 1.0 for wet only
+     */
+    void setMix(float mix) {
+        mMix = mix;
+    }
+
+    /**
+     * Process interleaved stereo in place.
+     */
+    void process(float *buffer, int32_t numFrames) {
+        const float dryGain = 1.0f - mMix;
+        const float wetGain = mMix * (2.0f / kNumLines);
+        const float dampingCoefficient = 1.0f - mDamping;
+        float lineOutputs[kNumLines];
+        for (int frame = 0; frame < numFrames; frame++) {
+            float left = buffer[0];
+            float right = buffer[1];
+            float input = 0.5f * (left + right);
+
+            for (int i = 0; i < kNumLines; i++) {
+                lineOutputs[i] = mLines[i].read(mLengths[i]);
+            }
+            // One pole lowpass so the high frequencies decay faster.
+            for (int i = 0; i < kNumLines; i++) {
+                mLowpass[i] += dampingCoefficient * (lineOutputs[i] - mLowpass[i]);
+                lineOutputs[i] = mLowpass[i];
+            }
+
+            float wetLeft = 0.0f;
+            float wetRight = 0.0f;
+            for (int i = 0; i < kNumLines; i += 2) {
+                wetLeft += lineOutputs[i];
+                wetRight += lineOutputs[i + 1];
+            }
+
+            hadamard(lineOutputs);
+            for (int i = 0; i < kNumLines; i++) {
+                mLines[i].write((input * mInputGains[i]) + (lineOutputs[i] * mFeedbackGains[i]));
+            }
+
+            *buffer++ = (left * dryGain) + (wetLeft * wetGain);
+            *buffer++ = (right * dryGain) + (wetRight * wetGain);
+        }
+    }
+
+private:
+    /**
+     * Multiply by a normalized Hadamard matrix in place using a butterfly network.
+     */
+    static inline void hadamard(float *values) {
+        for (int span = 1; span < kNumLines; span <<= 1) {
+            for (int i = 0; i < kNumLines; i += (span << 1)) {
+                for (int j = i; j < (i + span); j++) {
+                    float a = values[j];
+                    float b = values[j + span];
+                    values[j] = a + b;
+                    values[j + span] = a - b;
+                }
+            }
+        }
+        const float scaler = 1.0f / sqrtf((float) kNumLines);
+        for (int i = 0; i < kNumLines; i++) {
+            values[i] *= scaler;
+        }
+    }
+
+    // Calculate the gain for each line so that it decays by 60 dB in mDecayTime.
+    void calculateGains() {
+        for (int i = 0; i < kNumLines; i++) {
+            double secondsPerPass = (double) mLengths[i] / mSampleRate;
+            mFeedbackGains[i] = (float) pow(10.0, (-3.0 * secondsPerPass) / mDecayTime);
+        }
+    }
+
+    DelayLine mLines[kNumLines];
+    int32_t   mLengths[kNumLines] = {};
+    float     mInputGains[kNumLines] = {};
+    float     mFeedbackGains[kNumLines] = {};
+    float     mLowpass[kNumLines];
+    int32_t   mSampleRate = kSynthmarkSampleRate;
+
+    float     mDecayTime;   // seconds
+    float     mDamping;     // 0.0 to 1.0
+    float     mMix;
+};
+
+#endif // SYNTHMARK_FDN_REVERB_H
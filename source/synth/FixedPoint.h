@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_FIXED_POINT_H
+#define SYNTHMARK_FIXED_POINT_H
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <math.h>
+
+/**
+ * Signed fixed-point number with kFractionBits of fraction.
+ * All arithmetic saturates at the limits of IntType instead of wrapping.
+ * WideType must be able to hold the product of two IntType values.
+ *
+ * This lets the synthesizer templates be instantiated with integer math
+ * for targets that have a weak FPU.
+ */
+template <typename IntType, typename WideType, int kFractionBits>
+class FixedPoint
+{
+public:
+    FixedPoint() : mRaw(0) {}
+
+    // Implicit so that constants like 0.5 can be used in templated code.
+    FixedPoint(double value) : mRaw(fromDouble(value)) {}
+
+    /**
+     * Convert from a fixed-point value with a different number of fraction bits.
+     */
+    template <int kOtherFractionBits>
+    explicit FixedPoint(FixedPoint<IntType, WideType, kOtherFractionBits> other)
+    : mRaw(saturate(shift((WideType) other.raw(), kFractionBits - kOtherFractionBits))) {}
+
+    static FixedPoint fromRaw(IntType raw) {
+        FixedPoint result;
+        result.mRaw = raw;
+        return result;
+    }
+
+    IntType raw() const {
+        return mRaw;
+    }
+
+    explicit operator float() const {
+        return (float) mRaw * (1.0f / kOne);
+    }
+
+    explicit operator double() const {
+        return (double) mRaw * (1.0 / kOne);
+    }
+
+    /**
+     * Add without saturation so the value wraps around like an oscillator phase.
+     */
+    FixedPoint wrappingAdd(FixedPoint other) const {
+        typedef typename std::make_unsigned<IntType>::type UnsignedType;
+        return fromRaw((IntType) (UnsignedType) ((UnsignedType) mRaw + (UnsignedType) other.mRaw));
+    }
+
+    friend FixedPoint operator+(FixedPoint a, FixedPoint b) {
+        return fromRaw(saturate((WideType) a.mRaw + b.mRaw));
+    }
+
+    friend FixedPoint operator-(FixedPoint a, FixedPoint b) {
+        return fromRaw(saturate((WideType) a.mRaw - b.mRaw));
+    }
+
+    friend FixedPoint operator*(FixedPoint a, FixedPoint b) {
+        return fromRaw(saturate(((WideType) a.mRaw * b.mRaw) >> kFractionBits));
+    }
+
+    friend FixedPoint operator/(FixedPoint a, FixedPoint b) {
+        if (b.mRaw == 0) {
+            return fromRaw((a.mRaw < 0) ? kMin : kMax);
+        }
+        return fromRaw(saturate(((WideType) a.mRaw * (((WideType) 1) << kFractionBits)) / b.mRaw));
+    }
+
+    FixedPoint operator-() const {
+        return fromRaw(saturate(-((WideType) mRaw)));
+    }
+
+    FixedPoint &operator+=(FixedPoint other) { return *this = *this + other; }
+    FixedPoint &operator-=(FixedPoint other) { return *this = *this - other; }
+    FixedPoint &operator*=(FixedPoint other) { return *this = *this * other; }
+
+    friend bool operator<(FixedPoint a, FixedPoint b)  { return a.mRaw < b.mRaw; }
+    friend bool operator>(FixedPoint a, FixedPoint b)  { return a.mRaw > b.mRaw; }
+    friend bool operator<=(FixedPoint a, FixedPoint b) { return a.mRaw <= b.mRaw; }
+    friend bool operator>=(FixedPoint a, FixedPoint b) { return a.mRaw >= b.mRaw; }
+    friend bool operator==(FixedPoint a, FixedPoint b) { return a.mRaw == b.mRaw; }
+    friend bool operator!=(FixedPoint a, FixedPoint b) { return a.mRaw != b.mRaw; }
+
+    static constexpr IntType kMax = std::numeric_limits<IntType>::max();
+    static constexpr IntType kMin = std::numeric_limits<IntType>::min();
+
+private:
+    static constexpr double kOne = (double) (((WideType) 1) << kFractionBits);
+
+    static IntType saturate(WideType value) {
+        if (value > kMax) {
+            return kMax;
+        } else if (value < kMin) {
+            return kMin;
+        }
+        return (IntType) value;
+    }
+
+    static WideType shift(WideType value, int bits) {
+        return (bits >= 0) ? (value * (((WideType) 1) << bits)) : (value >> -bits);
+    }
+
+    static IntType fromDouble(double value) {
+        double scaled = value * kOne;
+        // Round to nearest so tiny thresholds do not collapse to zero.
+        scaled += (scaled < 0.0) ? -0.5 : 0.5;
+        if (scaled >= (double) kMax) {
+            return kMax;
+        } else if (scaled <= (double) kMin) {
+            return kMin;
+        }
+        return (IntType) scaled;
+    }
+
+    IntType mRaw;
+};
+
+/**
+ * Multiply values with different formats, for example a signal by a coefficient
+ * that needs headroom above 1.0. The result has the format of the first operand.
+ */
+template <typename IntType, typename WideType, int kFractionBits, int kOtherFractionBits>
+inline FixedPoint<IntType, WideType, kFractionBits> operator*(
+        FixedPoint<IntType, WideType, kFractionBits> a,
+        FixedPoint<IntType, WideType, kOtherFractionBits> b) {
+    WideType product = ((WideType) a.raw() * b.raw()) >> kOtherFractionBits;
+    if (product > FixedPoint<IntType, WideType, kFractionBits>::kMax) {
+        product = FixedPoint<IntType, WideType, kFractionBits>::kMax;
+    } else if (product < FixedPoint<IntType, WideType, kFractionBits>::kMin) {
+        product = FixedPoint<IntType, WideType, kFractionBits>::kMin;
+    }
+    return FixedPoint<IntType, WideType, kFractionBits>::fromRaw((IntType) product);
+}
+
+// Signals between -1.0 and +1.0.
+typedef FixedPoint<int32_t, int64_t, 31> synth_q31_t;
+typedef FixedPoint<int16_t, int32_t, 15> synth_q15_t;
+
+// Coefficients that need a range of +/- 4.0, for example in a biquad filter.
+typedef FixedPoint<int32_t, int64_t, 29> synth_q29_t;
+typedef FixedPoint<int16_t, int32_t, 13> synth_q13_t;
+
+#endif // SYNTHMARK_FIXED_POINT_H
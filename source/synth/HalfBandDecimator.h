@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_HALF_BAND_DECIMATOR_H
+#define SYNTHMARK_HALF_BAND_DECIMATOR_H
+
+#include <cassert>
+#include <cstdint>
+#include <math.h>
+#include <string.h>
+#include "SynthMark.h"
+
+// Largest number of samples passed to a decimator in one call.
+constexpr int kHalfBandMaxInput = kSynthmarkFramesPerRender * kSynthmarkMaxOversampling;
+
+/**
+ * Reduce the sample rate by two using a windowed-sinc half-band FIR lowpass filter.
+ *
+ * Every other coefficient of a half-band filter is zero except the center tap,
+ * which is 0.5. So the filter is split into two polyphase branches.
+ * The odd input samples only see the center tap. The even input samples
+ * are convolved with the symmetric non-zero taps.
+ *
+ * The loops run over the output samples in the inner loop with contiguous
+ * buffers so the compiler can vectorize them with NEON or SSE.
+ */
+class HalfBandDecimator
+{
+public:
+    // Number of symmetric pairs of non-zero taps. The filter has (4 * kHalfTaps) - 1 taps.
+    static constexpr int kHalfTaps = 8;
+    static constexpr int kNumTaps = (4 * kHalfTaps) - 1;
+
+    HalfBandDecimator() {
+        calculateCoefficients();
+        memset(mEven, 0, sizeof(mEven));
+        memset(mOdd, 0, sizeof(mOdd));
+    }
+
+    virtual ~HalfBandDecimator() = default;
+
+    /**
+     * @param input numInput samples at the high rate
+     * @param output numInput / 2 samples at the low rate
+     * @param numInput must be even and no more than kHalfBandMaxInput
+     */
+    void process(const float *input, float *output, int32_t numInput) {
+        assert((numInput & 1) == 0);
+        assert(numInput <= kHalfBandMaxInput);
+        const int32_t numOutput = numInput / 2;
+
+        // Split the input into the two polyphase branches after the saved history.
+        float *even = &mEven[kHistory];
+        float *odd = &mOdd[kHistory];
+        for (int i = 0; i < numOutput; i++) {
+            even[i] = input[2 * i];
+            odd[i] = input[(2 * i) + 1];
+        }
+
+        // Center tap.
+        const float *center = &mOdd[kHalfTaps - 1];
+        for (int i = 0; i < numOutput; i++) {
+            output[i] = 0.5f * center[i];
+        }
+
+        // Symmetric taps. Fold the pairs to halve the number of multiplies.
+        for (int tap = 0; tap < kHalfTaps; tap++) {
+            const float coefficient = mCoefficients[tap];
+            const float *early = &mEven[tap];
+            const float *late = &mEven[kHistory - tap];
+            for (int i = 0; i < numOutput; i++) {
+                output[i] += coefficient * (early[i] + late[i]);
+            }
+        }
+
+        // Save the most recent samples for the next call.
+        memmove(mEven, &mEven[numOutput], kHistory * sizeof(float));
+        memmove(mOdd, &mOdd[numOutput], kHistory * sizeof(float));
+    }
+
+private:
+    // Each branch needs half of the (kNumTaps - 1) previous input samples.
+    static constexpr int kHistory = (kNumTaps - 1) / 2;
+
+    // Blackman windowed sinc with a cutoff at one quarter of the input rate.
+    void calculateCoefficients() {
+        const int center = kNumTaps / 2;
+        double sum = 0.0;
+        for (int tap = 0; tap < kHalfTaps; tap++) {
+            int index = 2 * tap;
+            double x = 0.5 * (index - center);
+            double sinc = sin(M_PI * x) / (M_PI * x);
+            double phase = (2.0 * M_PI * index) / (kNumTaps - 1);
+            double window = 0.42 - (0.5 * cos(phase)) + (0.08 * cos(2.0 * phase));
+            mCoefficients[tap] = (float) (0.5 * sinc * window);
+            sum += 2.0 * mCoefficients[tap];
+        }
+        // Normalize for unity gain at DC. The center tap provides the other half.
+        for (int tap = 0; tap < kHalfTaps; tap++) {
+            mCoefficients[tap] = (float) (mCoefficients[tap] * 0.5 / sum);
+        }
+    }
+
+    float mCoefficients[kHalfTaps];
+    float mEven[kHistory + (kHalfBandMaxInput / 2)];
+    float mOdd[kHistory + (kHalfBandMaxInput / 2)];
+};
+
+/**
+ * Cascade of half-band decimators that reduces the sample rate
+ * by 1, 2, 4 or 8.
+ */
+class OversamplingDecimator
+{
+public:
+    OversamplingDecimator()
+    : mFactor(1)
+    , mNumStages(0) {}
+
+    virtual ~OversamplingDecimator() = default;
+
+    /**
+     * @return 0 or -1 if the factor is not supported
+     */
+    int32_t setFactor(int32_t factor) {
+        int32_t numStages = 0;
+        while ((1 << numStages) < factor) {
+            numStages++;
+        }
+        if ((1 << numStages) != factor || numStages > kMaxStages) {
+            return -1;
+        }
+        mFactor = factor;
+        mNumStages = numStages;
+        return 0;
+    }
+
+    int32_t getFactor() const {
+        return mFactor;
+    }
+
+    /**
+     * @param input numOutput * factor samples
+     * @param output numOutput samples
+     */
+    void process(const float *input, float *output, int32_t numOutput) {
+        if (mNumStages == 0) {
+            memcpy(output, input, numOutput * sizeof(float));
+            return;
+        }
+        int32_t numInput = numOutput * mFactor;
+        const float *stageInput = input;
+        for (int stage = 0; stage < mNumStages; stage++) {
+            float *stageOutput = (stage == (mNumStages - 1))
+                    ? output
+                    : mScratch[stage & 1];
+            mStages[stage].process(stageInput, stageOutput, numInput);
+            stageInput = stageOutput;
+            numInput /= 2;
+        }
+    }
+
+private:
+    static constexpr int kMaxStages = 3; // log2(kSynthmarkMaxOversampling)
+
+    int32_t mFactor;
+    int32_t mNumStages;
+    HalfBandDecimator mStages[kMaxStages];
+    float mScratch[2][kHalfBandMaxInput / 2];
+};
+
+#endif // SYNTHMARK_HALF_BAND_DECIMATOR_H
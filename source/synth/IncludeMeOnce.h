@@ -25,9 +25,6 @@
 #include "PitchToFrequency.h"
 
 //synth statics
-int32_t UnitGenerator::mSampleRate = kSynthmarkSampleRate;
-synth_float_t UnitGenerator::mSamplePeriod = 1.0f / kSynthmarkSampleRate;
-
 PowerOfTwoTable PitchToFrequency::mPowerTable(64);
 
 #endif //INCLUDE_ME_ONCE_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_MULTICHANNEL_PANNER_H
+#define SYNTHMARK_MULTICHANNEL_PANNER_H
+
+#include <cstdint>
+#include <math.h>
+#include "SynthMark.h"
+
+/**
+ * Calculate the gain of each output channel for a voice.
+ *
+ * If the channel count is 4, 9 or 16 then the output is treated as
+ * 1st, 2nd or 3rd order ambisonics using ACN channel order and SN3D
+ * normalization, also known as AmbiX. Otherwise the channels are
+ * speakers spaced evenly around a ring and the voice is panned between
+ * the nearest pair using constant power.
+ */
+class MultichannelPanner
+{
+public:
+    /**
+     * @return ambisonic order for the channel count or -1 if it is not ambisonic
+     */
+    static int32_t getAmbisonicOrder(int32_t channelCount) {
+        switch (channelCount) {
+            case 4:  return 1;
+            case 9:  return 2;
+            case 16: return 3;
+            default: return -1;
+        }
+    }
+
+    /**
+     * Spread the voices around the listener and calculate their gains.
+     * @param gains array of channelCount values
+     */
+    static void calculateGains(int32_t voiceIndex, int32_t numVoices,
+                               synth_float_t amplitude,
+                               int32_t channelCount, float *gains) {
+        // Spread voices evenly in azimuth and alternate the elevation a little.
+        double azimuth = (2.0 * M_PI * voiceIndex) / ((numVoices > 0) ? numVoices : 1);
+        double elevation = ((voiceIndex % 3) - 1) * (M_PI / 8.0);
+        if (getAmbisonicOrder(channelCount) > 0) {
+            encodeAmbisonic(azimuth, elevation, channelCount, gains);
+        } else {
+            panRing(azimuth, channelCount, gains);
+        }
+        for (int i = 0; i < channelCount; i++) {
+            gains[i] *= amplitude;
+        }
+    }
+
+    /**
+     * Real spherical harmonics up to 3rd order, ACN order, SN3D normalization.
+     */
+    static void encodeAmbisonic(double azimuth, double elevation,
+                                int32_t channelCount, float *gains) {
+        const double x = cos(elevation) * cos(azimuth);
+        const double y = cos(elevation) * sin(azimuth);
+        const double z = sin(elevation);
+        const double x2 = x * x;
+        const double y2 = y * y;
+        const double z2 = z * z;
+        double harmonics[16];
+        // 0th order
+        harmonics[0] = 1.0;
+        // 1st order
+        harmonics[1] = y;
+        harmonics[2] = z;
+        harmonics[3] = x;
+        // 2nd order
+        harmonics[4] = sqrt(3.0) * x * y;
+        harmonics[5] = sqrt(3.0) * y * z;
+        harmonics[6] = 0.5 * ((3.0 * z2) - 1.0);
+        harmonics[7] = sqrt(3.0) * x * z;
+        harmonics[8] = 0.5 * sqrt(3.0) * (x2 - y2);
+        // 3rd order
+        harmonics[9] = sqrt(5.0 / 8.0) * y * ((3.0 * x2) - y2);
+        harmonics[10] = sqrt(15.0) * x * y * z;
+        harmonics[11] = sqrt(3.0 / 8.0) * y * ((5.0 * z2) - 1.0);
+        harmonics[12] = 0.5 * z * ((5.0 * z2) - 3.0);
+        harmonics[13] = sqrt(3.0 / 8.0) * x * ((5.0 * z2) - 1.0);
+        harmonics[14] = 0.5 * sqrt(15.0) * z * (x2 - y2);
+        harmonics[15] = sqrt(5.0 / 8.0) * x * (x2 - (3.0 * y2));
+        for (int i = 0; i < channelCount; i++) {
+            gains[i] = (float) harmonics[i];
+        }
+    }
+
+    /**
+     * Constant power panning between the two nearest speakers of a ring.
+     */
+    static void panRing(double azimuth, int32_t channelCount, float *gains) {
+        for (int i = 0; i < channelCount; i++) {
+            gains[i] = 0.0f;
+        }
+        if (channelCount == 1) {
+            gains[0] = 1.0f;
+            return;
+        }
+        double position = azimuth * channelCount / (2.0 * M_PI);
+        int32_t speaker = ((int32_t) floor(position)) % channelCount;
+        double fraction = position - floor(position);
+        gains[speaker] = (float) cos(fraction * M_PI_2);
+        gains[(speaker + 1) % channelCount] = (float) sin(fraction * M_PI_2);
+    }
+};
+
+#endif // SYNTHMARK_MULTICHANNEL_PANNER_H
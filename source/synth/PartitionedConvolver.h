@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_PARTITIONED_CONVOLVER_H
+#define SYNTHMARK_PARTITIONED_CONVOLVER_H
+
+#include <cassert>
+#include <cstdint>
+#include <string.h>
+#include <vector>
+#include "SynthMark.h"
+#include "FastFourierTransform.h"
+
+/**
+ * Uniformly partitioned overlap-save convolution.
+ *
+ * The impulse response is split into partitions of blockSize frames.
+ * Each input block is transformed once and kept in a frequency domain
+ * delay line. The output is the sum of each delayed input spectrum
+ * multiplied by the spectrum of the matching partition.
+ */
+class PartitionedConvolver
+{
+public:
+    PartitionedConvolver() {}
+
+    virtual ~PartitionedConvolver() {
+        delete mFft;
+    }
+
+    /**
+     * Transform the impulse response. Do not call this from the audio callback.
+     * @param blockSize power of two, frames passed to process()
+     */
+    void setup(const float *impulse, int32_t numImpulse, int32_t blockSize) {
+        assert(blockSize >= 2 && (blockSize & (blockSize - 1)) == 0);
+        mBlockSize = blockSize;
+        delete mFft;
+        mFft = new RealFastFourierTransform(2 * blockSize);
+        mNumBins = mFft->getNumBins();
+        mNumPartitions = (numImpulse + blockSize - 1) / blockSize;
+        if (mNumPartitions < 1) {
+            mNumPartitions = 1;
+        }
+
+        int32_t spectrumSize = mNumPartitions * mNumBins;
+        mFilterReal.assign(spectrumSize, 0.0f);
+        mFilterImag.assign(spectrumSize, 0.0f);
+        mDelayReal.assign(spectrumSize, 0.0f);
+        mDelayImag.assign(spectrumSize, 0.0f);
+        mSumReal.assign(mNumBins, 0.0f);
+        mSumImag.assign(mNumBins, 0.0f);
+        mTimeBuffer.assign(2 * blockSize, 0.0f);
+        mTransformBuffer.assign(2 * blockSize, 0.0f);
+        mDelayIndex = 0;
+
+        // Zero pad each partition to twice the block size.
+        for (int partition = 0; partition < mNumPartitions; partition++) {
+            int32_t offset = partition * blockSize;
+            int32_t count = numImpulse - offset;
+            if (count > blockSize) {
+                count = blockSize;
+            }
+            memset(mTransformBuffer.data(), 0, 2 * blockSize * sizeof(float));
+            if (count > 0) {
+                memcpy(mTransformBuffer.data(), &impulse[offset], count * sizeof(float));
+            }
+            mFft->forward(mTransformBuffer.data(),
+                          &mFilterReal[partition * mNumBins],
+                          &mFilterImag[partition * mNumBins]);
+        }
+    }
+
+    int32_t getBlockSize() const {
+        return mBlockSize;
+    }
+
+    int32_t getNumPartitions() const {
+        return mNumPartitions;
+    }
+
+    /**
+     * Convolve one block.
+     * @param input blockSize frames
+     * @param output blockSize frames, may be the same as input
+     */
+    void process(const float *input, float *output) {
+        const int32_t blockSize = mBlockSize;
+        const int32_t numBins = mNumBins;
+
+        // Slide the input so the buffer holds the previous and the current block.
+        memcpy(mTimeBuffer.data(), &mTimeBuffer[blockSize], blockSize * sizeof(float));
+        memcpy(&mTimeBuffer[blockSize], input, blockSize * sizeof(float));
+
+        // Newest spectrum goes into the frequency domain delay line.
+        mDelayIndex = (mDelayIndex == 0) ? (mNumPartitions - 1) : (mDelayIndex - 1);
+        mFft->forward(mTimeBuffer.data(),
+                      &mDelayReal[mDelayIndex * numBins],
+                      &mDelayImag[mDelayIndex * numBins]);
+
+        // Complex multiply and accumulate.
+        float *sumReal = mSumReal.data();
+        float *sumImag = mSumImag.data();
+        memset(sumReal, 0, numBins * sizeof(float));
+        memset(sumImag, 0, numBins * sizeof(float));
+        int32_t delayIndex = mDelayIndex;
+        for (int partition = 0; partition < mNumPartitions; partition++) {
+            const float *xr = &mDelayReal[delayIndex * numBins];
+            const float *xi = &mDelayImag[delayIndex * numBins];
+            const float *hr = &mFilterReal[partition * numBins];
+            const float *hi = &mFilterImag[partition * numBins];
+            for (int k = 0; k < numBins; k++) {
+                sumReal[k] += (xr[k] * hr[k]) - (xi[k] * hi[k]);
+                sumImag[k] += (xr[k] * hi[k]) + (xi[k] * hr[k]);
+            }
+            delayIndex++;
+            if (delayIndex == mNumPartitions) {
+                delayIndex = 0;
+            }
+        }
+
+        // The second half is the valid part of the circular convolution.
+        mFft->inverse(sumReal, sumImag, mTransformBuffer.data());
+        memcpy(output, &mTransformBuffer[blockSize], blockSize * sizeof(float));
+    }
+
+private:
+    RealFastFourierTransform *mFft = NULL;
+    int32_t mBlockSize = 0;
+    int32_t mNumBins = 0;
+    int32_t mNumPartitions = 0;
+    int32_t mDelayIndex = 0;
+
+    std::vector<float> mFilterReal;    // spectrum of each partition of the impulse response
+    std::vector<float> mFilterImag;
+    std::vector<float> mDelayReal;     // frequency domain delay line of input spectra
+    std::vector<float> mDelayImag;
+    std::vector<float> mSumReal;
+    std::vector<float> mSumImag;
+    std::vector<float> mTimeBuffer;
+    std::vector<float> mTransformBuffer;
+};
+
+#endif // SYNTHMARK_PARTITIONED_CONVOLVER_H
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_RENDER_FIFO_H
+#define SYNTHMARK_RENDER_FIFO_H
+
+#include <cstdint>
+#include <string.h>
+
+#include "SynthMark.h"
+
+/**
+ * Serve any number of frames from a renderer that only works in whole
+ * blocks of kSynthmarkFramesPerRender.
+ *
+ * Whole blocks are rendered directly into the caller's buffer.
+ * When a request ends part way through a block, the whole block is rendered
+ * into a small FIFO and the leftover frames are used by the next request.
+ */
+class RenderFifo
+{
+public:
+    void reset() {
+        mFramesLeft = 0;
+        mPartialBlockCount = 0;
+    }
+
+    /**
+     * @param renderBlocks called as renderBlocks(buffer, numFrames) with a multiple
+     *                     of kSynthmarkFramesPerRender
+     * @return numFrames
+     */
+    template <typename BlockRenderer>
+    int32_t render(float *output, int32_t numFrames, int32_t channelCount,
+                   BlockRenderer renderBlocks) {
+        int32_t framesRequested = numFrames;
+        // Use frames left over from the previous call.
+        int32_t framesToCopy = (mFramesLeft < numFrames) ? mFramesLeft : numFrames;
+        if (framesToCopy > 0) {
+            int32_t offset = (kSynthmarkFramesPerRender - mFramesLeft) * channelCount;
+            memcpy(output, &mBuffer[offset], framesToCopy * channelCount * sizeof(float));
+            mFramesLeft -= framesToCopy;
+            output += framesToCopy * channelCount;
+            numFrames -= framesToCopy;
+        }
+
+        int32_t wholeFrames = numFrames - (numFrames % kSynthmarkFramesPerRender);
+        if (wholeFrames > 0) {
+            renderBlocks(output, wholeFrames);
+            output += wholeFrames * channelCount;
+            numFrames -= wholeFrames;
+        }
+
+        // Split a block and save the rest for later.
+        if (numFrames > 0) {
+            renderBlocks(mBuffer, kSynthmarkFramesPerRender);
+            memcpy(output, mBuffer, numFrames * channelCount * sizeof(float));
+            mFramesLeft = kSynthmarkFramesPerRender - numFrames;
+            mPartialBlockCount++;
+        }
+        return framesRequested;
+    }
+
+    /**
+     * @return frames already rendered that can be read without rendering, up to maxFrames
+     */
+    int32_t getFramesLeft(int32_t maxFrames) const {
+        return (mFramesLeft < maxFrames) ? mFramesLeft : maxFrames;
+    }
+
+    /**
+     * @return number of blocks that were split between two requests
+     */
+    int64_t getPartialBlockCount() const {
+        return mPartialBlockCount;
+    }
+
+private:
+    float   mBuffer[kSynthmarkFramesPerRender * kSynthmarkMaxChannels];
+    int32_t mFramesLeft = 0;
+    int64_t mPartialBlockCount = 0;
+};
+
+#endif // SYNTHMARK_RENDER_FIFO_H
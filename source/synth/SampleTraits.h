@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_SAMPLE_TRAITS_H
+#define SYNTHMARK_SAMPLE_TRAITS_H
+
+#include <cstdint>
+#include "SynthMark.h"
+#include "FixedPoint.h"
+
+/**
+ * Numeric type used for the audio rate signals in the synthesizer.
+ * Control signals such as pitch and frequency always use synth_float_t.
+ */
+enum class SampleType {
+    Float,
+    Double,
+    Q31,
+    Q15,
+};
+
+constexpr int kNumSampleTypes = 4;
+
+inline const char *sampleTypeToString(SampleType sampleType) {
+    switch (sampleType) {
+        case SampleType::Float:  return "float";
+        case SampleType::Double: return "double";
+        case SampleType::Q31:    return "q31";
+        case SampleType::Q15:    return "q15";
+    }
+    return "unknown";
+}
+
+/**
+ * Describe how a floating point sample type is used by the templated unit generators.
+ */
+template <typename T>
+struct FloatingPointSampleTraits {
+    typedef T sample_type;
+    // Type for filter coefficients that may exceed 1.0.
+    typedef T coefficient_type;
+    // Type for the recursive state of a filter.
+    typedef T state_type;
+
+    /**
+     * Advance a phase between -1.0 and +1.0 and wrap it around.
+     */
+    static T advancePhase(T phase, T phaseIncrement) {
+        phase += phaseIncrement;
+        if (phase > 1.0) {
+            phase -= 2.0;
+        }
+        return phase;
+    }
+
+    /**
+     * @return phase shifted by 180 degrees
+     */
+    static T invertPhase(T phase) {
+        T phase2 = phase + 1.0;
+        if (phase2 >= 1.0) {
+            phase2 -= 2.0;
+        }
+        return phase2;
+    }
+
+    static float toFloat(T sample) {
+        return (float) sample;
+    }
+};
+
+template <typename T>
+struct SampleTraits : public FloatingPointSampleTraits<T> {};
+
+template <>
+struct SampleTraits<float> : public FloatingPointSampleTraits<float> {
+    // Use double precision for the recursive portion of the filter.
+    typedef double state_type;
+};
+
+/**
+ * Fixed-point phases wrap around naturally using integer overflow.
+ */
+template <typename IntType, typename WideType, int kFractionBits, int kCoefficientBits>
+struct FixedPointSampleTraits {
+    typedef FixedPoint<IntType, WideType, kFractionBits> sample_type;
+    typedef FixedPoint<IntType, WideType, kCoefficientBits> coefficient_type;
+    typedef sample_type state_type;
+
+    static sample_type advancePhase(sample_type phase, sample_type phaseIncrement) {
+        return phase.wrappingAdd(phaseIncrement);
+    }
+
+    static sample_type invertPhase(sample_type phase) {
+        return phase.wrappingAdd(sample_type::fromRaw(sample_type::kMin));
+    }
+
+    static float toFloat(sample_type sample) {
+        return (float) sample;
+    }
+};
+
+template <>
+struct SampleTraits<synth_q31_t> : public FixedPointSampleTraits<int32_t, int64_t, 31, 29> {};
+
+template <>
+struct SampleTraits<synth_q15_t> : public FixedPointSampleTraits<int16_t, int32_t, 15, 13> {};
+
+#endif // SYNTHMARK_SAMPLE_TRAITS_H
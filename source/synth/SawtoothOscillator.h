@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <math.h>
 #include "SynthMark.h"
+#include "SampleTraits.h"
 #include "UnitGenerator.h"
 #include "DifferentiatedParabola.h"
 
@@ -32,7 +33,8 @@
  * Note that this is NON-bandlimited and should not be used
  * directly as a sound source.
  */
-class SawtoothOscillator : public UnitGenerator
+template <typename T = synth_float_t>
+class SawtoothOscillator : public UnitGenerator<T>
 {
 public:
     SawtoothOscillator()
@@ -41,38 +43,32 @@ public:
     virtual ~SawtoothOscillator() = default;
 
     void generate(synth_float_t frequency, int32_t numSamples) {
-        synth_float_t phase = mPhase;
-        synth_float_t phaseIncrement = 2.0 * frequency * mSamplePeriod;
+        T phase = mPhase;
+        T phaseIncrement = 2.0 * frequency * this->mSamplePeriod;
         for (int i = 0; i < numSamples; i++) {
-            output[i] = translatePhase(phase, phaseIncrement);
-            phase += phaseIncrement;
-            if (phase > 1.0) {
-                phase -= 2.0;
-            }
+            this->output[i] = translatePhase(phase, phaseIncrement);
+            phase = SampleTraits<T>::advancePhase(phase, phaseIncrement);
         }
         mPhase = phase;
     }
 
     void generate(synth_float_t *frequencies, int32_t numSamples) {
-        synth_float_t phase = mPhase;
+        T phase = mPhase;
         for (int i = 0; i < numSamples; i++) {
-            synth_float_t phaseIncrement = 2.0 * frequencies[i] * mSamplePeriod;
-            output[i] = translatePhase(phase, phaseIncrement);
-            phase += phaseIncrement;
-            if (phase > 1.0) {
-                phase -= 2.0;
-            }
+            T phaseIncrement = 2.0 * frequencies[i] * this->mSamplePeriod;
+            this->output[i] = translatePhase(phase, phaseIncrement);
+            phase = SampleTraits<T>::advancePhase(phase, phaseIncrement);
         }
         mPhase = phase;
     }
 
-    virtual synth_float_t translatePhase(synth_float_t phase, synth_float_t phaseIncrement) {
+    virtual T translatePhase(T phase, T phaseIncrement) {
         (void) phaseIncrement;
         return phase;
     }
 
 private:
-    synth_float_t mPhase; // between -1.0 and +1.0
+    T mPhase; // between -1.0 and +1.0
 };
 
 #endif // SYNTHMARK_SAWTOOTH_OSCILLATOR_H
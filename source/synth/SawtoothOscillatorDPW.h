@@ -31,21 +31,22 @@
  * Suitable as a sound source.
  */
 
-class SawtoothOscillatorDPW : public SawtoothOscillator
+template <typename T = synth_float_t>
+class SawtoothOscillatorDPW : public SawtoothOscillator<T>
 {
 public:
     SawtoothOscillatorDPW()
-    : SawtoothOscillator()
+    : SawtoothOscillator<T>()
     , dpw() {}
 
     virtual ~SawtoothOscillatorDPW() = default;
 
-    virtual inline synth_float_t translatePhase(synth_float_t phase, synth_float_t phaseIncrement) {
+    virtual inline T translatePhase(T phase, T phaseIncrement) {
         return dpw.next(phase, phaseIncrement);
     }
 
 private:
-    DifferentiatedParabola dpw;
+    DifferentiatedParabola<T> dpw;
 };
 
 #endif // SYNTHMARK_SAWTOOTH_OSCILLATOR_DPW_H
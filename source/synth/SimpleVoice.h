@@ -32,12 +32,16 @@
 /**
  * Classic subtractive synthesizer voice with
  * 2 LFOs, 2 audio oscillators, filter and envelopes.
+ *
+ * The audio signal path uses T. The LFO, pitch and filter envelope
+ * are control signals and use synth_float_t.
  */
-class SimpleVoice : public VoiceBase
+template <typename T = synth_float_t>
+class SimpleVoice : public VoiceBase<T>
 {
 public:
     SimpleVoice()
-    : VoiceBase()
+    : VoiceBase<T>()
     , mLfo1()
     , mOsc1()
     , mOsc2()
@@ -53,22 +57,37 @@ public:
     , mFilterCutoff(400.0f)
     {
         mFilter.setQ(2.0);
-        // Randomize attack times to smooth out CPU load for envelope state transitions.
-        mFilterEnvelope.setAttackTime(0.05 + (0.2 * SynthTools::nextRandomDouble()));
-        mFilterEnvelope.setDecayTime(7.0 + (1.0 * SynthTools::nextRandomDouble()));
-        mAmplitudeEnvelope.setAttackTime(0.02 + (0.05 * SynthTools::nextRandomDouble()));
-        mAmplitudeEnvelope.setDecayTime(1.0 + (0.2 * SynthTools::nextRandomDouble()));
     }
 
     virtual ~SimpleVoice() = default;
 
+    void setSampleRate(int32_t sampleRate) override {
+        UnitGenerator<T>::setSampleRate(sampleRate);
+        mLfo1.setSampleRate(sampleRate);
+        mOsc1.setSampleRate(sampleRate);
+        mOsc2.setSampleRate(sampleRate);
+        mFilter.setSampleRate(sampleRate);
+        mFilterEnvelope.setSampleRate(sampleRate);
+        mAmplitudeEnvelope.setSampleRate(sampleRate);
+    }
+
+    /**
+     * Randomize attack times to smooth out CPU load for envelope state transitions.
+     */
+    void randomizeEnvelopes(PseudoRandom &random) {
+        mFilterEnvelope.setAttackTime(0.05 + (0.2 * random.nextRandomDouble()));
+        mFilterEnvelope.setDecayTime(7.0 + (1.0 * random.nextRandomDouble()));
+        mAmplitudeEnvelope.setAttackTime(0.02 + (0.05 * random.nextRandomDouble()));
+        mAmplitudeEnvelope.setDecayTime(1.0 + (0.2 * random.nextRandomDouble()));
+    }
+
     void setPitch(synth_float_t pitch) {
-        mPitch = pitch;
+        this->mPitch = pitch;
     }
 
     void noteOn(synth_float_t pitch, synth_float_t velocity) {
         (void) velocity; // TODO use velocity?
-        mPitch = pitch;
+        this->mPitch = pitch;
         mFilterEnvelope.setGate(true);
         mAmplitudeEnvelope.setGate(true);
     }
@@ -78,13 +97,21 @@ public:
         mAmplitudeEnvelope.setGate(false);
     }
 
-    void generate(int32_t numFrames) {
+    /**
+     * @return true if the amplitude envelope has finished
+     */
+    bool isIdle() {
+        return mAmplitudeEnvelope.isIdle();
+    }
+
+    void generate(int32_t numFrames) override {
         assert(numFrames <= kSynthmarkFramesPerRender);
 
         // LFO #1 - vibrato
         mLfo1.generate(mVibratoRate, numFrames);
         synth_float_t *pitches = mBuffer1;
-        SynthTools::scaleOffsetBuffer(mLfo1.output, pitches, numFrames, mVibratoDepth, mPitch);
+        SynthTools::scaleOffsetBuffer(mLfo1.output, pitches, numFrames, mVibratoDepth,
+                                      this->mPitch);
         synth_float_t *frequencies = mBuffer2;
         mPitchToFrequency.generate(pitches, frequencies, numFrames);
 
@@ -96,8 +123,8 @@ public:
         mOsc2.generate(frequencies, numFrames);
 
         // Mix the two oscillators
-        synth_float_t *mixed = frequencies;
-        SynthTools::mixBuffers(mOsc1.output, 0.6, mOsc2.output, 0.4, mixed, numFrames);
+        T *mixed = mBuffer3;
+        SynthTools::mixBuffers<T>(mOsc1.output, 0.6, mOsc2.output, 0.4, mixed, numFrames);
 
         // Filter envelope
         mFilterEnvelope.generate(numFrames);
@@ -110,17 +137,18 @@ public:
 
         // Amplitude ADSR
         mAmplitudeEnvelope.generate(numFrames);
-        SynthTools::multiplyBuffers(mFilter.output, mAmplitudeEnvelope.output, output, numFrames);
+        SynthTools::multiplyBuffers<T>(mFilter.output, mAmplitudeEnvelope.output,
+                                       this->output, numFrames);
     }
 
 private:
-    SineOscillator mLfo1;
-    SawtoothOscillatorDPW mOsc1;
-    SquareOscillatorDPW mOsc2;
+    SineOscillator<synth_float_t> mLfo1;
+    SawtoothOscillatorDPW<T> mOsc1;
+    SquareOscillatorDPW<T> mOsc2;
     PitchToFrequency mPitchToFrequency;
-    BiquadFilter mFilter;
-    EnvelopeADSR mFilterEnvelope;
-    EnvelopeADSR mAmplitudeEnvelope;
+    BiquadFilter<T> mFilter;
+    EnvelopeADSR<synth_float_t> mFilterEnvelope;
+    EnvelopeADSR<T> mAmplitudeEnvelope;
 
     synth_float_t mDetune;          // frequency scaler
     synth_float_t mVibratoDepth;    // in semitones
@@ -131,6 +159,7 @@ private:
     // Buffers for storing signals that are being passed between units.
     synth_float_t mBuffer1[kSynthmarkFramesPerRender];
     synth_float_t mBuffer2[kSynthmarkFramesPerRender];
+    T             mBuffer3[kSynthmarkFramesPerRender];
 };
 
 #endif // SYNTHMARK_SIMPLE_VOICE_H
@@ -26,17 +26,18 @@
 #include "SynthMark.h"
 #include "tools/SynthTools.h"
 
-class SineOscillator  : public SawtoothOscillator
+template <typename T = synth_float_t>
+class SineOscillator  : public SawtoothOscillator<T>
 {
 public:
     SineOscillator()
-    : SawtoothOscillator() {}
+    : SawtoothOscillator<T>() {}
 
     virtual ~SineOscillator() = default;
 
-    virtual inline synth_float_t translatePhase(synth_float_t phase, synth_float_t phaseIncrement) {
+    virtual inline T translatePhase(T phase, T phaseIncrement) {
         (void) phaseIncrement;
-        return SynthTools::fastSine(phase * M_PI);
+        return SynthTools::fastSine((synth_float_t) phase * M_PI);
     }
 
 };
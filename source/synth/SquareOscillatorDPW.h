@@ -32,41 +32,40 @@
  * that are 180 degrees out of phase. This causes the even partials
  * to be cancelled out.
  */
-class SquareOscillatorDPW : public SawtoothOscillator
+template <typename T = synth_float_t>
+class SquareOscillatorDPW : public SawtoothOscillator<T>
 {
 public:
     SquareOscillatorDPW()
-    : SawtoothOscillator()
+    : SawtoothOscillator<T>()
     , dpw1()
     , dpw2() {}
 
     virtual ~SquareOscillatorDPW() = default;
 
-    virtual inline synth_float_t translatePhase(synth_float_t phase1,
-            synth_float_t phaseIncrement) {
-        synth_float_t val1 = dpw1.next(phase1, phaseIncrement);
+    virtual inline T translatePhase(T phase1,
+            T phaseIncrement) {
+        T val1 = dpw1.next(phase1, phaseIncrement);
 
         /* Generate second sawtooth so we can add them together. */
-        synth_float_t phase2 = phase1 + 1.0; /* 180 degrees out of phase. */
-        if (phase2 >= 1.0)
-            phase2 -= 2.0;
-        synth_float_t val2 = dpw1.next(phase2, phaseIncrement);
+        T phase2 = SampleTraits<T>::invertPhase(phase1); /* 180 degrees out of phase. */
+        T val2 = dpw1.next(phase2, phaseIncrement);
 
         /*
          * Need to adjust amplitude based on positive phaseInc. little less than half at
          * Nyquist/2.0!
          */
-        const synth_float_t STARTAMP = 0.92; // derived empirically
-        synth_float_t positivePhaseIncrement = (phaseIncrement < 0.0)
+        const T STARTAMP = 0.92; // derived empirically
+        T positivePhaseIncrement = (phaseIncrement < 0.0)
                 ? phaseIncrement
                 : 0.0 - phaseIncrement;
-        synth_float_t scale = STARTAMP - positivePhaseIncrement;
+        T scale = STARTAMP - positivePhaseIncrement;
         return scale * (val1 - val2);
     }
 
 private:
-    DifferentiatedParabola dpw1;
-    DifferentiatedParabola dpw2;
+    DifferentiatedParabola<T> dpw1;
+    DifferentiatedParabola<T> dpw2;
 };
 
 #endif // SYNTHMARK_SQUARE_OSCILLATOR_DPW_H
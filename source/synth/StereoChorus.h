@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_STEREO_CHORUS_H
+#define SYNTHMARK_STEREO_CHORUS_H
+
+#include <cstdint>
+#include <math.h>
+#include "SynthMark.h"
+#include "DelayLine.h"
+#include "tools/SynthTools.h"
+
+/**
+ * Chorus with a sine modulated delay for each channel.
+ * The right channel LFO is 90 degrees behind the left to widen the image.
+ */
+class StereoChorus
+{
+public:
+    StereoChorus()
+    : mDelayTime(0.015f)
+    , mDepth(0.005f)
+    , mRate(0.8f)
+    , mMix(0.5f)
+    {}
+
+    virtual ~StereoChorus() = default;
+
+    void setup(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        int32_t maxDelay = (int32_t) ((mDelayTime + mDepth) * sampleRate) + 1;
+        mLeft.allocate(maxDelay);
+        mRight.allocate(maxDelay);
+        mPhase = 0.0f;
+    }
+
+    /**
+     * Process interleaved stereo in place.
+     */
+    void process(float *buffer, int32_t numFrames) {
+        const float dryGain = 1.0f - (0.5f * mMix);
+        const float wetGain = 0.5f * mMix;
+        const float centerFrames = mDelayTime * mSampleRate;
+        const float depthFrames = mDepth * mSampleRate;
+        const float phaseIncrement = 2.0f * mRate / mSampleRate;
+        float phase = mPhase;
+        for (int frame = 0; frame < numFrames; frame++) {
+            float left = buffer[0];
+            float right = buffer[1];
+            mLeft.write(left);
+            mRight.write(right);
+
+            float phase2 = phase - 0.5f;
+            if (phase2 < -1.0f) {
+                phase2 += 2.0f;
+            }
+            float delayLeft = centerFrames
+                    + (depthFrames * SynthTools::fastSine(phase * (float) M_PI));
+            float delayRight = centerFrames
+                    + (depthFrames * SynthTools::fastSine(phase2 * (float) M_PI));
+
+            *buffer++ = (left * dryGain) + (mLeft.readInterpolated(delayLeft) * wetGain);
+            *buffer++ = (right * dryGain) + (mRight.readInterpolated(delayRight) * wetGain);
+
+            phase += phaseIncrement;
+            if (phase > 1.0f) {
+                phase -= 2.0f;
+            }
+        }
+        mPhase = phase;
+    }
+
+private:
+    DelayLine mLeft;
+    DelayLine mRight;
+    int32_t   mSampleRate = kSynthmarkSampleRate;
+    float     mPhase = 0.0f;    // between -1.0 and +1.0
+
+    float     mDelayTime;       // center of the modulation in seconds
+    float     mDepth;           // in seconds
+    float     mRate;            // in Hertz
+    float     mMix;
+};
+
+#endif // SYNTHMARK_STEREO_CHORUS_H
@@ -17,17 +17,140 @@
 #ifndef SYNTHMARK_SYNTHESIZER_H
 #define SYNTHMARK_SYNTHESIZER_H
 
+#include <algorithm>
 #include <cstdint>
 #include <math.h>
 #include <memory>
 #include <string.h>
+#include <vector>
 #include <cassert>
 #include "SynthMark.h"
 #include "VoiceBase.h"
 #include "SimpleVoice.h"
+#include "SampleTraits.h"
+#include "HalfBandDecimator.h"
+#include "MultichannelPanner.h"
+#include "RenderFifo.h"
+#include "tools/NoteEventQueue.h"
 
 #define SAMPLES_PER_FRAME   2
 
+// Voices started after notesOn(). A big chord is spread over several bursts,
+// and over the blocks of each burst, so that no single burst pays for all of it.
+constexpr int32_t kSynthmarkNoteOnsPerBurst = 16;
+constexpr int32_t kSynthmarkNoteOnsPerBlock = 4;
+
+// Voice that is not holding a note.
+constexpr int32_t kSynthmarkNoNote = -1;
+
+/**
+ * Interface to an array of voices that hides the sample type used to render them.
+ */
+class VoiceBankBase
+{
+public:
+    virtual ~VoiceBankBase() = default;
+
+    virtual void noteOn(int32_t voiceIndex, synth_float_t pitch, synth_float_t velocity) = 0;
+
+    virtual void noteOff(int32_t voiceIndex) = 0;
+
+    /**
+     * @return true if the voice is silent after its release
+     */
+    virtual bool isIdle(int32_t voiceIndex) = 0;
+
+    /**
+     * Generate one block from each active voice and mix it into an interleaved float buffer.
+     * @param numFrames block size, up to kSynthmarkFramesPerRender
+     * @param voiceGains channelCount gains for each voice, not used for stereo
+     */
+    virtual void renderBlock(float *output, int32_t numFrames, int32_t activeVoiceCount,
+                             synth_float_t voiceAmplitude,
+                             int32_t channelCount, const float *voiceGains) = 0;
+};
+
+/**
+ * Array of voices that render audio using type T.
+ */
+template <typename T>
+class VoiceBank : public VoiceBankBase
+{
+public:
+    VoiceBank(int32_t maxVoices, int32_t sampleRate, PseudoRandom &random)
+    : mVoices(new SimpleVoice<T>[maxVoices])
+    {
+        for (int iv = 0; iv < maxVoices; iv++) {
+            mVoices[iv].setSampleRate(sampleRate);
+            mVoices[iv].randomizeEnvelopes(random);
+        }
+    }
+
+    virtual ~VoiceBank() {
+        delete[] mVoices;
+    }
+
+    void noteOn(int32_t voiceIndex, synth_float_t pitch, synth_float_t velocity) override {
+        mVoices[voiceIndex].noteOn(pitch, velocity);
+    }
+
+    void noteOff(int32_t voiceIndex) override {
+        mVoices[voiceIndex].noteOff();
+    }
+
+    bool isIdle(int32_t voiceIndex) override {
+        return mVoices[voiceIndex].isIdle();
+    }
+
+    void renderBlock(float *output, int32_t numFrames, int32_t activeVoiceCount,
+                     synth_float_t voiceAmplitude,
+                     int32_t channelCount, const float *voiceGains) override {
+        if (channelCount != SAMPLES_PER_FRAME) {
+            renderMultichannelBlock(output, numFrames, activeVoiceCount, channelCount,
+                                    voiceGains);
+            return;
+        }
+        for(int iv = 0; iv < activeVoiceCount; iv++ ) {
+            SimpleVoice<T> *voice = &mVoices[iv];
+            voice->generate(numFrames);
+            float *mix = output;
+
+            synth_float_t leftGain = voiceAmplitude;
+            synth_float_t rightGain = voiceAmplitude;
+            if (activeVoiceCount > 1) {
+                synth_float_t pan = iv / (activeVoiceCount - 1.0f);
+                leftGain *= pan;
+                rightGain *= 1.0 - pan;
+            }
+            for(int n = 0; n < numFrames; n++ ) {
+                synth_float_t sample = SampleTraits<T>::toFloat(voice->output[n]);
+                *mix++ += (float) (sample * leftGain);
+                *mix++ += (float) (sample * rightGain);
+            }
+        }
+    }
+
+private:
+    void renderMultichannelBlock(float *output, int32_t numFrames, int32_t activeVoiceCount,
+                                 int32_t channelCount, const float *voiceGains) {
+        for(int iv = 0; iv < activeVoiceCount; iv++ ) {
+            SimpleVoice<T> *voice = &mVoices[iv];
+            voice->generate(numFrames);
+            const float *gains = &voiceGains[iv * channelCount];
+            float *mix = output;
+            for(int n = 0; n < numFrames; n++ ) {
+                float sample = (float) SampleTraits<T>::toFloat(voice->output[n]);
+                for (int ch = 0; ch < channelCount; ch++) {
+                    mix[ch] += sample * gains[ch];
+                }
+                mix += channelCount;
+            }
+        }
+    }
+
+    SimpleVoice<T> *mVoices;
+};
+
 /**
  * Manage an array of voices.
  * Note that this is not a fully featured general purpose synthesizer.
@@ -43,13 +166,48 @@ public:
     {}
 
     virtual ~Synthesizer() {
-        delete[] mVoices;
+        delete mVoices;
     };
 
-    int32_t setup(int32_t sampleRate, int32_t maxVoices) {
+    /**
+     * @param oversampling render the voices at this multiple of the sample rate
+     *                     and then decimate, 1, 2, 4 or 8
+     * @param channelCount number of interleaved output channels, 1 to kSynthmarkMaxChannels
+     */
+    int32_t setup(int32_t sampleRate, int32_t maxVoices,
+                  SampleType sampleType = SampleType::Float,
+                  int32_t oversampling = 1,
+                  int32_t channelCount = SAMPLES_PER_FRAME) {
+        if (channelCount < 1 || channelCount > kSynthmarkMaxChannels) {
+            printf("setup() channelCount of %d not supported\n", channelCount);
+            return -1;
+        }
+        for (int ch = 0; ch < channelCount; ch++) {
+            if (mDecimators[ch].setFactor(oversampling) < 0) {
+                printf("setup() oversampling of %d not supported\n", oversampling);
+                return -1;
+            }
+        }
+        mOversampling = oversampling;
+        mChannelCount = channelCount;
+        mVoiceGains.assign(maxVoices * channelCount, 0.0f);
         mMaxVoices = maxVoices;
-        UnitGenerator::setSampleRate(sampleRate);
-        mVoices = new SimpleVoice[mMaxVoices];
+        mNotePitches.resize(maxVoices);
+        synth_float_t pitches[] = {60.0, 64.0, 67.0, 69.0};
+        for (int iv = 0; iv < maxVoices; iv++) {
+            // Randomize pitches by a few cents to smooth out the CPU load.
+            float pitchOffset = 0.03f * (float) mRandom.nextRandomDouble();
+            mNotePitches[iv] = pitches[iv % 4] + pitchOffset;
+        }
+        mNextVoiceToStart = 0;
+        mVoicesToStart = 0;
+        mShortBlockCount = 0;
+        mPolyphony = 0;
+        mVoiceNotes.assign(maxVoices, kSynthmarkNoNote);
+        mVoiceStartOrder.assign(maxVoices, 0);
+        mFifo.reset();
+        delete mVoices;
+        mVoices = createVoiceBank(sampleType, mMaxVoices, sampleRate * oversampling, mRandom);
         return (mVoices == NULL) ? -1 : 0;
     }
 
@@ -65,70 +223,364 @@ public:
         mActiveVoiceCount = numVoices;
         // Leave some headroom so the resonant filter does not clip.
         mVoiceAmplitude = 0.5f / mActiveVoiceCount;
+        // The voices are started a few at a time before each block, and only
+        // kSynthmarkNoteOnsPerBurst in each render call, so that a big chord
+        // does not cause one expensive burst.
+        mNextVoiceToStart = 0;
+        mVoicesToStart = numVoices;
+        return 0;
+    }
 
-        int pitchIndex = 0;
-        synth_float_t pitches[] = {60.0, 64.0, 67.0, 69.0};
-        for(int iv = 0; iv < mActiveVoiceCount; iv++ ) {
-            SimpleVoice *voice = &mVoices[iv];
-            // Randomize pitches by a few cents to smooth out the CPU load.
-            float pitchOffset = 0.03f * (float) SynthTools::nextRandomDouble();
-            synth_float_t pitch = pitches[pitchIndex++] + pitchOffset;
-            if (pitchIndex > 3) pitchIndex = 0;
-            voice->noteOn(pitch, 1.0);
+    /**
+     * Retrigger one of the active voices, for example from a MIDI event.
+     * @return -1 if the voice is not active
+     */
+    int32_t noteOn(int32_t voiceIndex, synth_float_t pitch, synth_float_t velocity) {
+        if (voiceIndex < 0 || voiceIndex >= mActiveVoiceCount) {
+            return -1;
         }
+        mVoices->noteOn(voiceIndex, pitch, velocity);
+        return 0;
+    }
+
+    /**
+     * Release one of the active voices.
+     * @return -1 if the voice is not active
+     */
+    int32_t noteOff(int32_t voiceIndex) {
+        if (voiceIndex < 0 || voiceIndex >= mActiveVoiceCount) {
+            return -1;
+        }
+        mVoices->noteOff(voiceIndex);
         return 0;
     }
 
     void allNotesOff() {
+        mVoicesToStart = 0;
         for(int iv = 0; iv < mActiveVoiceCount; iv++ ) {
-            SimpleVoice *voice = &mVoices[iv];
-            voice->noteOff();
+            mVoices->noteOff(iv);
         }
     }
 
-    void renderStereo(float *output, int32_t numFrames) {
-        int32_t framesLeft = numFrames;
-        float *renderBuffer = output;
+    /**
+     * Render interleaved audio with the channel count passed to setup().
+     * Any number of frames may be requested.
+     */
+    void render(float *output, int32_t numFrames) {
+        mNoteOnsLeftInBurst = kSynthmarkNoteOnsPerBurst;
+        mFifo.render(output, numFrames, mChannelCount,
+                     [this](float *buffer, int32_t frames) {
+                         renderBlocks(buffer, frames);
+                     });
+    }
 
-        // Clear mixing buffer.
-        memset(output, 0, numFrames * SAMPLES_PER_FRAME * sizeof(float));
-
-        while (framesLeft >= kSynthmarkFramesPerRender) {
-            for(int iv = 0; iv < mActiveVoiceCount; iv++ ) {
-                SimpleVoice *voice = &mVoices[iv];
-                voice->generate(kSynthmarkFramesPerRender);
-                float *mix = renderBuffer;
-
-                synth_float_t leftGain = mVoiceAmplitude;
-                synth_float_t rightGain = mVoiceAmplitude;
-                if (mActiveVoiceCount > 1) {
-                    synth_float_t pan = iv / (mActiveVoiceCount - 1.0f);
-                    leftGain *= pan;
-                    rightGain *= 1.0 - pan;
-                }
-                for(int n = 0; n < kSynthmarkFramesPerRender; n++ ) {
-                    synth_float_t sample = voice->output[n];
-                    *mix++ += (float) (sample * leftGain);
-                    *mix++ += (float) (sample * rightGain);
+    /**
+     * Let the synthesizer choose voices for notes, like a keyboard instrument.
+     * Only the voices that are sounding are rendered, so the CPU load
+     * follows the polyphony of the music.
+     * Changing the limit while allocating keeps the notes that are sounding.
+     * @param polyphony maximum voices sounding, or 0 to use notesOn() instead
+     */
+    int32_t setPolyphony(int32_t polyphony) {
+        if (polyphony < 0 || polyphony > mMaxVoices) {
+            printf("setPolyphony(%d) exceeded maxVoices of %d\n", polyphony, mMaxVoices);
+            return -1;
+        }
+        if (polyphony == 0 || mPolyphony == 0) {
+            // Start or stop allocating.
+            allNotesOff();
+            mActiveVoiceCount = 0;
+            mPeakVoiceCount = 0;
+            mStealCount = 0;
+            mVoiceNotes.assign(mMaxVoices, kSynthmarkNoNote);
+        }
+        mPolyphony = polyphony;
+        if (polyphony > 0) {
+            // Fixed level so the loudness does not jump as voices come and go.
+            mVoiceAmplitude = 0.5f / polyphony;
+        }
+        return 0;
+    }
+
+    /**
+     * Start a note on a free voice. If all voices are busy then the oldest
+     * released voice is used, or else the oldest note is stolen.
+     */
+    int32_t allocateNoteOn(int32_t noteNumber, synth_float_t velocity) {
+        if (mPolyphony == 0) {
+            return -1;
+        }
+        int32_t freeVoice = -1;
+        int32_t releasedVoice = -1;
+        int32_t heldVoice = -1;
+        for (int iv = 0; iv < mPolyphony && freeVoice < 0; iv++) {
+            if (mVoiceNotes[iv] != kSynthmarkNoNote) {
+                if (heldVoice < 0 || mVoiceStartOrder[iv] < mVoiceStartOrder[heldVoice]) {
+                    heldVoice = iv;
                 }
+            } else if (iv >= mActiveVoiceCount || mVoices->isIdle(iv)) {
+                freeVoice = iv;
+            } else if (releasedVoice < 0
+                    || mVoiceStartOrder[iv] < mVoiceStartOrder[releasedVoice]) {
+                releasedVoice = iv;
+            }
+        }
+        int32_t voice = (freeVoice >= 0) ? freeVoice
+                : ((releasedVoice >= 0) ? releasedVoice : heldVoice);
+        if (voice == heldVoice) {
+            mStealCount++;
+        }
+        mVoiceNotes[voice] = noteNumber;
+        mVoiceStartOrder[voice] = ++mNoteOnCounter;
+        if (voice >= mActiveVoiceCount) {
+            mActiveVoiceCount = voice + 1;
+            mPeakVoiceCount = std::max(mPeakVoiceCount, mActiveVoiceCount);
+        }
+        if (mChannelCount != SAMPLES_PER_FRAME) {
+            MultichannelPanner::calculateGains(voice, mPolyphony, mVoiceAmplitude,
+                                               mChannelCount,
+                                               &mVoiceGains[voice * mChannelCount]);
+        }
+        mVoices->noteOn(voice, (synth_float_t) noteNumber, velocity);
+        return 0;
+    }
+
+    /**
+     * Release the voices playing this note.
+     * @return -1 if the note was not playing
+     */
+    int32_t allocateNoteOff(int32_t noteNumber) {
+        int32_t result = -1;
+        for (int iv = 0; iv < mActiveVoiceCount; iv++) {
+            if (mVoiceNotes[iv] == noteNumber) {
+                mVoices->noteOff(iv);
+                mVoiceNotes[iv] = kSynthmarkNoNote;
+                result = 0;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @return most voices sounding at once since setPolyphony()
+     */
+    int32_t getPeakVoiceCount() const {
+        return mPeakVoiceCount;
+    }
+
+    /**
+     * @return number of notes that took a voice from a note that was still held
+     */
+    int64_t getStealCount() const {
+        return mStealCount;
+    }
+
+    /**
+     * Render numFrames and apply each event at its frame offset, so that a note
+     * changes on the exact frame instead of at the next block boundary.
+     * A block that contains an event is split into two shorter blocks.
+     * Frames left over from a previous render() were already rendered, so an
+     * event that falls in them is applied after them.
+     *
+     * @param offsets frame offset of each event, in order, less than numFrames
+     * @return number of events applied, the others were for voices that are not active
+     */
+    int32_t renderWithEvents(float *output, int32_t numFrames,
+                             const NoteEvent *events, const int32_t *offsets,
+                             int32_t numEvents) {
+        int32_t applied = 0;
+        mNoteOnsLeftInBurst = kSynthmarkNoteOnsPerBurst;
+        int32_t frame = mFifo.render(output, mFifo.getFramesLeft(numFrames), mChannelCount,
+                                     [this](float *buffer, int32_t frames) {
+                                         renderBlocks(buffer, frames);
+                                     });
+        for (int32_t i = 0; i < numEvents; i++) {
+            if (offsets[i] > frame) {
+                renderBlocks(output + (frame * mChannelCount), offsets[i] - frame);
+                frame = offsets[i];
+            }
+            int32_t result = applyEvent(events[i]);
+            if (result == 0) {
+                applied++;
             }
-            framesLeft -= kSynthmarkFramesPerRender;
-            mFrameCounter += kSynthmarkFramesPerRender;
-            renderBuffer += kSynthmarkFramesPerRender * SAMPLES_PER_FRAME;
         }
-        assert(framesLeft == 0);
+        if (frame < numFrames) {
+            renderBlocks(output + (frame * mChannelCount), numFrames - frame);
+        }
+        return applied;
     }
 
     int32_t getActiveVoiceCount() {
         return mActiveVoiceCount;
     }
 
+    int32_t getChannelCount() const {
+        return mChannelCount;
+    }
+
+    /**
+     * @return number of blocks that were split between two render() calls
+     */
+    int64_t getPartialBlockCount() const {
+        return mFifo.getPartialBlockCount();
+    }
+
+    /**
+     * @return number of blocks shortened to start an event on its exact frame
+     */
+    int64_t getShortBlockCount() const {
+        return mShortBlockCount;
+    }
+
 private:
+    int32_t applyEvent(const NoteEvent &event) {
+        bool isNoteOn = (event.type == NoteEventType::NoteOn);
+        if (event.voiceIndex == kNoteEventAnyVoice) {
+            int32_t noteNumber = (int32_t) event.pitch;
+            return isNoteOn ? allocateNoteOn(noteNumber, event.velocity)
+                            : allocateNoteOff(noteNumber);
+        }
+        return isNoteOn ? noteOn(event.voiceIndex, event.pitch, event.velocity)
+                        : noteOff(event.voiceIndex);
+    }
+
+    /**
+     * Stop rendering the released voices at the top once they are silent.
+     */
+    void trimIdleVoices() {
+        while (mActiveVoiceCount > 0
+                && mVoiceNotes[mActiveVoiceCount - 1] == kSynthmarkNoNote
+                && mVoices->isIdle(mActiveVoiceCount - 1)) {
+            mActiveVoiceCount--;
+        }
+    }
+
+    /**
+     * Render blocks of kSynthmarkFramesPerRender frames.
+     * If numFrames is not a multiple then the last block is shorter.
+     */
+    void renderBlocks(float *output, int32_t numFrames) {
+        int32_t framesLeft = numFrames;
+        float *renderBuffer = output;
+
+        // Clear mixing buffer.
+        memset(output, 0, numFrames * mChannelCount * sizeof(float));
+
+        while (framesLeft > 0) {
+            int32_t blockFrames = kSynthmarkFramesPerRender;
+            if (framesLeft < kSynthmarkFramesPerRender) {
+                blockFrames = framesLeft;
+                mShortBlockCount++;
+            }
+            startPendingVoices();
+            if (mOversampling == 1) {
+                mVoices->renderBlock(renderBuffer, blockFrames, mActiveVoiceCount,
+                                     mVoiceAmplitude, mChannelCount, mVoiceGains.data());
+            } else {
+                renderOversampledBlock(renderBuffer, blockFrames);
+            }
+            framesLeft -= blockFrames;
+            mFrameCounter += blockFrames;
+            renderBuffer += blockFrames * mChannelCount;
+        }
+        if (mPolyphony > 0) {
+            trimIdleVoices();
+        }
+    }
+
+    /**
+     * Start a few of the voices requested by notesOn().
+     */
+    void startPendingVoices() {
+        int32_t numToStart = std::min(kSynthmarkNoteOnsPerBlock, mNoteOnsLeftInBurst);
+        int32_t lastVoice = std::min(mNextVoiceToStart + numToStart, mVoicesToStart);
+        for (int iv = mNextVoiceToStart; iv < lastVoice; iv++) {
+            if (mChannelCount != SAMPLES_PER_FRAME) {
+                MultichannelPanner::calculateGains(iv, mActiveVoiceCount, mVoiceAmplitude,
+                                                   mChannelCount,
+                                                   &mVoiceGains[iv * mChannelCount]);
+            }
+            mVoices->noteOn(iv, mNotePitches[iv], 1.0);
+        }
+        if (lastVoice > mNextVoiceToStart) {
+            mNoteOnsLeftInBurst -= lastVoice - mNextVoiceToStart;
+            mNextVoiceToStart = lastVoice;
+        }
+    }
+
+    /**
+     * Render mOversampling blocks at the high rate, then decimate
+     * them into one block at the output rate.
+     */
+    void renderOversampledBlock(float *output, int32_t numFrames) {
+        const int32_t numHighFrames = numFrames * mOversampling;
+        const int32_t channelCount = mChannelCount;
+        memset(mHighRateMix, 0, numHighFrames * channelCount * sizeof(float));
+        float *mix = mHighRateMix;
+        for (int i = 0; i < mOversampling; i++) {
+            mVoices->renderBlock(mix, numFrames, mActiveVoiceCount, mVoiceAmplitude,
+                                 channelCount, mVoiceGains.data());
+            mix += numFrames * channelCount;
+        }
+
+        for (int ch = 0; ch < channelCount; ch++) {
+            for (int i = 0; i < numHighFrames; i++) {
+                mHighRateChannel[i] = mHighRateMix[(i * channelCount) + ch];
+            }
+            mDecimators[ch].process(mHighRateChannel, mLowRateChannel, numFrames);
+            for (int i = 0; i < numFrames; i++) {
+                output[(i * channelCount) + ch] = mLowRateChannel[i];
+            }
+        }
+    }
+
+    static VoiceBankBase *createVoiceBank(SampleType sampleType, int32_t maxVoices,
+                                          int32_t sampleRate, PseudoRandom &random) {
+        switch (sampleType) {
+            case SampleType::Float:
+                return new VoiceBank<float>(maxVoices, sampleRate, random);
+            case SampleType::Double:
+                return new VoiceBank<double>(maxVoices, sampleRate, random);
+            case SampleType::Q31:
+                return new VoiceBank<synth_q31_t>(maxVoices, sampleRate, random);
+            case SampleType::Q15:
+                return new VoiceBank<synth_q15_t>(maxVoices, sampleRate, random);
+        }
+        return NULL;
+    }
+
     int32_t mMaxVoices;
     int32_t mActiveVoiceCount;
     int64_t mFrameCounter;
-    SimpleVoice *mVoices;
+    VoiceBankBase *mVoices;
+    PseudoRandom mRandom;
     synth_float_t mVoiceAmplitude = 1.0;
+
+    int32_t mChannelCount = SAMPLES_PER_FRAME;
+    std::vector<float> mVoiceGains; // used when not stereo
+
+    // Voices waiting to be started after notesOn().
+    std::vector<synth_float_t> mNotePitches;
+    int32_t mNextVoiceToStart = 0;
+    int32_t mVoicesToStart = 0;
+    int32_t mNoteOnsLeftInBurst = kSynthmarkNoteOnsPerBurst; // reset by each render call
+    int64_t mShortBlockCount = 0;
+
+    // Voice allocation, used after setPolyphony().
+    int32_t mPolyphony = 0;
+    std::vector<int32_t> mVoiceNotes;      // note held by each voice, or kSynthmarkNoNote
+    std::vector<int64_t> mVoiceStartOrder; // to find the oldest voice
+    int64_t mNoteOnCounter = 0;
+    int32_t mPeakVoiceCount = 0;
+    int64_t mStealCount = 0;
+
+    RenderFifo mFifo;
+
+    int32_t mOversampling = 1;
+    OversamplingDecimator mDecimators[kSynthmarkMaxChannels];
+    float mHighRateMix[kHalfBandMaxInput * kSynthmarkMaxChannels];
+    float mHighRateChannel[kHalfBandMaxInput];
+    float mLowRateChannel[kSynthmarkFramesPerRender];
 };
 
 #endif // SYNTHMARK_SYNTHESIZER_H
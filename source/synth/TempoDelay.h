@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_TEMPO_DELAY_H
+#define SYNTHMARK_TEMPO_DELAY_H
+
+#include <cstdint>
+#include "SynthMark.h"
+#include "DelayLine.h"
+
+/**
+ * Ping-pong delay synchronized to a tempo.
+ * Each echo crosses over to the other channel.
+ */
+class TempoDelay
+{
+public:
+    TempoDelay()
+    : mTempo(120.0f)
+    , mBeats(0.75f) // dotted eighth note
+    , mFeedback(0.35f)
+    , mMix(0.3f)
+    {}
+
+    virtual ~TempoDelay() = default;
+
+    void setup(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        calculateDelay();
+        mLeft.allocate(mDelayFrames);
+        mRight.allocate(mDelayFrames);
+    }
+
+    /**
+     * Set the tempo in beats per minute. Call setup() afterwards
+     * to allocate a long enough delay line.
+     */
+    void setTempo(float beatsPerMinute) {
+        mTempo = beatsPerMinute;
+    }
+
+    /**
+     * Process interleaved stereo in place.
+     */
+    void process(float *buffer, int32_t numFrames) {
+        const float feedback = mFeedback;
+        const float mix = mMix;
+        for (int frame = 0; frame < numFrames; frame++) {
+            float left = buffer[0];
+            float right = buffer[1];
+            float delayedLeft = mLeft.read(mDelayFrames);
+            float delayedRight = mRight.read(mDelayFrames);
+            mLeft.write(left + (delayedRight * feedback));
+            mRight.write(right + (delayedLeft * feedback));
+            *buffer++ = left + (delayedLeft * mix);
+            *buffer++ = right + (delayedRight * mix);
+        }
+    }
+
+private:
+    void calculateDelay() {
+        float seconds = mBeats * 60.0f / mTempo;
+        mDelayFrames = (int32_t) (seconds * mSampleRate);
+        if (mDelayFrames < 1) {
+            mDelayFrames = 1;
+        }
+    }
+
+    DelayLine mLeft;
+    DelayLine mRight;
+    int32_t   mSampleRate = kSynthmarkSampleRate;
+    int32_t   mDelayFrames = 1;
+
+    float     mTempo;      // beats per minute
+    float     mBeats;      // delay time in beats
+    float     mFeedback;
+    float     mMix;
+};
+
+#endif // SYNTHMARK_TEMPO_DELAY_H
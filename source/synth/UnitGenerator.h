@@ -27,28 +27,48 @@
 #include "SynthMark.h"
 #include "DifferentiatedParabola.h"
 
-class UnitGenerator
+/**
+ * Holds the sample rate used by a unit generator.
+ * Each instance has its own rate so that independent synthesizers can
+ * run at different rates in the same process.
+ */
+class UnitGeneratorBase
 {
 public:
-    UnitGenerator() {}
+    UnitGeneratorBase() {}
 
-    virtual ~UnitGenerator() = default;
+    virtual ~UnitGeneratorBase() = default;
 
-    static void setSampleRate(int32_t sampleRate) {
+    /**
+     * Units that contain other units should pass the rate on to them.
+     */
+    virtual void setSampleRate(int32_t sampleRate) {
         assert(sampleRate > 0);
         mSampleRate = sampleRate;
         mSamplePeriod = 1.0f / sampleRate;
     }
 
-    static int32_t getSampleRate() {
+    int32_t getSampleRate() const {
         return mSampleRate;
     }
 
-    synth_float_t output[kSynthmarkFramesPerRender];
+protected:
+    int32_t mSampleRate = kSynthmarkSampleRate;
+    synth_float_t mSamplePeriod = 1.0f / kSynthmarkSampleRate;
+};
 
+/**
+ * @tparam T type of the output signal, see SampleTraits.h
+ */
+template <typename T = synth_float_t>
+class UnitGenerator : public UnitGeneratorBase
+{
 public:
-    static int32_t mSampleRate;
-    static synth_float_t mSamplePeriod;
+    UnitGenerator() {}
+
+    virtual ~UnitGenerator() = default;
+
+    T output[kSynthmarkFramesPerRender];
 };
 
 #endif // SYNTHMARK_UNIT_GENERATOR_H
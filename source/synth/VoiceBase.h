@@ -24,7 +24,8 @@
 /**
  * Base class for building synthesizers.
  */
-class VoiceBase  : public UnitGenerator
+template <typename T = synth_float_t>
+class VoiceBase  : public UnitGenerator<T>
 {
 public:
     VoiceBase()
@@ -37,13 +37,18 @@ class AudioSinkBase
 {
 public:
     AudioSinkBase() {}
-    virtual ~AudioSinkBase() {}
+    virtual ~AudioSinkBase() {
+        delete mCpuManager;
+    }
 
     virtual int32_t initialize() {
         return 0;
     }
 
     virtual int32_t open(int32_t sampleRate, int32_t samplesPerFrame, int32_t framesPerBurst) {
+        if (samplesPerFrame < 1 || samplesPerFrame > kSynthmarkMaxChannels) {
+            return -1;
+        }
         mSampleRate = sampleRate;
         mSamplesPerFrame = samplesPerFrame;
         mFramesPerBurst = framesPerBurst;
@@ -101,6 +106,13 @@ public:
         mUnderrunCount = i;
     }
 
+    /**
+     * @return wakeup time requested by the last write, or 0 if it did not sleep
+     */
+    int64_t getLastSleepTargetNanos() const {
+        return mLastSleepTargetNanos;
+    }
+
     int32_t getSampleRate() {
         return mSampleRate;
     }
@@ -134,6 +146,16 @@ public:
         return (int64_t) 0;
     }
 
+    /**
+     * The callback should ideally start when the device frees room for it.
+     * @return valid time or zero
+     */
+    virtual int64_t getIdealCallbackTime() {
+        // The buffer was full one burst ago.
+        int64_t framePosition = getFramesWritten() - getBufferSizeInFrames() - mFramesPerBurst;
+        return convertFrameToTime(framePosition);
+    }
+
     virtual int32_t terminate() {
         return 0;
     }
@@ -160,6 +182,17 @@ public:
     virtual void setThreadType(HostThreadFactory::ThreadType mThreadType) {
     }
 
+    /**
+     * Each sink owns its CPU manager so that independent streams do not share timing state.
+     * @return CPU manager for the callback thread, created on first use
+     */
+    HostCpuManagerBase *getCpuManager() {
+        if (mCpuManager == NULL) {
+            mCpuManager = HostCpuManager::create();
+        }
+        return mCpuManager;
+    }
+
 protected:
     void setActualCpu(int cpuAffinity) {
         mActualCpu = cpuAffinity;
@@ -170,6 +203,7 @@ protected:
     int32_t       mSamplesPerFrame = 1;
     int32_t       mFramesPerBurst = 0;
     int32_t       mUnderrunCount = 0;
+    int64_t       mLastSleepTargetNanos = 0;
 
 private:
     IAudioSinkCallback *mCallback = NULL;
@@ -177,6 +211,7 @@ private:
     volatile bool  mSchedFifoUsed = false;
     int            mRequestedCpu = SYNTHMARK_CPU_UNSPECIFIED;
     int            mActualCpu = SYNTHMARK_CPU_UNSPECIFIED;
+    HostCpuManagerBase *mCpuManager = NULL;
 };
 
 #endif // SYNTHMARK_AUDIO_SINK_BASE_H
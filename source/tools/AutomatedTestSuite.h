@@ -91,8 +91,7 @@ private:
         VoiceMarkHarness *harness = new VoiceMarkHarness(mAudioSink, &result1);
         harness->setTargetCpuLoad(kMaxUtilization);
         harness->setInitialVoiceCount(mNumVoices);
-        harness->setDelayNoteOnSeconds(mDelayNotesOn);
-        harness->setThreadType(mThreadType);
+        copyParametersTo(harness);
 
         // TODO This is hack way to choose CPUs for BIG.little architectures.
         // TODO Test each CPU or come up with something better.
@@ -167,10 +166,9 @@ private:
         std::stringstream resultMessage;
         SynthMarkResult result1;
         LatencyMarkHarness *harness = new LatencyMarkHarness(mAudioSink, &result1);
-        harness->setDelayNoteOnSeconds(mDelayNotesOn);
+        copyParametersTo(harness);
         harness->setNumVoices(numVoices);
         harness->setNumVoicesHigh(numVoicesHigh);
-        harness->setThreadType(mThreadType);
 
         mAudioSink->setRequestedCpu(cpu);
         int32_t err = harness->runTest(sampleRate, framesPerBurst, numSeconds);
@@ -17,6 +17,7 @@
 #ifndef ANDROID_BINCOUNTER_H
 #define ANDROID_BINCOUNTER_H
 
+#include <cmath>
 #include <cstdint>
 
 
@@ -69,6 +70,29 @@ public:
         return mLastMarkers;
     }
 
+    /**
+     * @param fraction of the counts, for example 0.99 for the 99th percentile
+     * @return index of the first bin at or above that fraction, or -1 if empty
+     */
+    int32_t getPercentileBin(double fraction) const {
+        int64_t total = 0;
+        for (int i = 0; i < mNumBins; i++) {
+            total += mBins[i];
+        }
+        if (total == 0) {
+            return -1;
+        }
+        int64_t threshold = (int64_t) ceil(fraction * total);
+        int64_t sum = 0;
+        for (int i = 0; i < mNumBins; i++) {
+            sum += mBins[i];
+            if (sum >= threshold) {
+                return i;
+            }
+        }
+        return mNumBins - 1;
+    }
+
 private:
     int32_t *mBins;
     int32_t *mLastMarkers;
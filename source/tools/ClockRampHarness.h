@@ -27,6 +27,7 @@
 #include "synth/Synthesizer.h"
 #include "TestHarnessParameters.h"
 #include "tools/CpuAnalyzer.h"
+#include "tools/CpuFrequencyEstimator.h"
 #include "tools/LogTool.h"
 #include "tools/TestHarnessBase.h"
 #include "tools/TimingAnalyzer.h"
@@ -37,6 +38,10 @@
  * This is measured indirectly.
  * Detect when the render time is higher than real-time, that is > 100% CPU utilization.
  * Then measure how long it takes to return to real-time.
+ *
+ * When the CPU frequency is estimated, -f1, the ramp is also measured directly as
+ * the time from the increase in workload until the frequency reaches
+ * kFrequencyRampFraction of the maximum.
  */
 class ClockRampHarness : public ChangingVoiceHarness {
 public:
@@ -61,6 +66,11 @@ public:
         mRampDurationSum = 0;
         mRampDurationCount = 0;
         mPreviousVoiceCount = getNumVoices();
+        mFrequencyRampPending = false;
+        mFrequencyRampSum = 0;
+        mFrequencyRampCount = 0;
+        mFrequencyRampMissed = 0;
+        mJumpMHzSum = 0;
     }
 
     int32_t onBeforeNoteOn() override {
@@ -77,12 +87,16 @@ public:
         IAudioSinkCallback::Result result = ChangingVoiceHarness::onRenderAudio(buffer, numFrames);
 
         double utilization = getBurstUtilization();
+        if (mFrequencyRampPending) {
+            updateFrequencyRamp();
+        }
 
         // State machine for analysing clock ramp.
         switch(mState) {
             case STATE_LOW:
                 // Did we increase the workload?
                 if (mSynth.getActiveVoiceCount() > mPreviousVoiceCount) {
+                    startFrequencyRamp();
                     double highUtilization = mSynth.getActiveVoiceCount() * mPreviousUtilization
                             / mPreviousVoiceCount;
 
@@ -176,14 +190,60 @@ public:
             mResult->setMeasurement(averageRampMillis);
             resultMessage << "clock.ramp.msec = " << averageRampMillis << std::endl;
         }
+        if (mFrequencyEstimator.getSource() != FrequencySource::None) {
+            resultMessage << "frequency.ramp.count = " << mFrequencyRampCount << std::endl;
+            resultMessage << "frequency.ramp.missed = " << mFrequencyRampMissed << std::endl;
+            resultMessage << "frequency.ramp.valid = "
+                          << (mFrequencyEstimator.isValid() ? 1 : 0) << std::endl;
+            if (mFrequencyRampCount > 0) {
+                resultMessage << "frequency.ramp.msec = "
+                              << ((double) mFrequencyRampSum
+                                  / (mFrequencyRampCount * SYNTHMARK_NANOS_PER_MILLISECOND))
+                              << std::endl;
+                resultMessage << "frequency.at.jump.mhz = "
+                              << (mJumpMHzSum / mFrequencyRampCount) << std::endl;
+            }
+        }
 
         resultMessage << "underrun.count = " << mAudioSink->getUnderrunCount() << "\n";
         resultMessage << mCpuAnalyzer.dump();
+        resultMessage << mPerfAnalyzer.dump();
 
         mResult->appendMessage(resultMessage.str());
     }
 
 private:
+    // Start timing the frequency ramp when the workload goes up.
+    void startFrequencyRamp() {
+        if (mFrequencyEstimator.getLastMHz() <= 0 || mFrequencyEstimator.isLastAboveMax()) {
+            return;
+        }
+        mFrequencyRampPending = true;
+        mFrequencyJumpNanos = mTimer.getLastEntryTime();
+        mFrequencyAtJumpMHz = mFrequencyEstimator.getLastMHz();
+    }
+
+    void updateFrequencyRamp() {
+        int32_t targetMHz = (int32_t) (kFrequencyRampFraction
+                                       * mFrequencyEstimator.getMaxCpuSpeedMHz());
+        if (mFrequencyEstimator.isLastAboveMax()) {
+            return; // not believable, wait for the next reading
+        } else if (mFrequencyEstimator.getLastMHz() >= targetMHz) {
+            int64_t rampNanos = mTimer.getLastEntryTime() - mFrequencyJumpNanos;
+            mFrequencyRampSum += rampNanos;
+            mFrequencyRampCount++;
+            mJumpMHzSum += mFrequencyAtJumpMHz;
+            mFrequencyRampPending = false;
+            mLogTool->log("frequency %d => %d MHz, ramp(us) = %d\n",
+                          mFrequencyAtJumpMHz, mFrequencyEstimator.getLastMHz(),
+                          (int) (rampNanos / SYNTHMARK_NANOS_PER_MICROSECOND));
+        } else if (mSynth.getActiveVoiceCount() < mPreviousVoiceCount) {
+            // The workload went down before the clock reached the target.
+            mFrequencyRampMissed++;
+            mFrequencyRampPending = false;
+        }
+    }
+
     enum states_t {
         STATE_LOW,        // low num voices
         STATE_SATURATED,  // high num voices, running at saturated CPU
@@ -202,6 +262,17 @@ private:
     int32_t     mPreviousVoiceCount = 0;
     states_t    mState = STATE_LOW;
 
+    bool        mFrequencyRampPending = false;
+    int64_t     mFrequencyJumpNanos = 0;
+    int32_t     mFrequencyAtJumpMHz = 0;
+    int64_t     mFrequencyRampSum = 0;
+    int32_t     mFrequencyRampCount = 0;
+    int32_t     mFrequencyRampMissed = 0;
+    int64_t     mJumpMHzSum = 0;
+
+    // Fraction of the maximum frequency that ends a frequency ramp.
+    static constexpr double kFrequencyRampFraction = 0.9;
+
     // Trigger points with hysteresis.
     static constexpr double kUtilizationThresholdLow = 0.95;
     static constexpr double kUtilizationThresholdHigh = 1.0;
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_CPU_FREQUENCY_ESTIMATOR_H
+#define SYNTHMARK_CPU_FREQUENCY_ESTIMATOR_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "tools/PerfCounterAnalyzer.h"
+
+// Length of the spin loop run after each burst when there is no cycle counter.
+constexpr int64_t kCpuFrequencyProbeNanos = 2 * SYNTHMARK_NANOS_PER_MICROSECOND;
+// Spin this long before calibrating so the governor raises the clock.
+constexpr int64_t kCpuFrequencyWarmupNanos = 50 * SYNTHMARK_NANOS_PER_MILLISECOND;
+constexpr int64_t kCpuFrequencyCalibrationNanos = 10 * SYNTHMARK_NANOS_PER_MILLISECOND;
+// Keep the fastest run so a run that was interrupted or still ramping up is ignored.
+constexpr int32_t kCpuFrequencyCalibrationRuns = 5;
+// Used as the calibrated speed when the maximum frequency cannot be read.
+constexpr int32_t kCpuFrequencyAssumedMHz = 1000;
+// A short probe cannot resolve the frequency better than this.
+constexpr double  kCpuFrequencyTolerance = 0.05;
+// More readings than this above the maximum means the calibration is biased.
+constexpr double  kCpuFrequencyMaxAboveFraction = 0.05;
+
+enum class FrequencySource {
+    None,
+    PerfCounters, // cycles divided by task clock
+    SpinLoop,     // time to run a calibrated loop
+};
+
+/**
+ * Estimate the effective CPU frequency during each burst.
+ *
+ * When PerfCounterAnalyzer can count cycles, the frequency is the number of cycles
+ * divided by the task clock of the burst. Otherwise a short loop of dependent
+ * multiplies, which take the same number of cycles at any clock, is timed after
+ * the burst and compared with a calibration run at the maximum frequency.
+ * The spin loop adds kCpuFrequencyProbeNanos to each burst.
+ */
+class CpuFrequencyEstimator
+{
+public:
+    static void setEnabled(bool enabled) {
+        mEnabled = enabled;
+    }
+
+    static bool isEnabled() {
+        return mEnabled;
+    }
+
+    static const char *sourceToString(FrequencySource source) {
+        switch (source) {
+            case FrequencySource::None: return "none";
+            case FrequencySource::PerfCounters: return "perf";
+            case FrequencySource::SpinLoop: return "spin";
+        }
+        return "?";
+    }
+
+    /**
+     * Calibrate the spin loop once per process.
+     * The results are shared by every estimator without locking, so call this
+     * from main() before any harness or thread starts. It takes about 100 msec.
+     * The runs are timed with the thread CPU clock so time spent preempted is not counted.
+     */
+    static void calibrate() {
+        if (mNanosPerIteration > 0.0) {
+            return;
+        }
+        int64_t warmupIterations = 0;
+        int64_t warmupNanos = spinFor(kCpuFrequencyWarmupNanos, &warmupIterations);
+        // Time each run as one loop so that reading the clock, which may be
+        // a system call, does not make the loop look slower than it is.
+        int32_t runIterations = (int32_t) (warmupIterations * kCpuFrequencyCalibrationNanos
+                                           / warmupNanos);
+        double bestNanosPerIteration = 0.0;
+        for (int32_t run = 0; run < kCpuFrequencyCalibrationRuns; run++) {
+            int64_t iterations = 0;
+            int64_t elapsed = spin(runIterations, HostTools::getThreadCpuNanoTime, &iterations);
+            double nanosPerIteration = (double) elapsed / iterations;
+            if (bestNanosPerIteration == 0.0 || nanosPerIteration < bestNanosPerIteration) {
+                bestNanosPerIteration = nanosPerIteration;
+            }
+        }
+        mProbeIterations = (int32_t) (kCpuFrequencyProbeNanos / bestNanosPerIteration) + 1;
+        mMaxCpuSpeedMHz = readMaxCpuSpeedMHz();
+        mMaxSpeedKnown = (mMaxCpuSpeedMHz > 0);
+        if (!mMaxSpeedKnown) {
+            mMaxCpuSpeedMHz = kCpuFrequencyAssumedMHz;
+        }
+        mNanosPerIteration = bestNanosPerIteration; // last, it marks the calibration done
+    }
+
+    void reset() {
+        mSource = FrequencySource::None;
+        mLastMHz = 0;
+        mMinMHz = INT32_MAX;
+        mHighestMHz = 0;
+        mSumMHz = 0;
+        mCount = 0;
+        mAboveMaxCount = 0;
+    }
+
+    /**
+     * Called on the render thread after each burst.
+     * @return effective frequency of the burst in MHz, or 0 if unknown
+     */
+    int32_t estimate(const PerfCounterAnalyzer &perfAnalyzer) {
+        mLastMHz = 0;
+        if (perfAnalyzer.isAvailable(PerfCounter::Cycles)
+                && perfAnalyzer.isAvailable(PerfCounter::TaskClock)) {
+            mSource = FrequencySource::PerfCounters;
+            int64_t nanos = perfAnalyzer.getLastBurst(PerfCounter::TaskClock);
+            if (perfAnalyzer.hasLastBurst() && nanos > 0) {
+                mLastMHz = (int32_t) (perfAnalyzer.getLastBurst(PerfCounter::Cycles)
+                        * SYNTHMARK_MILLIS_PER_SECOND / nanos);
+            }
+        } else if (mNanosPerIteration > 0.0) {
+            mSource = FrequencySource::SpinLoop;
+            int64_t iterations = 0;
+            int64_t elapsed = spin(mProbeIterations, HostTools::getNanoTime, &iterations);
+            if (elapsed > 0) {
+                mLastMHz = (int32_t) (mMaxCpuSpeedMHz * mNanosPerIteration * iterations
+                        / elapsed);
+            }
+        }
+        if (isLastAboveMax()) {
+            mAboveMaxCount++;
+        }
+        if (mLastMHz > 0) {
+            mSumMHz += mLastMHz;
+            mCount++;
+            if (mLastMHz < mMinMHz) {
+                mMinMHz = mLastMHz;
+            }
+            if (mLastMHz > mHighestMHz) {
+                mHighestMHz = mLastMHz;
+            }
+        }
+        return mLastMHz;
+    }
+
+    int32_t getLastMHz() const {
+        return mLastMHz;
+    }
+
+    /**
+     * A reading above the maximum frequency, by more than the tolerance, is not believable.
+     * It is still reported so that a biased calibration can be seen.
+     */
+    bool isLastAboveMax() const {
+        bool maxIsReference = mMaxSpeedKnown || mSource == FrequencySource::SpinLoop;
+        return maxIsReference && mLastMHz > mMaxCpuSpeedMHz * (1.0 + kCpuFrequencyTolerance);
+    }
+
+    /**
+     * @return false if too many readings were above the maximum frequency
+     */
+    bool isValid() const {
+        return mCount == 0 || mAboveMaxCount <= kCpuFrequencyMaxAboveFraction * mCount;
+    }
+
+    /**
+     * @return the maximum frequency of the CPU, or the highest one measured if that is unknown
+     */
+    int32_t getMaxCpuSpeedMHz() const {
+        if (mSource == FrequencySource::PerfCounters && !mMaxSpeedKnown) {
+            return mHighestMHz;
+        }
+        return mMaxCpuSpeedMHz;
+    }
+
+    FrequencySource getSource() const {
+        return mSource;
+    }
+
+    std::string dump() {
+        std::stringstream result;
+        if (!mEnabled) {
+            return result.str();
+        }
+        result << "cpu.frequency.source = " << sourceToString(mSource) << std::endl;
+        result << "cpu.frequency.max.mhz = " << getMaxCpuSpeedMHz()
+               << (mMaxSpeedKnown ? "" : " # assumed") << std::endl;
+        if (mCount > 0) {
+            result << "cpu.frequency.mean.mhz = " << (mSumMHz / mCount) << std::endl;
+            result << "cpu.frequency.min.mhz = " << mMinMHz << std::endl;
+            result << "cpu.frequency.highest.mhz = " << mHighestMHz << std::endl;
+            result << "cpu.frequency.above.max.count = " << mAboveMaxCount << std::endl;
+            result << "cpu.frequency.above.max.fraction = "
+                   << ((double) mAboveMaxCount / mCount) << std::endl;
+            result << "cpu.frequency.valid = " << (isValid() ? 1 : 0);
+            if (!isValid()) {
+                result << " # too many readings above the maximum, the calibration is biased";
+            }
+            result << std::endl;
+        }
+        return result.str();
+    }
+
+private:
+    /**
+     * Run a chain of dependent multiplies.
+     * @return elapsed nanoseconds
+     */
+    static int64_t spin(int32_t numIterations, int64_t (*clock)(), int64_t *iterations) {
+        int64_t start = clock();
+        uint32_t x = 1;
+        for (int32_t i = 0; i < numIterations; i++) {
+            x = x * 1664525u + 1013904223u;
+            __asm__ __volatile__("" : "+r" (x)); // keep the compiler from folding the loop
+        }
+        int64_t elapsed = clock() - start;
+        volatile uint32_t result = x; // keep the loop, local so threads do not share it
+        (void) result;
+        *iterations += numIterations;
+        return elapsed;
+    }
+
+    static int64_t spinFor(int64_t nanos, int64_t *iterations) {
+        constexpr int32_t kChunk = 10000;
+        int64_t count = 0;
+        int64_t elapsed = 0;
+        while (elapsed < nanos) {
+            elapsed += spin(kChunk, HostTools::getNanoTime, &count);
+        }
+        *iterations = count;
+        return elapsed;
+    }
+
+    /**
+     * @return maximum frequency of CPU 0 in MHz, or 0 if unknown
+     */
+    static int32_t readMaxCpuSpeedMHz() {
+        int32_t mhz = 0;
+        FILE *file = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+        if (file != nullptr) {
+            int32_t khz = 0;
+            if (fscanf(file, "%d", &khz) == 1) {
+                mhz = khz / 1000;
+            }
+            fclose(file);
+            return mhz;
+        }
+        // Some virtual machines only report a nominal speed.
+        file = fopen("/proc/cpuinfo", "r");
+        if (file != nullptr) {
+            char line[256];
+            while (fgets(line, sizeof(line), file) != nullptr) {
+                double value = 0.0;
+                if (strncmp(line, "cpu MHz", 7) == 0
+                        && sscanf(strchr(line, ':') + 1, "%lf", &value) == 1) {
+                    mhz = (int32_t) value;
+                    break;
+                }
+            }
+            fclose(file);
+        }
+        return mhz;
+    }
+
+    static bool     mEnabled;
+    static double   mNanosPerIteration;
+    static int32_t  mProbeIterations;
+    static int32_t  mMaxCpuSpeedMHz;
+    static bool     mMaxSpeedKnown;
+
+    FrequencySource mSource = FrequencySource::None;
+    int32_t         mLastMHz = 0;
+    int32_t         mMinMHz = INT32_MAX;
+    int32_t         mHighestMHz = 0;
+    int64_t         mSumMHz = 0;
+    int64_t         mCount = 0;
+    int64_t         mAboveMaxCount = 0; // counted in the mean, see isValid()
+};
+
+#endif // SYNTHMARK_CPU_FREQUENCY_ESTIMATOR_H
@@ -326,6 +326,14 @@ private:
         } else {
             durationTimer = mEndingTime_ns - mStartingTime_ns;
             duration = durationTimer;
+            /*
+             * The DEADLINE runtime is scaled to the maximum frequency by the
+             * kernel, so scale the wall clock time the same way when the
+             * frequency of the burst was measured.
+             */
+            if (getMeasuredCpuSpeedMHz() > 0 && getMeasuredMaxCpuSpeedMHz() > 0) {
+                duration = duration * getMeasuredCpuSpeedMHz() / getMeasuredMaxCpuSpeedMHz();
+            }
         }
 
         mCpuTiming.reportApplicationRuntime(duration, getCurrentWorkUnits());
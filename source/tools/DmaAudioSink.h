@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_DMA_AUDIO_SINK_H
+#define SYNTHMARK_DMA_AUDIO_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "AudioSinkBase.h"
+#include "HostTools.h"
+#include "LogTool.h"
+#include "SpscRingBuffer.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+#include "VirtualAudioSink.h"
+
+// Poll interval for the render thread when the consumer is late.
+constexpr int64_t kDmaPollNanos = 50 * SYNTHMARK_NANOS_PER_MICROSECOND;
+
+/**
+ * A VirtualAudioSink that models the audio hardware with a real thread.
+ *
+ * The render thread writes each burst into a shared lock-free ring.
+ * A separate "DMA" thread reads from the ring at the times given by the
+ * HardwareTimingModel and touches every sample, like a driver would.
+ * So the rendered data really moves between cores and both threads pay
+ * their own wakeup costs. If the ring does not hold a full read when the
+ * DMA thread wakes up then the consumer counts an underrun, plays what is
+ * there and fills the rest with silence.
+ *
+ * If a CPU is requested for the render thread then the DMA thread is
+ * placed on the next CPU.
+ */
+class DmaAudioSink : public VirtualAudioSink
+{
+public:
+    DmaAudioSink(LogTool *logTool = NULL)
+    : VirtualAudioSink(logTool)
+    , mLogTool(logTool)
+    {}
+
+    virtual ~DmaAudioSink() {
+        stopConsumer();
+        delete mConsumerThread;
+    }
+
+    int32_t open(int32_t sampleRate, int32_t samplesPerFrame,
+            int32_t framesPerBurst) override {
+        int32_t result = VirtualAudioSink::open(sampleRate, samplesPerFrame, framesPerBurst);
+        if (result < 0) {
+            return result;
+        }
+        mRing.setup(getBufferCapacityInFrames() * samplesPerFrame);
+        mNanosPerBurst = framesPerBurst * SYNTHMARK_NANOS_PER_SECOND / sampleRate;
+        return result;
+    }
+
+    virtual int32_t start() override {
+        // A consumer left over from a measurement that failed must not share the ring.
+        stopConsumer();
+        int32_t result = fitBufferToFramesPerRead();
+        if (result < 0) {
+            return result;
+        }
+
+        // Start with the buffer full of silence, like the VirtualAudioSink.
+        mRing.reset();
+        std::vector<float> silence(getBufferSizeInFrames() * mSamplesPerFrame, 0.0f);
+        mRing.write(silence.data(), (int32_t) silence.size());
+
+        // Give the threads one burst to get going before the first read.
+        mStartTimeNanos = HostTools::getNanoTime() + mNanosPerBurst;
+        mNextReadTimeNanos.store(mStartTimeNanos);
+        mLastReadTimeNanos.store(0);
+        mConsumerModel = getTimingModel();
+        mConsumerModel.start(mStartTimeNanos, mSampleRate, mFramesPerBurst);
+        mConsumerBuffer.assign(mConsumerModel.getFramesPerRead() * mSamplesPerFrame, 0.0f);
+        mConsumerEnabled.store(true);
+
+        // A HostThread cannot be restarted so use a new one for each measurement.
+        delete mConsumerThread;
+        mConsumerThread = new HostThread();
+        int err = mConsumerThread->start(consumerProcWrapper, this);
+        if (err != 0) {
+            mConsumerEnabled.store(false);
+            if (mLogTool) {
+                mLogTool->log("ERROR in DmaAudioSink, consumer start() failed, %d\n", err);
+            }
+            return SYNTHMARK_RESULT_THREAD_FAILURE;
+        }
+        result = VirtualAudioSink::start();
+        if (result < 0) {
+            stopConsumer();
+        }
+        return result;
+    }
+
+    virtual int32_t stop() override {
+        stopConsumer();
+        return VirtualAudioSink::stop();
+    }
+
+    int64_t getIdealCallbackTime() override {
+        return mLastReadTimeNanos.load();
+    }
+
+    int64_t convertFrameToTime(int64_t framePosition) override {
+        return mStartTimeNanos + (framePosition * mNanosPerBurst / mFramesPerBurst);
+    }
+
+    /**
+     * Wait until there is room in the buffer then copy the frames into the ring.
+     */
+    virtual void writeBurst(const float *buffer, int32_t numFrames) override {
+        if (hasRoomFor(numFrames)) {
+            // Just let CPU Manager know that a burst has occurred.
+            mLastSleepTargetNanos = 0;
+            getCpuManager()->sleepAndTuneCPU(0);
+        } else {
+            // Sleep until the consumer is expected to read another burst.
+            mLastSleepTargetNanos = mNextReadTimeNanos.load();
+            getCpuManager()->sleepAndTuneCPU(mLastSleepTargetNanos);
+            // The consumer may be a little late waking up.
+            while (!hasRoomFor(numFrames) && mConsumerEnabled.load()) {
+                HostTools::sleepForNanoseconds(kDmaPollNanos);
+            }
+        }
+        mRing.write(buffer, numFrames * mSamplesPerFrame);
+        setFramesWritten(getFramesWritten() + numFrames);
+    }
+
+    virtual int32_t getUnderrunCount() override {
+        return mConsumerUnderruns.load();
+    }
+
+    virtual void setUnderrunCount(int i) override {
+        mConsumerUnderruns.store(i);
+    }
+
+    int getConsumerCpu() const {
+        return mConsumerCpu;
+    }
+
+private:
+
+    // A write bigger than the whole buffer only waits for the buffer to empty.
+    bool hasRoomFor(int32_t numFrames) {
+        int32_t roomNeeded = (numFrames < getBufferSizeInFrames())
+                ? numFrames : getBufferSizeInFrames();
+        int32_t maxFullSamples = (getBufferSizeInFrames() - roomNeeded) * mSamplesPerFrame;
+        return mRing.getFullSamples() <= maxFullSamples;
+    }
+
+    void stopConsumer() {
+        if (mConsumerEnabled.exchange(false)) {
+            mConsumerThread->join();
+        }
+    }
+
+    void consumerLoop() {
+        // Act like a hardware interrupt. These may fail if we are not root.
+        mConsumerThread->promote(SYNTHMARK_THREAD_PRIORITY_DEFAULT + 1);
+        int cpuCount = HostTools::getCpuCount();
+        if (getRequestedCpu() != SYNTHMARK_CPU_UNSPECIFIED && cpuCount > 1) {
+            int cpu = (getRequestedCpu() + 1) % cpuCount;
+            if (mConsumerThread->setCpuAffinity(cpu) == 0) {
+                mConsumerCpu = cpu;
+            }
+        }
+
+        const int32_t readSamples = mConsumerModel.getFramesPerRead() * mSamplesPerFrame;
+        float sum = 0.0f;
+        while (mConsumerEnabled.load()) {
+            HostTools::sleepUntilNanoTime(mConsumerModel.getNextReadTime());
+            // Like real hardware, play whatever is there and fill the rest with silence.
+            int32_t numRead = mRing.read(mConsumerBuffer.data(), readSamples);
+            if (numRead < readSamples) {
+                mConsumerUnderruns++;
+            }
+            // Touch the data so the cache lines really move to this core.
+            for (int32_t i = 0; i < numRead; i++) {
+                sum += mConsumerBuffer[i];
+            }
+            mLastReadTimeNanos.store(mConsumerModel.getNextReadTime());
+            mConsumerModel.advance();
+            mNextReadTimeNanos.store(mConsumerModel.getNextReadTime());
+        }
+        mChecksum = sum;
+    }
+
+    static void * consumerProcWrapper(void *arg) {
+        DmaAudioSink *sink = (DmaAudioSink *) arg;
+        sink->consumerLoop();
+        return NULL;
+    }
+
+    LogTool              *mLogTool = NULL;
+    SpscRingBuffer        mRing;
+    std::vector<float>    mConsumerBuffer;
+    HardwareTimingModel   mConsumerModel;   // used by the consumer thread
+    HostThread           *mConsumerThread = NULL;
+    std::atomic<bool>     mConsumerEnabled{false};
+    std::atomic<int64_t>  mNextReadTimeNanos{0};
+    std::atomic<int64_t>  mLastReadTimeNanos{0};
+    std::atomic<int32_t>  mConsumerUnderruns{0};
+    int64_t               mStartTimeNanos = 0;
+    int64_t               mNanosPerBurst = 1;
+    int                   mConsumerCpu = SYNTHMARK_CPU_UNSPECIFIED;
+    volatile float        mChecksum = 0.0f; // keep the reads from being optimized away
+};
+
+#endif // SYNTHMARK_DMA_AUDIO_SINK_H
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_FILE_AUDIO_SINK_H
+#define SYNTHMARK_FILE_AUDIO_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+#include "HostTools.h"
+#include "LogTool.h"
+#include "SpscRingBuffer.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+#include "VirtualAudioSink.h"
+
+// Number of bursts the writer thread may fall behind before audio is dropped.
+constexpr int kFileRingCapacityInBursts = 256;
+
+// Write the file in large page aligned chunks.
+constexpr int kFileChunkSizeInBytes = 256 * 1024;
+constexpr int kFileChunkAlignment = 4096;
+
+// How often the writer thread checks for more audio.
+constexpr int64_t kFileWriterPollNanos = 2 * SYNTHMARK_NANOS_PER_MILLISECOND;
+
+constexpr int kWavHeaderSize = 44;
+
+/**
+ * A VirtualAudioSink that also saves the rendered audio to a file.
+ *
+ * The render thread copies each burst into a lock-free ring.
+ * A normal priority writer thread drains the ring and writes large chunks to disk.
+ * If the writer falls behind then the burst is dropped and counted
+ * as a file underrun. The render thread never waits for the disk.
+ *
+ * The audio is stored as 32-bit float. If the file name ends in ".wav"
+ * then a WAV header is written, otherwise the file is raw interleaved samples.
+ * The audio from every measurement is appended until terminate() is called.
+ */
+class FileAudioSink : public VirtualAudioSink
+{
+public:
+    FileAudioSink(LogTool *logTool = NULL)
+    : VirtualAudioSink(logTool)
+    , mLogTool(logTool)
+    {}
+
+    virtual ~FileAudioSink() {
+        terminate();
+        delete mWriterThread;
+        free(mChunk);
+    }
+
+    void setFileName(const std::string &fileName) {
+        mFileName = fileName;
+    }
+
+    const std::string &getFileName() const {
+        return mFileName;
+    }
+
+    int32_t open(int32_t sampleRate, int32_t samplesPerFrame,
+            int32_t framesPerBurst) override {
+        int32_t result = VirtualAudioSink::open(sampleRate, samplesPerFrame, framesPerBurst);
+        if (result < 0) {
+            return result;
+        }
+        mRing.setup(kFileRingCapacityInBursts * samplesPerFrame * framesPerBurst);
+        if (mChunk == nullptr) {
+            if (posix_memalign((void **) &mChunk, kFileChunkAlignment,
+                               kFileChunkSizeInBytes) != 0) {
+                mChunk = nullptr;
+                return -1;
+            }
+        }
+        mChunkFill = 0;
+        return result;
+    }
+
+    virtual int32_t start() override {
+        if (mFileDescriptor < 0) {
+            int32_t result = openFile();
+            if (result < 0) {
+                return result;
+            }
+        }
+        mRing.reset();
+        // A HostThread cannot be restarted so use a new one for each measurement.
+        // It is not promoted so it runs below the SCHED_FIFO render thread.
+        delete mWriterThread;
+        mWriterThread = new HostThread();
+        mWriterEnabled.store(true);
+        int err = mWriterThread->start(writerProcWrapper, this);
+        if (err != 0) {
+            mWriterEnabled.store(false);
+            if (mLogTool) {
+                mLogTool->log("ERROR in FileAudioSink, writer start() failed, %d\n", err);
+            }
+            return SYNTHMARK_RESULT_THREAD_FAILURE;
+        }
+        int32_t result = VirtualAudioSink::start();
+        if (result < 0) {
+            stop();
+        }
+        return result;
+    }
+
+    /**
+     * Stop the writer thread after it has saved everything in the ring.
+     */
+    virtual int32_t stop() override {
+        if (mWriterEnabled.exchange(false)) {
+            mWriterThread->join();
+        }
+        return VirtualAudioSink::stop();
+    }
+
+    /**
+     * Write the WAV header and close the file.
+     */
+    virtual int32_t terminate() override {
+        stop();
+        if (mFileDescriptor < 0) {
+            return 0;
+        }
+        int32_t result = 0;
+        if (mIsWav && writeWavHeader() < 0) {
+            result = SYNTHMARK_RESULT_AUDIO_SINK_WRITE_FAILURE;
+        }
+        ::close(mFileDescriptor);
+        mFileDescriptor = -1;
+        return result;
+    }
+
+    virtual void writeBurst(const float *buffer, int32_t numFrames) override {
+        if (!mRing.write(buffer, numFrames * mSamplesPerFrame)) {
+            mFileUnderrunCount++; // the writer thread fell behind
+        }
+        VirtualAudioSink::writeBurst(buffer, numFrames);
+    }
+
+    int32_t getFileUnderrunCount() const {
+        return mFileUnderrunCount;
+    }
+
+    int64_t getBytesWritten() const {
+        return mBytesWritten;
+    }
+
+    int32_t getWriteErrorCount() const {
+        return mWriteErrorCount;
+    }
+
+private:
+
+    int32_t openFile() {
+        if (mFileName.empty()) {
+            return SYNTHMARK_RESULT_AUDIO_SINK_START_FAILURE;
+        }
+        mFileDescriptor = ::open(mFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (mFileDescriptor < 0) {
+            if (mLogTool) {
+                mLogTool->log("ERROR in FileAudioSink, cannot open %s\n", mFileName.c_str());
+            }
+            return SYNTHMARK_RESULT_AUDIO_SINK_START_FAILURE;
+        }
+        const std::string suffix = ".wav";
+        mIsWav = mFileName.size() >= suffix.size()
+                && mFileName.compare(mFileName.size() - suffix.size(),
+                                     suffix.size(), suffix) == 0;
+        mFileChannels = mSamplesPerFrame;
+        mFileSampleRate = mSampleRate;
+        mBytesWritten = 0;
+        // Leave room for the header, which is written when the size is known.
+        if (mIsWav && lseek(mFileDescriptor, kWavHeaderSize, SEEK_SET) < 0) {
+            ::close(mFileDescriptor);
+            mFileDescriptor = -1;
+            return SYNTHMARK_RESULT_AUDIO_SINK_START_FAILURE;
+        }
+        return 0;
+    }
+
+    void flushChunk() {
+        int32_t numBytes = mChunkFill * (int32_t) sizeof(float);
+        const char *data = (const char *) mChunk;
+        while (numBytes > 0) {
+            ssize_t written = ::write(mFileDescriptor, data, numBytes);
+            if (written <= 0) {
+                mWriteErrorCount++;
+                break;
+            }
+            data += written;
+            numBytes -= (int32_t) written;
+            mBytesWritten += written;
+        }
+        mChunkFill = 0;
+    }
+
+    void writerLoop() {
+        const int32_t chunkCapacity = kFileChunkSizeInBytes / (int32_t) sizeof(float);
+        bool enabled = true;
+        while (enabled) {
+            // Read the flag before draining so nothing is left behind when we exit.
+            enabled = mWriterEnabled.load();
+            int32_t numRead;
+            do {
+                numRead = mRing.read(mChunk + mChunkFill, chunkCapacity - mChunkFill);
+                mChunkFill += numRead;
+                if (mChunkFill == chunkCapacity) {
+                    flushChunk();
+                }
+            } while (numRead > 0);
+            if (enabled) {
+                HostTools::sleepForNanoseconds(kFileWriterPollNanos);
+            }
+        }
+        flushChunk();
+    }
+
+    static void * writerProcWrapper(void *arg) {
+        FileAudioSink *sink = (FileAudioSink *) arg;
+        sink->writerLoop();
+        return NULL;
+    }
+
+    static void putLittleEndian(uint8_t *address, uint32_t value, int numBytes) {
+        for (int i = 0; i < numBytes; i++) {
+            address[i] = (uint8_t) (value >> (8 * i));
+        }
+    }
+
+    int32_t writeWavHeader() {
+        const int kBytesPerSample = (int) sizeof(float);
+        const int kWaveFormatIeeeFloat = 3;
+        uint32_t dataSize = (uint32_t) mBytesWritten;
+        uint8_t header[kWavHeaderSize];
+        memcpy(&header[0], "RIFF", 4);
+        putLittleEndian(&header[4], 36 + dataSize, 4);
+        memcpy(&header[8], "WAVE", 4);
+        memcpy(&header[12], "fmt ", 4);
+        putLittleEndian(&header[16], 16, 4);
+        putLittleEndian(&header[20], kWaveFormatIeeeFloat, 2);
+        putLittleEndian(&header[22], mFileChannels, 2);
+        putLittleEndian(&header[24], mFileSampleRate, 4);
+        putLittleEndian(&header[28], mFileSampleRate * mFileChannels * kBytesPerSample, 4);
+        putLittleEndian(&header[32], mFileChannels * kBytesPerSample, 2);
+        putLittleEndian(&header[34], 8 * kBytesPerSample, 2);
+        memcpy(&header[36], "data", 4);
+        putLittleEndian(&header[40], dataSize, 4);
+        return (pwrite(mFileDescriptor, header, sizeof(header), 0) == sizeof(header)) ? 0 : -1;
+    }
+
+    LogTool          *mLogTool = NULL;
+    std::string       mFileName;
+    int               mFileDescriptor = -1;
+    bool              mIsWav = false;
+    int32_t           mFileChannels = 0;
+    int32_t           mFileSampleRate = 0;
+    int64_t           mBytesWritten = 0;
+    int32_t           mWriteErrorCount = 0;
+    int32_t           mFileUnderrunCount = 0;
+
+    SpscRingBuffer    mRing;
+    HostThread       *mWriterThread = NULL;
+    std::atomic<bool> mWriterEnabled{false};
+    float            *mChunk = nullptr;   // written only by the writer thread
+    int32_t           mChunkFill = 0;
+};
+
+#endif // SYNTHMARK_FILE_AUDIO_SINK_H
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_FLIGHT_RECORDER_H
+#define SYNTHMARK_FLIGHT_RECORDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+
+/**
+ * Binary dump of the most recent bursts of the render thread.
+ *
+ * The file starts with a FlightRecorderHeader followed by numRecords
+ * FlightRecords, oldest first, all in the byte order of the host.
+ * Convert it for chrome://tracing or Perfetto with
+ * scripts/flight_recorder/flight_recorder_to_json.py.
+ *
+ * Writing a file would stall the render thread, so nothing is saved at the
+ * glitch itself. The ring freezes a few bursts after the first glitch and
+ * the harness saves it when the run ends.
+ */
+constexpr char     kFlightRecorderMagic[4] = {'S', 'M', 'F', 'R'};
+constexpr uint32_t kFlightRecorderVersion = 1;
+
+// Must be a power of two. Over half a second at 4 frames per burst and 48000 Hz.
+constexpr int32_t kFlightRecorderCapacity = 8 * 1024;
+
+// Bursts still recorded after the first glitch before the recorder freezes.
+constexpr int32_t kFlightRecorderTailBursts = kFlightRecorderCapacity / 8;
+
+// Bits in FlightRecord::flags
+constexpr uint16_t kFlightRecordUnderrun = 1 << 0; // the sink underran before this burst
+
+struct FlightRecorderHeader {
+    char     magic[4];
+    uint32_t version;
+    int32_t  sampleRate;
+    int32_t  framesPerBurst;
+    int32_t  numRecords;
+    int32_t  glitchIndex; // first record with an underrun, or -1
+};
+
+struct FlightRecord {
+    int64_t  idealNanos;       // when the callback should have started, 0 if unknown
+    int64_t  entryNanos;       // when the render started
+    int64_t  exitNanos;        // when the render finished
+    int64_t  sleepTargetNanos; // wakeup time requested before this burst, 0 if no sleep
+    int32_t  cpu;
+    int16_t  numVoices;
+    uint16_t flags;
+};
+
+static_assert(sizeof(FlightRecorderHeader) == 24, "flight header must be 24 bytes");
+static_assert(sizeof(FlightRecord) == 40, "flight record must be 40 bytes");
+
+/**
+ * Keep the last kFlightRecorderCapacity bursts in a ring.
+ *
+ * Only the render thread calls record(). It never blocks or allocates,
+ * so another thread may take a snapshot() at any time.
+ */
+class FlightRecorder {
+public:
+    FlightRecorder()
+            : mRecords(kFlightRecorderCapacity) {
+    }
+
+    void reset() {
+        mWriteCount.store(0);
+        mGlitchCount.store(-1);
+        mTailCountdown = -1;
+    }
+
+    void record(const FlightRecord &record) {
+        if (mTailCountdown == 0) {
+            return; // frozen so the history before the glitch is kept
+        }
+        int64_t count = mWriteCount.load(std::memory_order_relaxed);
+        mRecords[count & kIndexMask] = record;
+        mWriteCount.store(count + 1, std::memory_order_release);
+        if (mTailCountdown > 0) {
+            mTailCountdown--;
+        } else if ((record.flags & kFlightRecordUnderrun) && !hasGlitch()) {
+            mGlitchCount.store(count, std::memory_order_relaxed);
+            mTailCountdown = kFlightRecorderTailBursts;
+        }
+    }
+
+    /**
+     * Copy the records still in the ring, oldest first.
+     * @return index of the first glitch in the copy, or -1
+     */
+    int32_t snapshot(std::vector<FlightRecord> &records) const {
+        int64_t end = mWriteCount.load(std::memory_order_acquire);
+        int64_t begin = std::max((int64_t) 0, end - kFlightRecorderCapacity);
+        records.clear();
+        for (int64_t i = begin; i < end; i++) {
+            records.push_back(mRecords[i & kIndexMask]);
+        }
+        // Drop any records the render thread overwrote while we copied.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        int64_t overwritten = mWriteCount.load(std::memory_order_relaxed)
+                - kFlightRecorderCapacity - begin;
+        if (overwritten > 0) {
+            overwritten = std::min(overwritten, (int64_t) records.size());
+            records.erase(records.begin(), records.begin() + overwritten);
+            begin += overwritten;
+        }
+        int64_t glitchCount = mGlitchCount.load(std::memory_order_relaxed);
+        return (glitchCount >= begin && glitchCount < end) ? (int32_t) (glitchCount - begin) : -1;
+    }
+
+    /**
+     * Write a snapshot to a binary file.
+     * @return number of records written or a negative error
+     */
+    int32_t save(const std::string &fileName, int32_t sampleRate, int32_t framesPerBurst) const {
+        std::vector<FlightRecord> records;
+        FlightRecorderHeader header;
+        std::copy(kFlightRecorderMagic, kFlightRecorderMagic + 4, header.magic);
+        header.version = kFlightRecorderVersion;
+        header.sampleRate = sampleRate;
+        header.framesPerBurst = framesPerBurst;
+        header.glitchIndex = snapshot(records);
+        header.numRecords = (int32_t) records.size();
+
+        FILE *file = fopen(fileName.c_str(), "wb");
+        if (file == nullptr) {
+            return SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+        }
+        bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+        if (ok && !records.empty()) {
+            ok = (fwrite(records.data(), sizeof(FlightRecord), records.size(), file)
+                    == records.size());
+        }
+        fclose(file);
+        return ok ? header.numRecords : SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+    }
+
+    bool hasGlitch() const {
+        return mGlitchCount.load(std::memory_order_relaxed) >= 0;
+    }
+
+private:
+    static constexpr int64_t kIndexMask = kFlightRecorderCapacity - 1;
+
+    std::vector<FlightRecord> mRecords;
+    std::atomic<int64_t>      mWriteCount{0};
+    std::atomic<int64_t>      mGlitchCount{-1};
+    int32_t                   mTailCountdown = -1; // 0 when frozen
+};
+
+#endif // SYNTHMARK_FLIGHT_RECORDER_H
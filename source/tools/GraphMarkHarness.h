@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_GRAPH_MARK_HARNESS_H
+#define SYNTHMARK_GRAPH_MARK_HARNESS_H
+
+#include <cstdint>
+#include <sstream>
+
+#include "AudioSinkBase.h"
+#include "BinCounter.h"
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "synth/AudioGraph.h"
+#include "tools/GraphScheduler.h"
+#include "tools/LogTool.h"
+#include "tools/TestHarnessBase.h"
+#include "TestHarnessParameters.h"
+
+constexpr int32_t kGraphMaxSize = 256;
+constexpr int32_t kDefaultGraphSize = 16;
+constexpr int32_t kGraphNanosPerBin = 10 * SYNTHMARK_NANOS_PER_MICROSECOND;
+constexpr int32_t kGraphNumBins = 10000; // 100 msec
+
+/**
+ * Generated graph topologies.
+ */
+enum class GraphShape {
+    Wide,    // many voices into one bus, a short critical path
+    Deep,    // one voice through a long chain of effects, mostly serial
+    Diamond, // one voice split into parallel effects and then merged
+};
+
+inline const char *graphShapeToString(GraphShape shape) {
+    switch (shape) {
+        case GraphShape::Wide: return "wide";
+        case GraphShape::Deep: return "deep";
+        case GraphShape::Diamond: return "diamond";
+    }
+    return "unknown";
+}
+
+/**
+ * Render a routing graph of voices, buses and effects for each burst.
+ * The nodes are scheduled across the callback thread and a pool of workers
+ * as soon as their inputs are ready. Compare the total work with the
+ * critical path to see how much the shape of the graph limits the speedup.
+ */
+class GraphMarkHarness : public TestHarnessBase {
+public:
+    GraphMarkHarness(AudioSinkBase *audioSink,
+                     SynthMarkResult *result,
+                     LogTool *logTool = NULL)
+            : TestHarnessBase(audioSink, result, logTool)
+            , mBurstBins(kGraphNumBins)
+    {
+        mTestName = "GraphMark";
+    }
+
+    virtual ~GraphMarkHarness() {
+    }
+
+    /**
+     * @param size number of voices for Wide, effects for Deep, or branches for Diamond
+     */
+    void setShape(GraphShape shape, int32_t size) {
+        mShape = shape;
+        mSize = size;
+    }
+
+    /**
+     * @param numThreads threads that render, including the callback thread
+     */
+    void setNumThreads(int32_t numThreads) {
+        mNumThreads = numThreads;
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        int32_t err = open(sampleRate, mChannelCount,
+                           kSynthmarkFramesPerRender, framesPerBurst);
+        if (err) {
+            return err;
+        }
+        err = mScheduler.start(&mGraph, mNumThreads);
+        if (err == 0) {
+            err = measure(numSeconds);
+        }
+        mScheduler.stop();
+        close();
+        return err;
+    };
+
+    int32_t open(int32_t sampleRate,
+                 int32_t samplesPerFrame,
+                 int32_t framesPerRender,
+                 int32_t framesPerBurst) override {
+        if (samplesPerFrame != SAMPLES_PER_FRAME) {
+            mLogTool->log("ERROR in open, GraphMark needs %d channels, not %d\n",
+                          SAMPLES_PER_FRAME, samplesPerFrame);
+            return -1;
+        }
+        if (mSize < 1 || mSize > kGraphMaxSize) {
+            mLogTool->log("ERROR in open, graph size = %d not in [1, %d]\n",
+                          mSize, kGraphMaxSize);
+            return -1;
+        }
+        int32_t err = TestHarnessBase::open(sampleRate, samplesPerFrame,
+                                            framesPerRender, framesPerBurst);
+        if (err < 0) {
+            return err;
+        }
+        err = buildGraph(sampleRate);
+        if (err < 0) {
+            return err;
+        }
+        // Callbacks may be up to two bursts when the sizes are random.
+        err = mGraph.compile(2 * framesPerBurst);
+        if (err < 0) {
+            mLogTool->log("ERROR in open, could not compile the graph\n");
+        }
+        return err;
+    }
+
+    virtual void onBeginMeasurement() override {
+        mResult->setTestName(mTestName);
+        mLogTool->log("---- Starting %s, %s graph of %d nodes on %d threads ----\n",
+                      mTestName.c_str(), graphShapeToString(mShape),
+                      mGraph.getNodeCount(), mNumThreads);
+        mGraph.resetTiming();
+        mScheduler.resetStallCount();
+        mTotalBurstNanos = 0;
+        mMaxBurstNanos = 0;
+    }
+
+    virtual void onEndMeasurement() override {
+        int32_t count = (mRenderCount > 0) ? mRenderCount : 1;
+        double workMicros = (double) mGraph.getTotalWorkNanos()
+                            / (count * SYNTHMARK_NANOS_PER_MICROSECOND);
+        double criticalMicros = (double) mGraph.getCriticalPathNanos()
+                                / (count * SYNTHMARK_NANOS_PER_MICROSECOND);
+        double burstMicros = (double) mTotalBurstNanos / (count * SYNTHMARK_NANOS_PER_MICROSECOND);
+        double parallelism = (criticalMicros > 0.0) ? (workMicros / criticalMicros) : 0.0;
+        double speedup = (burstMicros > 0.0) ? (workMicros / burstMicros) : 0.0;
+        int32_t p99Bin = mBurstBins.getPercentileBin(0.99);
+        double p99Micros = (p99Bin < 0) ? 0.0
+                : (double) (p99Bin + 1) * kGraphNanosPerBin / SYNTHMARK_NANOS_PER_MICROSECOND;
+
+        std::stringstream resultMessage;
+        resultMessage << "graph.shape = " << graphShapeToString(mShape) << std::endl;
+        resultMessage << "graph.nodes = " << mGraph.getNodeCount() << std::endl;
+        resultMessage << "graph.edges = " << mGraph.getEdgeCount() << std::endl;
+        resultMessage << "graph.depth = " << mGraph.getDepth() << std::endl;
+        resultMessage << "graph.buffers = " << mGraph.getBufferCount() << std::endl;
+        resultMessage << "graph.threads = " << mNumThreads << std::endl;
+        resultMessage << "work.usec.per.burst = " << workMicros << std::endl;
+        resultMessage << "critical.path.usec.per.burst = " << criticalMicros << std::endl;
+        resultMessage << "parallelism = " << parallelism << std::endl;
+        resultMessage << "burst.mean.usec = " << burstMicros << std::endl;
+        resultMessage << "burst.p99.usec = " << p99Micros << std::endl;
+        resultMessage << "burst.max.usec = "
+                      << ((double) mMaxBurstNanos / SYNTHMARK_NANOS_PER_MICROSECOND) << std::endl;
+        resultMessage << "ready.queue.stalls = " << mScheduler.getStallCount() << std::endl;
+        resultMessage << "underrun.count = " << mAudioSink->getUnderrunCount() << std::endl;
+        resultMessage << mTestName << " = " << speedup << std::endl;
+
+        mResult->setMeasurement(speedup);
+        mResult->setResultCode(SYNTHMARK_RESULT_SUCCESS);
+        mResult->appendMessage(resultMessage.str());
+    }
+
+    int32_t applyNotes(int32_t numVoices) override {
+        if (numVoices == 0) {
+            mGraph.allNotesOff();
+            return 0;
+        }
+        return mGraph.notesOn(numVoices);
+    }
+
+    void renderVoices(float *buffer, int32_t numFrames) override {
+        int64_t startNanos = HostTools::getNanoTime();
+        mScheduler.process(numFrames);
+        mGraph.readOutput(buffer, numFrames);
+        int64_t burstNanos = HostTools::getNanoTime() - startNanos;
+        mBurstBins.increment((int32_t) (burstNanos / kGraphNanosPerBin));
+        mTotalBurstNanos += burstNanos;
+        if (burstNanos > mMaxBurstNanos) {
+            mMaxBurstNanos = burstNanos;
+        }
+    }
+
+private:
+
+    int32_t addVoice(int32_t sampleRate) {
+        VoiceNode *voice = new VoiceNode();
+        int32_t index = mGraph.addNode(voice);
+        return voice->setup(sampleRate, getNumVoices(), mSampleType, mOversampling) < 0
+               ? -1 : index;
+    }
+
+    int32_t addEffect(int32_t sampleRate) {
+        EffectNode *effect = new EffectNode();
+        effect->setup(sampleRate);
+        return mGraph.addNode(effect);
+    }
+
+    int32_t buildGraph(int32_t sampleRate) {
+        mGraph.clear();
+        int32_t output = -1;
+        switch (mShape) {
+            case GraphShape::Wide: {
+                output = mGraph.addNode(new BusNode(1.0f / mSize));
+                for (int32_t i = 0; i < mSize; i++) {
+                    int32_t voice = addVoice(sampleRate);
+                    if (voice < 0) {
+                        return -1;
+                    }
+                    mGraph.connect(voice, output);
+                }
+                break;
+            }
+            case GraphShape::Deep: {
+                output = addVoice(sampleRate);
+                if (output < 0) {
+                    return -1;
+                }
+                for (int32_t i = 0; i < mSize; i++) {
+                    int32_t effect = addEffect(sampleRate);
+                    mGraph.connect(output, effect);
+                    output = effect;
+                }
+                break;
+            }
+            case GraphShape::Diamond: {
+                int32_t voice = addVoice(sampleRate);
+                if (voice < 0) {
+                    return -1;
+                }
+                int32_t merge = mGraph.addNode(new BusNode(1.0f / mSize));
+                for (int32_t i = 0; i < mSize; i++) {
+                    int32_t effect = addEffect(sampleRate);
+                    mGraph.connect(voice, effect);
+                    mGraph.connect(effect, merge);
+                }
+                output = addEffect(sampleRate);
+                mGraph.connect(merge, output);
+                break;
+            }
+        }
+        mGraph.setOutputNode(output);
+        return 0;
+    }
+
+    AudioGraph      mGraph;
+    GraphScheduler  mScheduler;
+    BinCounter      mBurstBins;
+    GraphShape      mShape = GraphShape::Wide;
+    int32_t         mSize = kDefaultGraphSize;
+    int32_t         mNumThreads = 1;
+    int64_t         mTotalBurstNanos = 0;
+    int64_t         mMaxBurstNanos = 0;
+};
+
+#endif // SYNTHMARK_GRAPH_MARK_HARNESS_H
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_GRAPH_SCHEDULER_H
+#define SYNTHMARK_GRAPH_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sched.h>
+#include <vector>
+
+#include "SynthMark.h"
+#include "synth/AudioGraph.h"
+#include "tools/RenderThreadPool.h"
+
+/**
+ * Process a compiled AudioGraph each burst on the calling thread plus a pool of workers.
+ *
+ * Each node has an atomic count of the inputs that are not finished yet.
+ * When a thread finishes a node it decrements the counts of the nodes it feeds.
+ * Any node whose count reaches zero is pushed onto a shared ready queue.
+ * Each node is pushed exactly once per burst, so the queue is a plain array
+ * with atomic head and tail indices and it never needs a lock.
+ */
+class GraphScheduler
+{
+public:
+    GraphScheduler() {}
+
+    ~GraphScheduler() {
+        stop();
+    }
+
+    /**
+     * @param numThreads threads that process nodes, including the caller of process()
+     */
+    int32_t start(AudioGraph *graph, int32_t numThreads) {
+        if (numThreads < 1) {
+            return -1;
+        }
+        mGraph = graph;
+        mNumThreads = numThreads;
+        int32_t numNodes = graph->getNodeCount();
+        mPending.reset(new std::atomic<int32_t>[numNodes]);
+        mReady.reset(new std::atomic<int32_t>[numNodes]);
+        mInputCounts.clear();
+        mSources.clear();
+        for (int32_t i = 0; i < numNodes; i++) {
+            int32_t numInputs = (int32_t) graph->getInputs(i).size();
+            mInputCounts.push_back(numInputs);
+            if (numInputs == 0) {
+                mSources.push_back(i);
+            }
+        }
+        return mPool.start(numThreads - 1, [this](int32_t taskIndex) {
+            drainReadyQueue();
+        });
+    }
+
+    void stop() {
+        mPool.stop();
+    }
+
+    /**
+     * Process every node in the graph. Called from the audio callback.
+     */
+    void process(int32_t numFrames) {
+        int32_t numNodes = (int32_t) mInputCounts.size();
+        mNumFrames = numFrames;
+        for (int32_t i = 0; i < numNodes; i++) {
+            mPending[i].store(mInputCounts[i], std::memory_order_relaxed);
+            mReady[i].store(kEmptySlot, std::memory_order_relaxed);
+        }
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(0, std::memory_order_relaxed);
+        mNodesRemaining.store(numNodes, std::memory_order_relaxed);
+        for (int32_t source : mSources) {
+            push(source);
+        }
+        // One task per thread. Each one drains the queue until the graph is done.
+        mPool.run(mNumThreads);
+    }
+
+    /**
+     * @return times a thread found the ready queue empty while nodes were still running
+     */
+    int64_t getStallCount() const {
+        return mStallCount.load();
+    }
+
+    void resetStallCount() {
+        mStallCount.store(0);
+    }
+
+private:
+    static constexpr int32_t kEmptySlot = -1;
+
+    void push(int32_t nodeIndex) {
+        int32_t slot = mTail.fetch_add(1, std::memory_order_acq_rel);
+        mReady[slot].store(nodeIndex, std::memory_order_release);
+    }
+
+    /**
+     * @return the next ready node or -1 if the queue is empty
+     */
+    int32_t pop() {
+        int32_t head = mHead.load(std::memory_order_acquire);
+        while (head < mTail.load(std::memory_order_acquire)) {
+            if (mHead.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel)) {
+                // The pusher may not have stored the node yet.
+                int32_t nodeIndex;
+                while ((nodeIndex = mReady[head].load(std::memory_order_acquire)) == kEmptySlot) {
+                }
+                return nodeIndex;
+            }
+        }
+        return -1;
+    }
+
+    void drainReadyQueue() {
+        while (mNodesRemaining.load(std::memory_order_acquire) > 0) {
+            int32_t nodeIndex = pop();
+            if (nodeIndex < 0) {
+                // Wait for another thread to finish a node that feeds the rest.
+                mStallCount++;
+                sched_yield();
+                continue;
+            }
+            mGraph->processNode(nodeIndex, mNumFrames);
+            for (int32_t next : mGraph->getOutputs(nodeIndex)) {
+                if (mPending[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    push(next);
+                }
+            }
+            mNodesRemaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    AudioGraph                              *mGraph = nullptr;
+    RenderThreadPool                         mPool;
+    int32_t                                  mNumThreads = 1;
+    int32_t                                  mNumFrames = 0;
+    std::vector<int32_t>                     mInputCounts;
+    std::vector<int32_t>                     mSources;
+    std::unique_ptr<std::atomic<int32_t>[]>  mPending;
+    std::unique_ptr<std::atomic<int32_t>[]>  mReady;
+    std::atomic<int32_t>                     mHead{0};
+    std::atomic<int32_t>                     mTail{0};
+    std::atomic<int32_t>                     mNodesRemaining{0};
+    std::atomic<int64_t>                     mStallCount{0};
+};
+
+#endif // SYNTHMARK_GRAPH_SCHEDULER_H
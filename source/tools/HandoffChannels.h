@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_HANDOFF_CHANNELS_H
+#define SYNTHMARK_HANDOFF_CHANNELS_H
+
+#include <cstdint>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if !defined(__APPLE__)
+#include <semaphore.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "SyncPrimitives.h"
+
+/**
+ * Ways for one thread to wake another.
+ * Each channel has post() and wait(). A post is never lost, but the signal
+ * channel can merge two posts into one wakeup, so callers should alternate.
+ * Call prepareHandoffWaiter() on the waiting thread before the first post.
+ */
+
+/**
+ * Mutex and condition variable.
+ */
+class CondVarChannel : public CondVarSemaphore
+{
+public:
+    bool isValid() const {
+        return true;
+    }
+};
+
+/**
+ * Sleep in the kernel on a futex right away.
+ */
+class FutexChannel : public HostSemaphore
+{
+public:
+    FutexChannel() : HostSemaphore(SyncStrategy::Futex) {}
+
+    bool isValid() const {
+        return true;
+    }
+};
+
+/**
+ * Write a counter to an eventfd and read it back.
+ */
+class EventFdChannel
+{
+public:
+    EventFdChannel() {
+#if !defined(__APPLE__)
+        mFd = eventfd(0, EFD_CLOEXEC | EFD_SEMAPHORE);
+#endif
+    }
+
+    ~EventFdChannel() {
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+
+    bool isValid() const {
+        return mFd >= 0;
+    }
+
+    void post() {
+        uint64_t value = 1;
+        ssize_t numWritten = write(mFd, &value, sizeof(value));
+        (void) numWritten;
+    }
+
+    void wait() {
+        uint64_t value;
+        while (read(mFd, &value, sizeof(value)) != sizeof(value)) {
+            // interrupted by a signal
+        }
+    }
+
+private:
+    int mFd = -1;
+};
+
+/**
+ * Write one byte into a pipe and read it back.
+ */
+class PipeChannel
+{
+public:
+    PipeChannel() {
+        if (pipe(mFds) != 0) {
+            mFds[0] = mFds[1] = -1;
+        }
+    }
+
+    ~PipeChannel() {
+        if (mFds[0] >= 0) {
+            close(mFds[0]);
+            close(mFds[1]);
+        }
+    }
+
+    bool isValid() const {
+        return mFds[0] >= 0;
+    }
+
+    void post() {
+        char token = 0;
+        ssize_t numWritten = write(mFds[1], &token, 1);
+        (void) numWritten;
+    }
+
+    void wait() {
+        char token;
+        while (read(mFds[0], &token, 1) != 1) {
+            // interrupted by a signal
+        }
+    }
+
+private:
+    int mFds[2];
+};
+
+/**
+ * Unnamed POSIX semaphore. Not available on Apple hosts.
+ */
+class PosixSemaphoreChannel
+{
+public:
+    PosixSemaphoreChannel() {
+#if !defined(__APPLE__)
+        mValid = (sem_init(&mSemaphore, 0, 0) == 0);
+#endif
+    }
+
+    ~PosixSemaphoreChannel() {
+#if !defined(__APPLE__)
+        if (mValid) {
+            sem_destroy(&mSemaphore);
+        }
+#endif
+    }
+
+    bool isValid() const {
+        return mValid;
+    }
+
+    void post() {
+#if !defined(__APPLE__)
+        sem_post(&mSemaphore);
+#endif
+    }
+
+    void wait() {
+#if !defined(__APPLE__)
+        while (sem_wait(&mSemaphore) != 0) {
+            // interrupted by a signal
+        }
+#endif
+    }
+
+private:
+#if !defined(__APPLE__)
+    sem_t mSemaphore;
+#endif
+    bool  mValid = false;
+};
+
+/**
+ * Send SIGUSR1 to the waiting thread, which blocks it and calls sigwait().
+ */
+class SignalChannel
+{
+public:
+    bool isValid() const {
+        return true;
+    }
+
+    /**
+     * Called on the waiting thread so the signal stays pending for sigwait().
+     */
+    void prepareWaiter() {
+        sigemptyset(&mSignals);
+        sigaddset(&mSignals, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &mSignals, NULL);
+        mWaiter = pthread_self();
+    }
+
+    void post() {
+        pthread_kill(mWaiter, SIGUSR1);
+    }
+
+    void wait() {
+        int signal = 0;
+        sigwait(&mSignals, &signal);
+    }
+
+private:
+    sigset_t  mSignals;
+    pthread_t mWaiter;
+};
+
+/**
+ * Poll an atomic counter, yielding now and then so that a thread on the same CPU can run.
+ */
+class BusyPollChannel : public HostSemaphore
+{
+public:
+    BusyPollChannel() : HostSemaphore(SyncStrategy::Spin) {}
+
+    bool isValid() const {
+        return true;
+    }
+};
+
+/**
+ * Most channels need no preparation.
+ */
+template <typename Channel>
+inline void prepareHandoffWaiter(Channel &channel) {}
+
+inline void prepareHandoffWaiter(SignalChannel &channel) {
+    channel.prepareWaiter();
+}
+
+#endif // SYNTHMARK_HANDOFF_CHANNELS_H
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_HANDOFF_PING_PONG_H
+#define SYNTHMARK_HANDOFF_PING_PONG_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "BinCounter.h"
+#include "HandoffChannels.h"
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+#include "SyncPrimitives.h"
+
+constexpr int32_t kHandoffNanosPerBin = SYNTHMARK_NANOS_PER_MICROSECOND;
+constexpr int32_t kHandoffNumBins = 10000; // 10 msec
+constexpr int32_t kHandoffMinIterations = 100;
+constexpr int32_t kHandoffMaxIterations = 100000;
+// Longer than the spin budget so that SpinThenFutex has to sleep.
+constexpr int64_t kHandoffGapNanos = 200 * SYNTHMARK_NANOS_PER_MICROSECOND;
+
+/**
+ * @return iterations for each measurement so that all of them take about numSeconds
+ */
+inline int32_t calculateHandoffIterations(int32_t numSeconds, int32_t numMeasurements) {
+    int64_t iterations = (numSeconds * SYNTHMARK_NANOS_PER_SECOND)
+                         / (2 * kHandoffGapNanos * std::max(numMeasurements, 1));
+    return (int32_t) std::max((int64_t) kHandoffMinIterations,
+                              std::min(iterations, (int64_t) kHandoffMaxIterations));
+}
+
+/**
+ * Pass a token back and forth between a leader and a follower thread
+ * and measure how long each wakeup takes.
+ *
+ * Fan-out is the time from the leader posting until the follower runs.
+ * Fan-in is the time from the follower posting until the leader runs.
+ * Each thread is idle for a while before every wakeup, like a worker between bursts.
+ *
+ * The channel needs post() and wait(). See HandoffChannels.h.
+ */
+template <typename Channel>
+class HandoffPingPong {
+public:
+    /**
+     * @param leaderCpu CPU for the leader or SYNTHMARK_CPU_UNSPECIFIED
+     * @param useFifo try to run both threads with SCHED_FIFO
+     */
+    HandoffPingPong(int32_t iterations, int leaderCpu, int followerCpu, bool useFifo = true)
+            : mFanOutBins(kHandoffNumBins)
+            , mFanInBins(kHandoffNumBins)
+            , mIterations(iterations)
+            , mLeaderCpu(leaderCpu)
+            , mFollowerCpu(followerCpu)
+            , mUseFifo(useFifo) {}
+
+    Channel toFollower;
+    Channel toLeader;
+
+    int32_t run() {
+        HostThread leader;
+        HostThread follower;
+        mLeaderThread = &leader;
+        mFollowerThread = &follower;
+        if (follower.start(followerProc, this) != 0) {
+            return SYNTHMARK_RESULT_THREAD_FAILURE;
+        }
+        int32_t err = SYNTHMARK_RESULT_SUCCESS;
+        if (leader.start(leaderProc, this) != 0) {
+            err = SYNTHMARK_RESULT_THREAD_FAILURE;
+            // Take the place of the leader so the follower can finish.
+            prepareHandoffWaiter(toLeader);
+            mStartBarrier.arriveAndWait();
+            for (int32_t i = 0; i < mIterations; i++) {
+                toFollower.post();
+                toLeader.wait();
+            }
+        }
+        leader.join();
+        follower.join();
+        return err;
+    }
+
+    /**
+     * @return true if both threads were running with SCHED_FIFO
+     */
+    bool wasFifoUsed() const {
+        return mLeaderFifo && mFollowerFifo;
+    }
+
+    double getFanOutMicros(double fraction) const {
+        return binToMicros(mFanOutBins.getPercentileBin(fraction));
+    }
+
+    double getFanInMicros(double fraction) const {
+        return binToMicros(mFanInBins.getPercentileBin(fraction));
+    }
+
+    /**
+     * Append the latency percentiles and CPU load, each key starting with prefix.
+     */
+    void report(const std::string &prefix, std::stringstream &resultMessage) const {
+        resultMessage << prefix << "fanout.p50.usec = " << getFanOutMicros(0.50) << std::endl;
+        resultMessage << prefix << "fanout.p99.usec = " << getFanOutMicros(0.99) << std::endl;
+        resultMessage << prefix << "fanout.max.usec = "
+                      << ((double) mMaxFanOutNanos / SYNTHMARK_NANOS_PER_MICROSECOND)
+                      << std::endl;
+        resultMessage << prefix << "fanin.p50.usec = " << getFanInMicros(0.50) << std::endl;
+        resultMessage << prefix << "fanin.p99.usec = " << getFanInMicros(0.99) << std::endl;
+        resultMessage << prefix << "fanin.max.usec = "
+                      << ((double) mMaxFanInNanos / SYNTHMARK_NANOS_PER_MICROSECOND)
+                      << std::endl;
+        // Spinning shows up as CPU time spent waiting.
+        int64_t wallNanos = mLeaderWallNanos + mFollowerWallNanos;
+        double cpuPercent = (wallNanos > 0)
+                ? (100.0 * (mLeaderCpuNanos + mFollowerCpuNanos) / wallNanos) : 0.0;
+        resultMessage << prefix << "cpu.percent = " << cpuPercent << std::endl;
+    }
+
+private:
+    static double binToMicros(int32_t bin) {
+        // Report the upper edge of the bin.
+        return (bin < 0) ? 0.0
+                : (double) (bin + 1) * kHandoffNanosPerBin / SYNTHMARK_NANOS_PER_MICROSECOND;
+    }
+
+    /**
+     * @return true if the thread is running with SCHED_FIFO
+     */
+    bool prepareThread(HostThread *thread, int cpu) {
+        bool fifo = false;
+        if (mUseFifo) {
+            // This may fail if we are not root.
+            fifo = (thread->promote(SYNTHMARK_THREAD_PRIORITY_DEFAULT) == 0);
+        }
+        if (cpu != SYNTHMARK_CPU_UNSPECIFIED) {
+            thread->setCpuAffinity(cpu);
+        }
+        return fifo;
+    }
+
+    void leaderLoop() {
+        mLeaderFifo = prepareThread(mLeaderThread, mLeaderCpu);
+        prepareHandoffWaiter(toLeader);
+        mStartBarrier.arriveAndWait();
+        int64_t startNanos = HostTools::getNanoTime();
+        int64_t startCpuNanos = HostTools::getThreadCpuNanoTime();
+        for (int32_t i = 0; i < mIterations; i++) {
+            HostTools::sleepForNanoseconds(kHandoffGapNanos);
+            mLeaderStamp.store(HostTools::getNanoTime(), std::memory_order_release);
+            toFollower.post();
+            toLeader.wait();
+            int64_t latency = HostTools::getNanoTime()
+                              - mFollowerStamp.load(std::memory_order_acquire);
+            mFanInBins.increment((int32_t) (latency / kHandoffNanosPerBin));
+            mMaxFanInNanos = std::max(mMaxFanInNanos, latency);
+        }
+        mLeaderCpuNanos = HostTools::getThreadCpuNanoTime() - startCpuNanos;
+        mLeaderWallNanos = HostTools::getNanoTime() - startNanos;
+    }
+
+    void followerLoop() {
+        mFollowerFifo = prepareThread(mFollowerThread, mFollowerCpu);
+        prepareHandoffWaiter(toFollower);
+        mStartBarrier.arriveAndWait();
+        int64_t startNanos = HostTools::getNanoTime();
+        int64_t startCpuNanos = HostTools::getThreadCpuNanoTime();
+        for (int32_t i = 0; i < mIterations; i++) {
+            toFollower.wait();
+            int64_t latency = HostTools::getNanoTime()
+                              - mLeaderStamp.load(std::memory_order_acquire);
+            mFanOutBins.increment((int32_t) (latency / kHandoffNanosPerBin));
+            mMaxFanOutNanos = std::max(mMaxFanOutNanos, latency);
+            HostTools::sleepForNanoseconds(kHandoffGapNanos);
+            mFollowerStamp.store(HostTools::getNanoTime(), std::memory_order_release);
+            toLeader.post();
+        }
+        mFollowerCpuNanos = HostTools::getThreadCpuNanoTime() - startCpuNanos;
+        mFollowerWallNanos = HostTools::getNanoTime() - startNanos;
+    }
+
+    static void *leaderProc(void *arg) {
+        ((HandoffPingPong *) arg)->leaderLoop();
+        return NULL;
+    }
+
+    static void *followerProc(void *arg) {
+        ((HandoffPingPong *) arg)->followerLoop();
+        return NULL;
+    }
+
+    BinCounter            mFanOutBins;
+    BinCounter            mFanInBins;
+    int32_t               mIterations;
+    int                   mLeaderCpu;
+    int                   mFollowerCpu;
+    bool                  mUseFifo;
+    bool                  mLeaderFifo = false;
+    bool                  mFollowerFifo = false;
+    HostBarrier           mStartBarrier{2, SyncStrategy::Futex};
+    HostThread           *mLeaderThread = nullptr;
+    HostThread           *mFollowerThread = nullptr;
+    std::atomic<int64_t>  mLeaderStamp{0};
+    std::atomic<int64_t>  mFollowerStamp{0};
+    int64_t               mMaxFanOutNanos = 0;
+    int64_t               mMaxFanInNanos = 0;
+    int64_t               mLeaderCpuNanos = 0;
+    int64_t               mLeaderWallNanos = 0;
+    int64_t               mFollowerCpuNanos = 0;
+    int64_t               mFollowerWallNanos = 0;
+};
+
+#endif // SYNTHMARK_HANDOFF_PING_PONG_H
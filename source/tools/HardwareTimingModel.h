@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_HARDWARE_TIMING_MODEL_H
+#define SYNTHMARK_HARDWARE_TIMING_MODEL_H
+
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "SynthMark.h"
+#include "SynthTools.h"
+
+/**
+ * Decide when a simulated audio device reads from the buffer and how much it reads.
+ *
+ * The default model reads exactly one burst every burst period.
+ * It can be made less ideal by:
+ *   drift - the device clock runs fast or slow by some parts per million
+ *   jitter - each read is moved by a random amount that does not accumulate
+ *   chunks - the device reads large chunks, like USB or Bluetooth
+ *   stalls - the device periodically stops reading then catches up
+ */
+class HardwareTimingModel
+{
+public:
+    enum class JitterType {
+        None,
+        Uniform,   // evenly distributed between -jitter and +jitter
+        Gaussian,  // jitter is the standard deviation, clipped at 4 sigma
+    };
+
+    void setDriftPpm(double driftPpm) {
+        mDriftPpm = driftPpm;
+    }
+
+    double getDriftPpm() const {
+        return mDriftPpm;
+    }
+
+    void setJitter(JitterType type, int64_t jitterNanos) {
+        mJitterType = type;
+        mJitterNanos = jitterNanos;
+    }
+
+    /**
+     * @param framesPerRead frames the device reads at once, or 0 to read one burst
+     */
+    void setFramesPerRead(int32_t framesPerRead) {
+        mRequestedFramesPerRead = framesPerRead;
+    }
+
+    int32_t getRequestedFramesPerRead() const {
+        return mRequestedFramesPerRead;
+    }
+
+    /**
+     * @param periodNanos time between the start of each stall, or 0 for no stalls
+     * @param lengthNanos how long the device stops reading
+     */
+    void setStall(int64_t periodNanos, int64_t lengthNanos) {
+        mStallPeriodNanos = periodNanos;
+        mStallLengthNanos = lengthNanos;
+    }
+
+    bool isIdeal() const {
+        return mDriftPpm == 0.0
+                && (mJitterType == JitterType::None || mJitterNanos == 0)
+                && mRequestedFramesPerRead == 0
+                && (mStallPeriodNanos == 0 || mStallLengthNanos == 0);
+    }
+
+    /**
+     * Begin a new run. The first read happens at startTimeNanos.
+     */
+    void start(int64_t startTimeNanos, int32_t sampleRate, int32_t framesPerBurst) {
+        mFramesPerRead = (mRequestedFramesPerRead > 0) ? mRequestedFramesPerRead
+                                                       : framesPerBurst;
+        // A fast clock reads sooner.
+        mNanosPerRead = (double) mFramesPerRead * SYNTHMARK_NANOS_PER_SECOND
+                        / (sampleRate * (1.0 + (mDriftPpm * 1.0e-6)));
+        mStartTimeNanos = startTimeNanos;
+        mNextReadTimeNanos = startTimeNanos;
+        mReadCount = 0;
+        mRandom.setSeed(kInitialSeed);
+    }
+
+    int64_t getNextReadTime() const {
+        return mNextReadTimeNanos;
+    }
+
+    int32_t getFramesPerRead() const {
+        return mFramesPerRead;
+    }
+
+    /**
+     * Calculate the time of the next read.
+     */
+    void advance() {
+        mReadCount++;
+        // Compute from the start time so that jitter does not accumulate.
+        int64_t offset = (int64_t) (mReadCount * mNanosPerRead) + nextJitter();
+        if (mStallPeriodNanos > 0 && offset > 0) {
+            int64_t phase = offset % mStallPeriodNanos;
+            if (phase < mStallLengthNanos) {
+                offset += mStallLengthNanos - phase;
+            }
+        }
+        int64_t readTime = mStartTimeNanos + offset;
+        if (readTime > mNextReadTimeNanos) {
+            mNextReadTimeNanos = readTime;
+        }
+    }
+
+    std::string toString() const {
+        if (isIdeal()) {
+            return "ideal";
+        }
+        std::stringstream text;
+        text << "drift.ppm=" << mDriftPpm;
+        if (mJitterType != JitterType::None) {
+            text << ",jitter."
+                 << ((mJitterType == JitterType::Uniform) ? "uniform" : "gaussian")
+                 << ".usec=" << (mJitterNanos / SYNTHMARK_NANOS_PER_MICROSECOND);
+        }
+        if (mRequestedFramesPerRead > 0) {
+            text << ",frames.per.read=" << mRequestedFramesPerRead;
+        }
+        if (mStallPeriodNanos > 0) {
+            text << ",stall.msec=" << (mStallLengthNanos / SYNTHMARK_NANOS_PER_MILLISECOND)
+                 << "/" << (mStallPeriodNanos / SYNTHMARK_NANOS_PER_MILLISECOND);
+        }
+        return text.str();
+    }
+
+private:
+
+    // Each run uses the same random sequence so the results are repeatable.
+    static constexpr uint64_t kInitialSeed = 12345678;
+
+    int64_t nextJitter() {
+        switch (mJitterType) {
+            case JitterType::Uniform:
+                return (int64_t) ((mRandom.nextRandomDouble() * 2.0 - 1.0) * mJitterNanos);
+            case JitterType::Gaussian: {
+                // Box-Muller transform.
+                double u1 = 1.0 - mRandom.nextRandomDouble(); // avoid log(0)
+                double u2 = mRandom.nextRandomDouble();
+                double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+                if (normal > 4.0) {
+                    normal = 4.0;
+                } else if (normal < -4.0) {
+                    normal = -4.0;
+                }
+                return (int64_t) (normal * mJitterNanos);
+            }
+            case JitterType::None:
+            default:
+                return 0;
+        }
+    }
+
+    double     mDriftPpm = 0.0;
+    JitterType mJitterType = JitterType::None;
+    int64_t    mJitterNanos = 0;
+    int32_t    mRequestedFramesPerRead = 0;
+    int64_t    mStallPeriodNanos = 0;
+    int64_t    mStallLengthNanos = 0;
+
+    // set in start()
+    int32_t    mFramesPerRead = 0;
+    double     mNanosPerRead = 1.0;
+    int64_t    mStartTimeNanos = 0;
+    int64_t    mNextReadTimeNanos = 0;
+    int64_t    mReadCount = 0;
+    PseudoRandom mRandom{kInitialSeed};
+};
+
+#endif // SYNTHMARK_HARDWARE_TIMING_MODEL_H
@@ -16,5 +16,7 @@
 
 #include "HostTools.h"
 
-HostCpuManagerBase *HostCpuManager::mInstance                 = nullptr;
 bool                HostCpuManager::mWorkloadHintsEnabled = false;
+SleepStrategy       HostTools::mSleepStrategy = SleepStrategy::USleep;
+int64_t             HostTools::mSleepSpinNanos = kDefaultSleepSpinNanos;
+int64_t             HostTools::mTimerSlackNanos = 0;
@@ -29,12 +29,28 @@
 #if defined(__APPLE__)
 #include <mach/mach_time.h>
 #else
+#include <sys/epoll.h>
+#include <sys/prctl.h>
 #include <sys/sysinfo.h>
+#include <sys/timerfd.h>
 #endif
 
 constexpr int64_t kNanosPerMicrosecond  = 1000;
 constexpr int64_t kNanosPerSecond       = 1000000 * kNanosPerMicrosecond;
 
+constexpr int64_t kDefaultSleepSpinNanos = 100 * kNanosPerMicrosecond;
+
+/**
+ * How HostTools::sleepUntilNanoTime() waits for the wakeup time.
+ * Only USleep is available on Apple hosts.
+ */
+enum class SleepStrategy {
+    USleep,    // loop over usleep() in relative microseconds
+    NanoSleep, // clock_nanosleep() with an absolute deadline
+    TimerFd,   // an absolute timerfd deadline, waited for with epoll
+    Hybrid,    // clock_nanosleep() until the spin window, then spin
+};
+
 constexpr int kMaxCpuCount = 64;
 
 /**
@@ -64,6 +80,18 @@ public:
     }
 #endif
 
+    /**
+     * @return CPU time consumed by the calling thread in nanoseconds
+     */
+    static int64_t getThreadCpuNanoTime() {
+        struct timespec res;
+        int result = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &res);
+        if (result < 0) {
+            return result;
+        }
+        return (res.tv_sec * kNanosPerSecond) + res.tv_nsec;
+    }
+
     /**
      * Sleep for the specified nanoseconds.
      * @return the time we actually woke up
@@ -74,10 +102,159 @@ public:
     }
 
     /**
-     * Sleep until the specified time.
+     * Sleep until the specified time using the selected SleepStrategy.
      * @return the time we actually woke up
      */
     static int64_t sleepUntilNanoTime(int64_t wakeupTime) {
+#if !defined(__APPLE__)
+        applyTimerSlack();
+        switch (mSleepStrategy) {
+            case SleepStrategy::NanoSleep:
+                return sleepUntilWithNanoSleep(wakeupTime);
+            case SleepStrategy::TimerFd:
+                return sleepUntilWithTimerFd(wakeupTime);
+            case SleepStrategy::Hybrid:
+                sleepUntilWithNanoSleep(wakeupTime - mSleepSpinNanos);
+                return spinUntilNanoTime(wakeupTime);
+            case SleepStrategy::USleep:
+                break;
+        }
+#endif
+        return sleepUntilWithUSleep(wakeupTime);
+    }
+
+    static void setSleepStrategy(SleepStrategy strategy,
+                                 int64_t spinNanos = kDefaultSleepSpinNanos) {
+        mSleepStrategy = strategy;
+        mSleepSpinNanos = spinNanos;
+    }
+
+    static SleepStrategy getSleepStrategy() {
+        return mSleepStrategy;
+    }
+
+    /**
+     * @return how long the Hybrid strategy spins before the wakeup time
+     */
+    static int64_t getSleepSpinNanos() {
+        return mSleepSpinNanos;
+    }
+
+    static const char *sleepStrategyToString(SleepStrategy strategy) {
+        switch (strategy) {
+            case SleepStrategy::USleep: return "usleep";
+            case SleepStrategy::NanoSleep: return "nanosleep";
+            case SleepStrategy::TimerFd: return "timerfd";
+            case SleepStrategy::Hybrid: return "hybrid";
+        }
+        return "unknown";
+    }
+
+    /**
+     * Set how late the kernel may deliver timers to threads that sleep.
+     * It is applied by each thread the next time it sleeps.
+     * @param slackNanos 0 to leave the kernel default
+     */
+    static void setTimerSlackNanos(int64_t slackNanos) {
+        mTimerSlackNanos = slackNanos;
+    }
+
+    static int64_t getTimerSlackNanos() {
+        return mTimerSlackNanos;
+    }
+
+    static int getCpuCount() {
+#if defined(__APPLE__)
+        return -1;
+#else
+        return get_nprocs();
+#endif
+    }
+
+private:
+
+    static int64_t spinUntilNanoTime(int64_t wakeupTime) {
+        int64_t currentTime = getNanoTime();
+        while (currentTime < wakeupTime) {
+            currentTime = getNanoTime();
+        }
+        return currentTime;
+    }
+
+#if !defined(__APPLE__)
+    static int64_t sleepUntilWithNanoSleep(int64_t wakeupTime) {
+        struct timespec deadline;
+        deadline.tv_sec = wakeupTime / kNanosPerSecond;
+        deadline.tv_nsec = wakeupTime % kNanosPerSecond;
+        while (getNanoTime() < wakeupTime
+               && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0) {
+            // interrupted by a signal
+        }
+        return getNanoTime();
+    }
+
+    /**
+     * Each thread keeps its own timerfd and epoll instance.
+     */
+    struct TimerFd {
+        int timerFd = -1;
+        int epollFd = -1;
+
+        TimerFd() {
+            timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (timerFd >= 0 && epollFd >= 0) {
+                struct epoll_event event;
+                memset(&event, 0, sizeof(event));
+                event.events = EPOLLIN;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+            }
+        }
+
+        ~TimerFd() {
+            if (epollFd >= 0) close(epollFd);
+            if (timerFd >= 0) close(timerFd);
+        }
+    };
+
+    static int64_t sleepUntilWithTimerFd(int64_t wakeupTime) {
+        static thread_local TimerFd timer;
+        if (timer.timerFd < 0 || timer.epollFd < 0) {
+            return sleepUntilWithNanoSleep(wakeupTime);
+        }
+        if (wakeupTime <= getNanoTime()) {
+            return getNanoTime();
+        }
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = wakeupTime / kNanosPerSecond;
+        spec.it_value.tv_nsec = wakeupTime % kNanosPerSecond;
+        if (timerfd_settime(timer.timerFd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) {
+            return sleepUntilWithNanoSleep(wakeupTime);
+        }
+        struct epoll_event event;
+        while (epoll_wait(timer.epollFd, &event, 1, -1) < 0) {
+            // interrupted by a signal
+        }
+        uint64_t expirations;
+        ssize_t numRead = read(timer.timerFd, &expirations, sizeof(expirations));
+        (void) numRead;
+        return getNanoTime();
+    }
+
+    /**
+     * PR_SET_TIMERSLACK only affects the calling thread.
+     */
+    static void applyTimerSlack() {
+        static thread_local int64_t appliedSlackNanos = 0;
+        if (mTimerSlackNanos != appliedSlackNanos) {
+            prctl(PR_SET_TIMERSLACK, (unsigned long) mTimerSlackNanos, 0, 0, 0);
+            appliedSlackNanos = mTimerSlackNanos;
+        }
+    }
+#endif
+
+    static int64_t sleepUntilWithUSleep(int64_t wakeupTime) {
         const int32_t kMaxMicros = 999999; // from usleep documentation
         int64_t currentTime = getNanoTime();
         int64_t nanosToSleep = wakeupTime - currentTime;
@@ -98,13 +275,9 @@ public:
         return currentTime;
     }
 
-    static int getCpuCount() {
-#if defined(__APPLE__)
-        return -1;
-#else
-        return get_nprocs();
-#endif
-    }
+    static SleepStrategy mSleepStrategy;
+    static int64_t       mSleepSpinNanos;
+    static int64_t       mTimerSlackNanos;
 };
 
 typedef void * host_thread_proc_t(void *arg);
@@ -191,6 +364,7 @@ protected:
 class HostCpuManagerBase
 {
 public:
+    virtual ~HostCpuManagerBase() = default;
 
     /**
      * Sleep until the specified time and tune the CPU for optimal performance.
@@ -229,17 +403,38 @@ public:
         return mNanosPerBurst;
     }
 
+    /**
+     * This is called after each burst with the effective CPU frequency measured during it.
+     *
+     * @param cpuSpeedMHz measured speed, or 0 if unknown
+     * @param maxCpuSpeedMHz highest speed expected from this CPU, or 0 if unknown
+     */
+    virtual void setMeasuredCpuSpeedMHz(int32_t cpuSpeedMHz, int32_t maxCpuSpeedMHz) {
+        mMeasuredCpuSpeedMHz = cpuSpeedMHz;
+        mMeasuredMaxCpuSpeedMHz = maxCpuSpeedMHz;
+    }
+
+    int32_t getMeasuredCpuSpeedMHz() const {
+        return mMeasuredCpuSpeedMHz;
+    }
+
+    int32_t getMeasuredMaxCpuSpeedMHz() const {
+        return mMeasuredMaxCpuSpeedMHz;
+    }
+
 private:
 
     int32_t mCurrentWorkUnits = 0;
     int32_t mMaxWorkUnits = 1;
     int64_t mNanosPerBurst = 0;
+    int32_t mMeasuredCpuSpeedMHz = 0;
+    int32_t mMeasuredMaxCpuSpeedMHz = 0;
 };
 
 
 /**
  * Measure CPU utilization and then give hints to the CPU governor stub to control clock speed.
- * This is a stub that you can replace in HostCpuManager::getInstance() below.
+ * This is a stub that you can replace in HostCpuManager::create() below.
  * This stub is only meant to illustrate the idea and may be implemented very differently
  * in a real system.
  */
@@ -301,10 +496,15 @@ private:
     // Note that these are just fake values for this stub implementation.
     // A real custom implementation would use real values, or may use
     // some other way of controlling CPU speed that is more indirect.
+    // The speeds measured by the CpuFrequencyEstimator are used when available.
     int32_t mFakeCpuSpeed = 600;
     const int32_t mFakeMaxCpuSpeed = 2000;
-    int32_t getCpuSpeedMHz(int cpuIndex) { return mFakeCpuSpeed; } // FIXME
-    int32_t getMaxCpuSpeedMHz(int cpuIndex) { return mFakeMaxCpuSpeed; } // FIXME
+    int32_t getCpuSpeedMHz(int cpuIndex) {
+        return (getMeasuredCpuSpeedMHz() > 0) ? getMeasuredCpuSpeedMHz() : mFakeCpuSpeed;
+    }
+    int32_t getMaxCpuSpeedMHz(int cpuIndex) {
+        return (getMeasuredMaxCpuSpeedMHz() > 0) ? getMeasuredMaxCpuSpeedMHz() : mFakeMaxCpuSpeed;
+    }
 
     void requestCpuSpeedMHz(int cpuIndex, int32_t cpuSpeedMHz) {  // FIXME
         if (cpuSpeedMHz < 300) cpuSpeedMHz = 300;
@@ -369,21 +569,19 @@ private:
 #include "CustomHostCpuManager.h"
 
 /**
- * Return a singleton instance of a HostCpuManagerBase.
+ * Create instances of HostCpuManagerBase.
+ * Each audio sink owns one so that independent streams do not share timing state.
  */
 class HostCpuManager
 {
 public:
 
-    static HostCpuManagerBase *getInstance() {
-        if (mInstance == nullptr) {
-            if (mWorkloadHintsEnabled) {
-                mInstance = new CustomHostCpuManager();
-            } else {
-                mInstance = new HostCpuManagerStub();
-            }
+    static HostCpuManagerBase *create() {
+        if (mWorkloadHintsEnabled) {
+            return new CustomHostCpuManager();
+        } else {
+            return new HostCpuManagerStub();
         }
-        return mInstance;
     }
 
     static bool areWorkloadHintsEnabled() {
@@ -396,7 +594,6 @@ public:
 
 private:
     HostCpuManager() {}
-    static HostCpuManagerBase *mInstance;
     static bool                mWorkloadHintsEnabled;
 
 };
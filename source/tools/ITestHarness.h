@@ -19,6 +19,9 @@
 
 #include <cmath>
 #include <cstdint>
+#include <string>
+#include "synth/SampleTraits.h"
+#include "tools/NoteEventQueue.h"
 
 class ITestHarness {
 
@@ -32,6 +35,23 @@ public:
     virtual int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) = 0;
 
     virtual void setThreadType(HostThreadFactory::ThreadType mThreadType) = 0;
+
+    virtual void setSampleType(SampleType sampleType) = 0;
+
+    virtual void setOversampling(int32_t oversampling) = 0;
+
+    virtual void setEffects(int32_t effectsFlags) = 0;
+
+    virtual void setImpulseSeconds(float seconds) = 0;
+
+    virtual void setChannelCount(int32_t channelCount) = 0;
+
+    virtual void setPipelineDepth(int32_t depth) = 0;
+
+    virtual void setNoteEvents(int32_t eventsPerSecond, NoteQueueType queueType,
+                               int32_t numProducers) = 0;
+
+    virtual void setMidiFile(const std::string &fileName, int32_t tempoPercent) = 0;
 };
 
 #endif //SYNTHMARK_ITEST_HARNESS_H
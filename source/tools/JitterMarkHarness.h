@@ -23,6 +23,7 @@
 
 #include "AudioSinkBase.h"
 #include "ChangingVoiceHarness.h"
+#include "HostTools.h"
 #include "SynthMark.h"
 #include "synth/Synthesizer.h"
 #include "TestHarnessParameters.h"
@@ -63,7 +64,11 @@ public:
 
         resultMessage << dumpJitter();
         resultMessage << "underrun.count = " << mAudioSink->getUnderrunCount() << "\n";
+        resultMessage << "sleep.strategy = "
+                      << HostTools::sleepStrategyToString(HostTools::getSleepStrategy()) << "\n";
+        resultMessage << "timer.slack.nanos = " << HostTools::getTimerSlackNanos() << "\n";
         resultMessage << mCpuAnalyzer.dump();
+        resultMessage << mPerfAnalyzer.dump();
 
         mResult->setMeasurement(measurement);
         mResult->appendMessage(resultMessage.str());
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_LATENCY_HISTOGRAM_H
+#define SYNTHMARK_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Linear sub-buckets per power of two. The relative error is below 1 / 64.
+constexpr int32_t kLatencyHistogramSubBucketBits = 6;
+// Values up to 2^40 nanoseconds, about 18 minutes, are counted in their own bucket.
+constexpr int32_t kLatencyHistogramMaxBits = 40;
+
+/**
+ * Log-linear histogram of durations in nanoseconds, in the style of HdrHistogram.
+ *
+ * Values below 2^(kLatencyHistogramSubBucketBits + 1) are counted exactly.
+ * Above that each power of two is split into 2^kLatencyHistogramSubBucketBits
+ * equal buckets, so the precision follows the magnitude and outliers are
+ * never clamped into a catch-all bin. The maximum is tracked exactly.
+ *
+ * All histograms have the same layout so they can be merged, for example
+ * to combine several streams or several runs.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int32_t kSubBucketCount = 1 << kLatencyHistogramSubBucketBits;
+    static constexpr int32_t kNumBuckets =
+            (kLatencyHistogramMaxBits - kLatencyHistogramSubBucketBits + 1) * kSubBucketCount;
+
+    LatencyHistogram()
+            : mCounts(kNumBuckets)
+            , mLastMarkers(kNumBuckets) {
+    }
+
+    void reset() {
+        std::fill(mCounts.begin(), mCounts.end(), 0);
+        std::fill(mLastMarkers.begin(), mLastMarkers.end(), 0);
+        mTotalCount = 0;
+        mTotalNanos = 0;
+        mMinNanos = INT64_MAX;
+        mMaxNanos = 0;
+    }
+
+    void record(int64_t nanos) {
+        if (nanos < 0) {
+            nanos = 0;
+        }
+        int32_t index = indexOf(nanos);
+        mCounts[index]++;
+        mLastMarkers[index] = (int32_t) mTotalCount;
+        mTotalCount++;
+        mTotalNanos += nanos;
+        if (nanos < mMinNanos) {
+            mMinNanos = nanos;
+        }
+        if (nanos > mMaxNanos) {
+            mMaxNanos = nanos;
+        }
+    }
+
+    /**
+     * Add the counts from another histogram.
+     * Its last markers are placed after the values already in this one.
+     */
+    void merge(const LatencyHistogram &other) {
+        for (int32_t i = 0; i < kNumBuckets; i++) {
+            if (other.mCounts[i] > 0) {
+                mCounts[i] += other.mCounts[i];
+                mLastMarkers[i] = (int32_t) (mTotalCount + other.mLastMarkers[i]);
+            }
+        }
+        mTotalCount += other.mTotalCount;
+        mTotalNanos += other.mTotalNanos;
+        if (other.mMinNanos < mMinNanos) {
+            mMinNanos = other.mMinNanos;
+        }
+        if (other.mMaxNanos > mMaxNanos) {
+            mMaxNanos = other.mMaxNanos;
+        }
+    }
+
+    /**
+     * @param fraction of the counts, for example 0.99 for the 99th percentile
+     * @return highest value equivalent to the value at that fraction, or 0 if empty
+     */
+    int64_t getValueAtPercentile(double fraction) const {
+        if (mTotalCount == 0) {
+            return 0;
+        }
+        int64_t threshold = (int64_t) ceil(fraction * mTotalCount);
+        if (threshold < 1) {
+            threshold = 1;
+        }
+        int64_t sum = 0;
+        for (int32_t i = 0; i < kNumBuckets; i++) {
+            sum += mCounts[i];
+            if (sum >= threshold) {
+                int64_t highest = getHighestValue(i);
+                return (highest < mMaxNanos) ? highest : mMaxNanos;
+            }
+        }
+        return mMaxNanos;
+    }
+
+    int64_t getCount() const {
+        return mTotalCount;
+    }
+
+    int64_t getCount(int32_t index) const {
+        return mCounts[index];
+    }
+
+    /**
+     * @return sequence number of the last value counted in the bucket
+     */
+    int32_t getLastMarker(int32_t index) const {
+        return mLastMarkers[index];
+    }
+
+    int64_t getMinNanos() const {
+        return (mTotalCount > 0) ? mMinNanos : 0;
+    }
+
+    int64_t getMaxNanos() const {
+        return mMaxNanos;
+    }
+
+    double getMeanNanos() const {
+        return (mTotalCount > 0) ? ((double) mTotalNanos / mTotalCount) : 0.0;
+    }
+
+    static int32_t indexOf(int64_t nanos) {
+        uint64_t value = (uint64_t) nanos;
+        int32_t msb = highestBit(value);
+        if (msb <= kLatencyHistogramSubBucketBits) {
+            return (int32_t) value; // exact
+        }
+        if (msb >= kLatencyHistogramMaxBits) {
+            return kNumBuckets - 1;
+        }
+        int32_t shift = msb - kLatencyHistogramSubBucketBits;
+        int32_t subBucket = (int32_t) (value >> shift) - kSubBucketCount;
+        return ((shift + 1) << kLatencyHistogramSubBucketBits) + subBucket;
+    }
+
+    /**
+     * @return smallest value counted in the bucket
+     */
+    static int64_t getLowestValue(int32_t index) {
+        if (index < 2 * kSubBucketCount) {
+            return index;
+        }
+        int32_t shift = (index >> kLatencyHistogramSubBucketBits) - 1;
+        int64_t subBucket = kSubBucketCount + (index & (kSubBucketCount - 1));
+        return subBucket << shift;
+    }
+
+    /**
+     * @return largest value counted in the bucket
+     */
+    static int64_t getHighestValue(int32_t index) {
+        if (index < 2 * kSubBucketCount) {
+            return index;
+        }
+        int32_t shift = (index >> kLatencyHistogramSubBucketBits) - 1;
+        return getLowestValue(index) + (((int64_t) 1) << shift) - 1;
+    }
+
+private:
+    static int32_t highestBit(uint64_t value) {
+        int32_t msb = 0;
+        for (int32_t step = 32; step > 0; step >>= 1) {
+            if (value >> step) {
+                value >>= step;
+                msb += step;
+            }
+        }
+        return msb;
+    }
+
+    std::vector<int64_t> mCounts;
+    std::vector<int32_t> mLastMarkers;
+    int64_t              mTotalCount = 0;
+    int64_t              mTotalNanos = 0;
+    int64_t              mMinNanos = INT64_MAX;
+    int64_t              mMaxNanos = 0;
+};
+
+#endif // SYNTHMARK_LATENCY_HISTOGRAM_H
@@ -46,7 +46,7 @@ public:
     IAudioSinkCallback::Result onRenderAudio(float *buffer,
                                              int32_t numFrames) override {
         IAudioSinkCallback::Result result = ChangingVoiceHarness::onRenderAudio(buffer, numFrames);
-        if (mAudioSink->getUnderrunCount() > 0) {
+        if (mAudioSink->getUnderrunCount() > 0 || getPipelineUnderrunCount() > 0) {
              result = IAudioSinkCallback::Finished;
         }
         return result;
@@ -89,6 +89,14 @@ public:
         resultMessage << "audio.latency.bursts = " << mLowestGoodBursts << std::endl;
         resultMessage << "audio.latency.frames = " << sizeFrames << std::endl;
         resultMessage << "audio.latency.msec   = " << latencyMsec << std::endl;
+        if (mPipelineDepth > 0) {
+            int32_t pipelineFrames = mPipelineDepth * getFramesPerBurst();
+            resultMessage << "pipeline.depth       = " << mPipelineDepth << std::endl;
+            resultMessage << "pipeline.latency.frames = " << pipelineFrames << std::endl;
+            resultMessage << "total.latency.msec   = "
+                          << (1000.0 * (sizeFrames + pipelineFrames) / getSampleRate())
+                          << std::endl;
+        }
 
         mResult->appendMessage(resultMessage.str());
         mResult->setResultCode(SYNTHMARK_RESULT_SUCCESS);
@@ -121,7 +129,8 @@ public:
                 mLogTool->log("LatencyMark: %s returning err = %d -----------\n",  __func__, err);
                 return err;
             }
-            bool glitched = (mAudioSink->getUnderrunCount() > 0);
+            bool glitched = (mAudioSink->getUnderrunCount() > 0)
+                    || (mPipelineUnderrunCount > 0);
             if (!glitched) {
                 printf("LatencyMark: no glitches\n");
             }
@@ -149,15 +158,20 @@ public:
         harness.setNumVoices(getNumVoices());
         harness.setNumVoicesHigh(getNumVoicesHigh());
         harness.setVoicesMode(getVoicesMode());
-        harness.setDelayNoteOnSeconds(mDelayNotesOn);
-        harness.setThreadType(mThreadType);
+        copyParametersTo(&harness);
+        harness.setFlightRecorderFile(mFlightFileName, true);
 
         int32_t err = harness.runTest(sampleRate, framesPerBurst, numSeconds);
+        mPipelineUnderrunCount = harness.getPipelineUnderrunCount();
 
-        if (mAudioSink->getUnderrunCount() > 0) {
+        if (mAudioSink->getUnderrunCount() > 0 || mPipelineUnderrunCount > 0) {
             // Record when the glitch occurred.
             float glitchTime = ((float) harness.getFrameCount() / mAudioSink->getSampleRate());
             printf("LatencyMark: detected glitch at %5.2f seconds\n", glitchTime);
+            if (!mFlightFileName.empty()) {
+                printf("LatencyMark: saved the bursts before the glitch to %s\n",
+                       mFlightFileName.c_str());
+            }
             fflush(stdout);
         }
 
@@ -264,6 +278,7 @@ public:
     int32_t           mLowestGoodBursts;
     int32_t           mDelta;
     int32_t           mPowerOf2;
+    int32_t           mPipelineUnderrunCount = 0; // from the last measureOnce()
     state_search_t    mState = STATE_RAMP_UP;
 };
 
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_MIDI_FILE_H
+#define SYNTHMARK_MIDI_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "NoteEventQueue.h"
+
+constexpr int32_t kMidiDefaultMicrosPerQuarter = 500000; // 120 BPM
+
+/**
+ * Note from a Standard MIDI File, with the time converted to seconds.
+ */
+struct MidiNote {
+    double        seconds;
+    NoteEventType type;
+    int32_t       noteNumber;
+    float         velocity;   // 0.0 to 1.0
+};
+
+/**
+ * Read the notes of a Standard MIDI File, format 0 or 1.
+ *
+ * The tracks are merged and the tempo changes are applied so that each note
+ * has a time in seconds. All channels are merged. Other messages are skipped.
+ * A note on with zero velocity is treated as a note off.
+ */
+class MidiFile
+{
+public:
+    /**
+     * @return 0 on success, or -1 with a message from getErrorText()
+     */
+    int32_t load(const std::string &fileName) {
+        mNotes.clear();
+        mDurationSeconds = 0.0;
+        FILE *file = fopen(fileName.c_str(), "rb");
+        if (file == nullptr) {
+            return fail("could not open " + fileName);
+        }
+        std::vector<uint8_t> data;
+        uint8_t chunk[4096];
+        size_t numRead;
+        while ((numRead = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            data.insert(data.end(), chunk, chunk + numRead);
+        }
+        fclose(file);
+        return parse(data);
+    }
+
+    /**
+     * Parse a whole file that is already in memory.
+     */
+    int32_t parse(const std::vector<uint8_t> &data) {
+        mNotes.clear();
+        mDurationSeconds = 0.0;
+        mData = &data;
+        mPosition = 0;
+        if (!matchTag("MThd")) {
+            return fail("not a Standard MIDI File");
+        }
+        int32_t headerLength = readBigEndian(4);
+        if (headerLength < 6 || !isAvailable(headerLength)) {
+            return fail("not a Standard MIDI File");
+        }
+        int32_t format = readBigEndian(2);
+        int32_t numTracks = readBigEndian(2);
+        int32_t division = readBigEndian(2);
+        // Later versions may add fields to the header.
+        mPosition += headerLength - 6;
+        if (format > 1) {
+            return fail("only MIDI file formats 0 and 1 are supported");
+        }
+        if (division <= 0 || (division & 0x8000) != 0) {
+            return fail("SMPTE time division is not supported");
+        }
+
+        std::vector<TickEvent> events;
+        int64_t endTick = 0;
+        for (int32_t track = 0; track < numTracks; track++) {
+            int32_t result = parseTrack(track, &events, &endTick);
+            if (result < 0) {
+                return result;
+            }
+        }
+        // Order by time. At the same tick, tempo changes first, then the order in the file.
+        std::stable_sort(events.begin(), events.end(),
+                         [](const TickEvent &a, const TickEvent &b) {
+                             if (a.tick != b.tick) return a.tick < b.tick;
+                             return a.isTempo && !b.isTempo;
+                         });
+
+        // Convert ticks to seconds using the tempo map.
+        double secondsPerTick = kMidiDefaultMicrosPerQuarter * 1.0e-6 / division;
+        int64_t lastTick = 0;
+        double seconds = 0.0;
+        for (const TickEvent &event : events) {
+            seconds += (event.tick - lastTick) * secondsPerTick;
+            lastTick = event.tick;
+            if (event.isTempo) {
+                secondsPerTick = event.microsPerQuarter * 1.0e-6 / division;
+            } else {
+                MidiNote note = event.note;
+                note.seconds = seconds;
+                mNotes.push_back(note);
+            }
+        }
+        mDurationSeconds = seconds + (endTick - lastTick) * secondsPerTick;
+        return 0;
+    }
+
+    const std::vector<MidiNote> &getNotes() const {
+        return mNotes;
+    }
+
+    /**
+     * @return time of the last end of track
+     */
+    double getDurationSeconds() const {
+        return mDurationSeconds;
+    }
+
+    const std::string &getErrorText() const {
+        return mErrorText;
+    }
+
+private:
+    struct TickEvent {
+        int64_t  tick;
+        bool     isTempo;
+        int32_t  microsPerQuarter;
+        MidiNote note;
+    };
+
+    int32_t fail(const std::string &text) {
+        mErrorText = text;
+        mNotes.clear();
+        return -1;
+    }
+
+    bool isAvailable(size_t numBytes) const {
+        return numBytes <= mData->size() - mPosition;
+    }
+
+    bool matchTag(const char *tag) {
+        if (!isAvailable(4)) {
+            return false;
+        }
+        bool match = std::equal(tag, tag + 4, mData->begin() + mPosition);
+        mPosition += 4;
+        return match;
+    }
+
+    int32_t readBigEndian(int32_t numBytes) {
+        int32_t value = 0;
+        for (int32_t i = 0; i < numBytes && mPosition < mData->size(); i++) {
+            value = (value << 8) | (*mData)[mPosition++];
+        }
+        return value;
+    }
+
+    /**
+     * Read a variable length quantity, at most 4 bytes.
+     */
+    int32_t readVariableLength(size_t end) {
+        int32_t value = 0;
+        for (int i = 0; i < 4 && mPosition < end; i++) {
+            uint8_t byte = (*mData)[mPosition++];
+            value = (value << 7) | (byte & 0x7F);
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int32_t parseTrack(int32_t track, std::vector<TickEvent> *events, int64_t *endTick) {
+        // Skip unknown chunks.
+        while (isAvailable(8) && !std::equal("MTrk", "MTrk" + 4, mData->begin() + mPosition)) {
+            mPosition += 4;
+            int32_t chunkLength = readBigEndian(4);
+            // A length with the top bit set is negative and could loop forever.
+            if (chunkLength < 0 || !isAvailable(chunkLength)) {
+                return fail("chunk before track " + std::to_string(track) + " is truncated");
+            }
+            mPosition += chunkLength;
+        }
+        if (!matchTag("MTrk")) {
+            return fail("missing track " + std::to_string(track));
+        }
+        int32_t length = readBigEndian(4);
+        if (length < 0 || !isAvailable(length)) {
+            return fail("track " + std::to_string(track) + " is truncated");
+        }
+        size_t end = mPosition + length;
+        int64_t tick = 0;
+        uint8_t status = 0;
+        while (mPosition < end) {
+            tick += readVariableLength(end);
+            if (mPosition >= end) {
+                break;
+            }
+            uint8_t byte = (*mData)[mPosition];
+            if (byte & 0x80) {
+                mPosition++;
+                if (byte < 0xF0) {
+                    status = byte; // running status only applies to channel messages
+                }
+            } else if (status == 0) {
+                return fail("data byte without status in track " + std::to_string(track));
+            } else {
+                byte = status;
+            }
+
+            if (byte == 0xFF) {
+                uint8_t type = (mPosition < end) ? (*mData)[mPosition++] : 0;
+                int32_t metaLength = readVariableLength(end);
+                if (type == 0x51 && metaLength == 3) {
+                    TickEvent event = {};
+                    event.tick = tick;
+                    event.isTempo = true;
+                    event.microsPerQuarter = readBigEndian(3);
+                    events->push_back(event);
+                } else {
+                    mPosition += metaLength;
+                }
+            } else if (byte == 0xF0 || byte == 0xF7) {
+                mPosition += readVariableLength(end);
+            } else {
+                int32_t command = byte & 0xF0;
+                int32_t numData = (command == 0xC0 || command == 0xD0) ? 1 : 2;
+                if (mPosition + numData > end) {
+                    break;
+                }
+                const uint8_t *data = &(*mData)[mPosition];
+                mPosition += numData;
+                if (command == 0x90 || command == 0x80) {
+                    TickEvent event = {};
+                    event.tick = tick;
+                    event.note.noteNumber = data[0] & 0x7F;
+                    event.note.velocity = (data[1] & 0x7F) / 127.0f;
+                    event.note.type = (command == 0x90 && data[1] > 0)
+                            ? NoteEventType::NoteOn : NoteEventType::NoteOff;
+                    events->push_back(event);
+                }
+            }
+        }
+        mPosition = end;
+        *endTick = std::max(*endTick, tick);
+        return 0;
+    }
+
+    std::vector<MidiNote>       mNotes;
+    double                      mDurationSeconds = 0.0;
+    std::string                 mErrorText;
+    const std::vector<uint8_t> *mData = nullptr;
+    size_t                      mPosition = 0;
+};
+
+#endif // SYNTHMARK_MIDI_FILE_H
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_MIDI_FILE_PLAYER_H
+#define SYNTHMARK_MIDI_FILE_PLAYER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "MidiFile.h"
+#include "NoteEventQueue.h"
+
+// Tempo scale is given in percent.
+constexpr int32_t kMidiMinTempoPercent = 10;
+constexpr int32_t kMidiMaxTempoPercent = 1000;
+
+/**
+ * Play the notes of a MIDI file as note events with frame offsets inside each burst.
+ * The events ask the synthesizer to allocate a voice for the note.
+ */
+class MidiFilePlayer
+{
+public:
+    /**
+     * @param tempoScale 2.0 plays twice as fast
+     * @param loop start again at the end of the file
+     */
+    int32_t setup(const std::string &fileName, double tempoScale, bool loop) {
+        int32_t result = mFile.load(fileName);
+        if (result < 0) {
+            return result;
+        }
+        mTempoScale = tempoScale;
+        mLoop = loop;
+        reset(48000);
+        return 0;
+    }
+
+    void reset(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        mNextNote = 0;
+        mFramePosition = 0;
+        mLoopStartFrame = 0;
+        mLoopCount = 0;
+        double frames = mFile.getDurationSeconds() * sampleRate / mTempoScale;
+        // Avoid a loop of zero length when the file has no duration.
+        mLoopFrames = std::max((int64_t) frames, (int64_t) 1);
+    }
+
+    /**
+     * Return the notes that start in the next numFrames and advance by numFrames.
+     * Notes that do not fit in maxEvents are returned by the next call at offset 0.
+     * @return number of events
+     */
+    int32_t advance(int32_t numFrames, NoteEvent *events, int32_t *offsets,
+                    int32_t maxEvents) {
+        const std::vector<MidiNote> &notes = mFile.getNotes();
+        int64_t endFrame = mFramePosition + numFrames;
+        int32_t numEvents = 0;
+        while (numEvents < maxEvents) {
+            if (mNextNote >= notes.size()) {
+                if (!mLoop || notes.empty()) {
+                    break;
+                }
+                int64_t nextLoopStart = mLoopStartFrame + mLoopFrames;
+                if (nextLoopStart >= endFrame) {
+                    break;
+                }
+                mLoopStartFrame = nextLoopStart;
+                mNextNote = 0;
+                mLoopCount++;
+            }
+            const MidiNote &note = notes[mNextNote];
+            int64_t noteFrame = mLoopStartFrame
+                    + (int64_t) (note.seconds * mSampleRate / mTempoScale);
+            if (noteFrame >= endFrame) {
+                break;
+            }
+            NoteEvent &event = events[numEvents];
+            event.timestampNanos = 0;
+            event.type = note.type;
+            event.voiceIndex = kNoteEventAnyVoice;
+            event.pitch = (float) note.noteNumber;
+            event.velocity = note.velocity;
+            offsets[numEvents] = (int32_t) std::max(noteFrame - mFramePosition, (int64_t) 0);
+            numEvents++;
+            mNextNote++;
+        }
+        mFramePosition = endFrame;
+        return numEvents;
+    }
+
+    const MidiFile &getFile() const {
+        return mFile;
+    }
+
+    int32_t getLoopCount() const {
+        return mLoopCount;
+    }
+
+private:
+    MidiFile mFile;
+    double   mTempoScale = 1.0;
+    bool     mLoop = true;
+    int32_t  mSampleRate = 48000;
+    size_t   mNextNote = 0;
+    int64_t  mFramePosition = 0;
+    int64_t  mLoopStartFrame = 0;
+    int64_t  mLoopFrames = 1;
+    int32_t  mLoopCount = 0;
+};
+
+#endif // SYNTHMARK_MIDI_FILE_PLAYER_H
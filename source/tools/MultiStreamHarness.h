@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_MULTI_STREAM_HARNESS_H
+#define SYNTHMARK_MULTI_STREAM_HARNESS_H
+
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+#include "AudioSinkBase.h"
+#include "HostTools.h"
+#include "LatencyHistogram.h"
+#include "SynthMark.h"
+#include "tools/LogTool.h"
+#include "tools/TestHarnessBase.h"
+#include "tools/TimingAnalyzer.h"
+#include "TestHarnessParameters.h"
+#include "VirtualAudioSink.h"
+
+constexpr int32_t kMultiStreamMaxStreams = 16;
+
+/**
+ * Render one stream of a MultiStream test and keep the statistics
+ * that are needed after the stream finishes.
+ */
+class StreamHarness : public TestHarnessBase {
+public:
+    StreamHarness(AudioSinkBase *audioSink,
+                  SynthMarkResult *result,
+                  LogTool *logTool = NULL)
+            : TestHarnessBase(audioSink, result, logTool)
+    {
+        mTestName = "Stream";
+    }
+
+    virtual ~StreamHarness() {
+    }
+
+    virtual void onEndMeasurement() override {
+        mUnderrunCount = mAudioSink->getUnderrunCount();
+        mResult->setResultCode(SYNTHMARK_RESULT_SUCCESS);
+    }
+
+    int32_t getUnderrunCount() const {
+        return mUnderrunCount;
+    }
+
+    double getUtilization() {
+        return mTimer.getDutyCycle();
+    }
+
+    double getMeanWakeupMicros() {
+        int32_t numWakeups = mTimer.getCallCount() - 1; // the first one is not measured
+        if (numWakeups <= 0) {
+            return 0.0;
+        }
+        return (double) mTimer.getTotalWakeupDelayNanos()
+               / (numWakeups * SYNTHMARK_NANOS_PER_MICROSECOND);
+    }
+
+    double getMaxWakeupMicros() {
+        return (double) mTimer.getMaxWakeupDelayNanos() / SYNTHMARK_NANOS_PER_MICROSECOND;
+    }
+
+    const LatencyHistogram &getWakeupHistogram() const {
+        return mTimer.getWakeupHistogram();
+    }
+
+    double getVoiceSeconds() {
+        return (double) mFrameCounter * getNumVoices() / mSampleRate;
+    }
+
+private:
+    int32_t mUnderrunCount = 0;
+};
+
+/**
+ * Run several independent synthesizers at the same time, each with its own
+ * audio sink on its own real-time thread, like a host running multiple streams.
+ * The voice counts are spread from numVoices to numVoicesHigh.
+ * Report the underruns and wakeup jitter of each stream and the aggregate throughput.
+ *
+ * The first stream uses the sink passed to the constructor so that options
+ * like -O and -D apply to it. The other streams get a VirtualAudioSink with the same timing.
+ */
+class MultiStreamHarness : public TestHarnessParameters {
+
+public:
+    MultiStreamHarness(VirtualAudioSink *audioSink,
+                       SynthMarkResult *result,
+                       LogTool *logTool = nullptr)
+            : TestHarnessParameters(audioSink, result, logTool)
+            , mPacedSink(audioSink) {}
+
+    virtual ~MultiStreamHarness() {}
+
+    const char *getName() const override {
+        return "MultiStream";
+    }
+
+    void setNumStreams(int32_t numStreams) {
+        mNumStreams = numStreams;
+    }
+
+    int32_t getNumStreams() const {
+        return mNumStreams;
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        if (mNumStreams < 1 || mNumStreams > kMultiStreamMaxStreams) {
+            mLogTool->log("ERROR in MultiStream, numStreams = %d not in [1, %d]\n",
+                          mNumStreams, kMultiStreamMaxStreams);
+            mResult->setResultCode(SYNTHMARK_RESULT_UNRECOVERABLE_ERROR);
+            return SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+        }
+        mLogTool->log("---- Starting %d streams ----\n", mNumStreams);
+
+        // Size the vector first because the threads hold pointers to the elements.
+        std::vector<Stream> streams(mNumStreams);
+        for (int32_t i = 0; i < mNumStreams; i++) {
+            Stream &stream = streams[i];
+            stream.sink = (i == 0) ? mPacedSink : createSink(i);
+            stream.harness = new StreamHarness(stream.sink, &stream.result, mLogTool);
+            configure(stream.harness, getStreamVoices(i));
+            stream.sampleRate = sampleRate;
+            stream.framesPerBurst = framesPerBurst;
+            stream.numSeconds = numSeconds;
+        }
+
+        int64_t startNanos = HostTools::getNanoTime();
+        int32_t err = SYNTHMARK_RESULT_SUCCESS;
+        for (Stream &stream : streams) {
+            if (stream.thread.start(streamProc, &stream) != 0) {
+                err = SYNTHMARK_RESULT_THREAD_FAILURE;
+            }
+        }
+        for (Stream &stream : streams) {
+            stream.thread.join();
+        }
+        double wallSeconds = (double) (HostTools::getNanoTime() - startNanos)
+                             / SYNTHMARK_NANOS_PER_SECOND;
+
+        std::stringstream resultMessage;
+        int32_t totalUnderruns = 0;
+        double totalVoiceSeconds = 0.0;
+        LatencyHistogram wakeupHistogram; // all streams together
+        for (int32_t i = 0; i < mNumStreams; i++) {
+            Stream &stream = streams[i];
+            StreamHarness *harness = stream.harness;
+            if (err == SYNTHMARK_RESULT_SUCCESS) {
+                err = (stream.err != SYNTHMARK_RESULT_SUCCESS)
+                      ? stream.err : stream.result.getResultCode();
+            }
+            std::string prefix = "stream." + std::to_string(i) + ".";
+            resultMessage << prefix << "voices = " << harness->getNumVoices() << std::endl;
+            resultMessage << prefix << "underruns = " << harness->getUnderrunCount() << std::endl;
+            resultMessage << prefix << "wakeup.mean.usec = "
+                          << harness->getMeanWakeupMicros() << std::endl;
+            resultMessage << prefix << "wakeup.max.usec = "
+                          << harness->getMaxWakeupMicros() << std::endl;
+            resultMessage << prefix << "utilization = " << harness->getUtilization() << std::endl;
+            totalUnderruns += harness->getUnderrunCount();
+            totalVoiceSeconds += harness->getVoiceSeconds();
+            wakeupHistogram.merge(harness->getWakeupHistogram());
+            delete harness;
+            if (stream.sink != mPacedSink) {
+                delete stream.sink;
+            }
+        }
+
+        double perWallSecond = (wallSeconds > 0.0) ? (totalVoiceSeconds / wallSeconds) : 0.0;
+        resultMessage << "streams = " << mNumStreams << std::endl;
+        resultMessage << "underruns = " << totalUnderruns << std::endl;
+        resultMessage << TimingAnalyzer::dumpPercentiles("wakeup", wakeupHistogram);
+        resultMessage << "voice.seconds = " << totalVoiceSeconds << std::endl;
+        resultMessage << "wall.seconds = " << wallSeconds << std::endl;
+        resultMessage << "voice.seconds.per.wall.second = " << perWallSecond << std::endl;
+        resultMessage << getName() << " = " << perWallSecond << std::endl;
+
+        mResult->setTestName(getName());
+        mResult->setMeasurement(perWallSecond);
+        mResult->setResultCode(err);
+        mResult->appendMessage(resultMessage.str());
+        return err;
+    }
+
+private:
+    struct Stream {
+        AudioSinkBase   *sink = nullptr;
+        StreamHarness   *harness = nullptr;
+        SynthMarkResult  result;
+        HostThread       thread;
+        int32_t          sampleRate = kSynthmarkSampleRate;
+        int32_t          framesPerBurst = 0;
+        int32_t          numSeconds = 0;
+        int32_t          err = SYNTHMARK_RESULT_SUCCESS;
+    };
+
+    static void *streamProc(void *arg) {
+        Stream *stream = (Stream *) arg;
+        stream->err = stream->harness->runTest(stream->sampleRate,
+                                               stream->framesPerBurst,
+                                               stream->numSeconds);
+        return NULL;
+    }
+
+    /**
+     * @return a sink paced like the one passed to the constructor, on the next CPU if pinned
+     */
+    VirtualAudioSink *createSink(int32_t streamIndex) {
+        VirtualAudioSink *sink = new VirtualAudioSink();
+        sink->setTimingModel(mPacedSink->getTimingModel());
+        sink->setRandomCallbackSizes(mPacedSink->isRandomCallbackSizes());
+        sink->setDefaultBufferSizeInBursts(mPacedSink->getDefaultBufferSizeInBursts());
+        int cpu = mPacedSink->getRequestedCpu();
+        int cpuCount = HostTools::getCpuCount();
+        if (cpu != SYNTHMARK_CPU_UNSPECIFIED && cpuCount > 0) {
+            cpu = (cpu + streamIndex) % cpuCount;
+        }
+        sink->setRequestedCpu(cpu);
+        return sink;
+    }
+
+    /**
+     * Spread the voice counts evenly from mNumVoices to mNumVoicesHigh.
+     */
+    int32_t getStreamVoices(int32_t streamIndex) const {
+        if (mNumStreams < 2 || mNumVoicesHigh <= mNumVoices) {
+            return mNumVoices;
+        }
+        return mNumVoices + ((mNumVoicesHigh - mNumVoices) * streamIndex) / (mNumStreams - 1);
+    }
+
+    void configure(StreamHarness *harness, int32_t numVoices) {
+        harness->setNumVoices(numVoices);
+        copyParametersTo(harness);
+    }
+
+    VirtualAudioSink *mPacedSink = nullptr;
+    int32_t           mNumStreams = 2;
+};
+
+#endif // SYNTHMARK_MULTI_STREAM_HARNESS_H
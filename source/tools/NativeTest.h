@@ -144,7 +144,7 @@ public:
         ParamInteger paramSamplingRate(PARAMS_SAMPLE_RATE, "Sample Rate", &vSamplingRates, 5);
 
         ParamInteger paramSamplesPerFrame(PARAMS_SAMPLES_PER_FRAME, "Samples per Frame",
-                                          SAMPLES_PER_FRAME, 1, 8);
+                                          SAMPLES_PER_FRAME, 1, kSynthmarkMaxChannels);
         ParamInteger paramFramesPerRender(PARAMS_FRAMES_PER_RENDER, "Frames per Render",
                                           kSynthmarkFramesPerRender, 1, 8);
 
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_NOTE_EVENT_GENERATOR_H
+#define SYNTHMARK_NOTE_EVENT_GENERATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "HostTools.h"
+#include "NoteEventQueue.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+#include "SynthTools.h"
+
+constexpr int32_t kNoteEventMaxProducers = 16;
+
+/**
+ * Control threads that send timestamped note events to the render thread,
+ * like MIDI input or a user interface would.
+ *
+ * Each thread retriggers voices at a steady rate, alternating note on and note off.
+ * The threads run at normal priority so they can be preempted by the audio thread.
+ */
+class NoteEventGenerator
+{
+public:
+    NoteEventGenerator() {}
+
+    ~NoteEventGenerator() {
+        stop();
+    }
+
+    /**
+     * @param eventsPerSecond rate for each thread
+     * @param numVoices events are sent to voices 0 to numVoices - 1
+     */
+    int32_t start(NoteEventQueueBase *queue, int32_t numProducers,
+                  int32_t eventsPerSecond, int32_t numVoices) {
+        if (numProducers < 1 || numProducers > kNoteEventMaxProducers
+                || eventsPerSecond < 1 || numVoices < 1) {
+            return SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+        }
+        stop();
+        mQueue = queue;
+        mPeriodNanos = SYNTHMARK_NANOS_PER_SECOND / eventsPerSecond;
+        mNumVoices = numVoices;
+        mStopRequested.store(false);
+        mPostedCount.store(0);
+        mDroppedCount.store(0);
+        mProducers = std::vector<Producer>(numProducers);
+        for (int32_t i = 0; i < numProducers; i++) {
+            Producer &producer = mProducers[i];
+            producer.owner = this;
+            producer.random.setSeed(PseudoRandom::kDefaultSeed + i);
+            if (producer.thread.start(producerProc, &producer) != 0) {
+                stop();
+                return SYNTHMARK_RESULT_THREAD_FAILURE;
+            }
+        }
+        return SYNTHMARK_RESULT_SUCCESS;
+    }
+
+    void stop() {
+        mStopRequested.store(true);
+        for (Producer &producer : mProducers) {
+            producer.thread.join();
+        }
+        mProducers.clear();
+    }
+
+    int64_t getPostedCount() const {
+        return mPostedCount.load();
+    }
+
+    int64_t getDroppedCount() const {
+        return mDroppedCount.load();
+    }
+
+private:
+    struct Producer {
+        NoteEventGenerator *owner = nullptr;
+        HostThread          thread;
+        PseudoRandom        random;
+    };
+
+    void produce(Producer *producer) {
+        std::vector<bool> isOn(mNumVoices, false);
+        int64_t nextTime = HostTools::getNanoTime();
+        while (!mStopRequested.load(std::memory_order_relaxed)) {
+            nextTime += mPeriodNanos;
+            HostTools::sleepUntilNanoTime(nextTime);
+            NoteEvent event;
+            event.voiceIndex = (int32_t) (producer->random.nextRandomInteger() % mNumVoices);
+            event.type = isOn[event.voiceIndex] ? NoteEventType::NoteOff : NoteEventType::NoteOn;
+            isOn[event.voiceIndex] = !isOn[event.voiceIndex];
+            event.pitch = 48.0f + (float) (producer->random.nextRandomInteger() % 24);
+            event.velocity = 1.0f;
+            event.timestampNanos = HostTools::getNanoTime();
+            if (mQueue->push(event)) {
+                mPostedCount++;
+            } else {
+                mDroppedCount++;
+            }
+        }
+    }
+
+    static void *producerProc(void *arg) {
+        Producer *producer = (Producer *) arg;
+        producer->owner->produce(producer);
+        return NULL;
+    }
+
+    NoteEventQueueBase   *mQueue = nullptr;
+    int64_t               mPeriodNanos = 0;
+    int32_t               mNumVoices = 1;
+    std::vector<Producer> mProducers;
+    std::atomic<bool>     mStopRequested{false};
+    std::atomic<int64_t>  mPostedCount{0};
+    std::atomic<int64_t>  mDroppedCount{0};
+};
+
+#endif // SYNTHMARK_NOTE_EVENT_GENERATOR_H
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_NOTE_EVENT_QUEUE_H
+#define SYNTHMARK_NOTE_EVENT_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+constexpr int32_t kNoteEventQueueCapacity = 1024;
+
+// Use as the voiceIndex to let the synthesizer pick a voice for the pitch.
+constexpr int32_t kNoteEventAnyVoice = -1;
+
+enum class NoteEventType : int32_t {
+    NoteOn,
+    NoteOff,
+};
+
+/**
+ * Note change sent from a control thread to the render thread.
+ */
+struct NoteEvent {
+    int64_t       timestampNanos; // when the event was generated
+    NoteEventType type;
+    int32_t       voiceIndex;     // or kNoteEventAnyVoice
+    float         pitch;          // MIDI pitch, also finds the voice for kNoteEventAnyVoice
+    float         velocity;       // 0.0 to 1.0, used by NoteOn
+};
+
+/**
+ * Ways to pass note events to the render thread.
+ */
+enum class NoteQueueType {
+    LockFree, // many producers, one consumer, never blocks the consumer
+    Mutex,    // guarded by a mutex, for comparison
+};
+
+inline const char *noteQueueTypeToString(NoteQueueType type) {
+    switch (type) {
+        case NoteQueueType::LockFree: return "lockfree";
+        case NoteQueueType::Mutex: return "mutex";
+    }
+    return "unknown";
+}
+
+/**
+ * Bounded queue of note events with any number of writer threads
+ * and a single reader thread.
+ */
+class NoteEventQueueBase
+{
+public:
+    virtual ~NoteEventQueueBase() = default;
+
+    /**
+     * Called by any control thread.
+     * @return false if the queue was full and the event was dropped
+     */
+    virtual bool push(const NoteEvent &event) = 0;
+
+    /**
+     * Only call from the render thread.
+     * @return false if the queue was empty
+     */
+    virtual bool pop(NoteEvent *event) = 0;
+
+    static NoteEventQueueBase *create(NoteQueueType type, int32_t capacity);
+};
+
+/**
+ * Array of slots, each with a sequence number that says whether it is
+ * ready to be written or read. The reader never waits or takes a lock.
+ * A writer claims a slot with a compare-and-swap so a full queue can be
+ * detected without disturbing the reader; it only retries when another
+ * writer claimed the same slot first.
+ * The capacity is rounded up to a power of two so the indices can simply wrap.
+ */
+class LockFreeNoteEventQueue : public NoteEventQueueBase
+{
+public:
+    explicit LockFreeNoteEventQueue(int32_t capacity) {
+        int32_t actual = 1;
+        while (actual < capacity) {
+            actual <<= 1;
+        }
+        mSlots = std::vector<Slot>(actual);
+        for (int32_t i = 0; i < actual; i++) {
+            mSlots[i].sequence.store((uint32_t) i, std::memory_order_relaxed);
+        }
+        mMask = (uint32_t) (actual - 1);
+    }
+
+    bool push(const NoteEvent &event) override {
+        uint32_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = mSlots[writeIndex & mMask];
+            uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int32_t difference = (int32_t) (sequence - writeIndex);
+            if (difference == 0) {
+                if (mWriteIndex.compare_exchange_weak(writeIndex, writeIndex + 1,
+                                                      std::memory_order_relaxed)) {
+                    slot.event = event;
+                    slot.sequence.store(writeIndex + 1, std::memory_order_release);
+                    return true;
+                }
+                // writeIndex was updated by the failed exchange.
+            } else if (difference < 0) {
+                return false; // full, the reader has not freed this slot
+            } else {
+                writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(NoteEvent *event) override {
+        Slot &slot = mSlots[mReadIndex & mMask];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != mReadIndex + 1) {
+            return false; // empty, or the writer has not finished
+        }
+        *event = slot.event;
+        slot.sequence.store(mReadIndex + mMask + 1, std::memory_order_release);
+        mReadIndex++;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence{0};
+        NoteEvent             event;
+    };
+
+    std::vector<Slot>     mSlots;
+    uint32_t              mMask = 0;
+    std::atomic<uint32_t> mWriteIndex{0};
+    uint32_t              mReadIndex = 0; // only touched by the reader
+};
+
+/**
+ * Ring of events guarded by a mutex.
+ * The render thread has to wait if a control thread is preempted while
+ * holding the lock, which shows up as priority inversion.
+ */
+class MutexNoteEventQueue : public NoteEventQueueBase
+{
+public:
+    explicit MutexNoteEventQueue(int32_t capacity)
+            : mEvents(capacity) {}
+
+    bool push(const NoteEvent &event) override {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mCount == (int32_t) mEvents.size()) {
+            return false;
+        }
+        mEvents[(mHead + mCount) % mEvents.size()] = event;
+        mCount++;
+        return true;
+    }
+
+    bool pop(NoteEvent *event) override {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mCount == 0) {
+            return false;
+        }
+        *event = mEvents[mHead];
+        mHead = (mHead + 1) % mEvents.size();
+        mCount--;
+        return true;
+    }
+
+private:
+    std::mutex             mLock;
+    std::vector<NoteEvent> mEvents;
+    int32_t                mHead = 0;
+    int32_t                mCount = 0;
+};
+
+inline NoteEventQueueBase *NoteEventQueueBase::create(NoteQueueType type, int32_t capacity) {
+    switch (type) {
+        case NoteQueueType::LockFree:
+            return new LockFreeNoteEventQueue(capacity);
+        case NoteQueueType::Mutex:
+            return new MutexNoteEventQueue(capacity);
+    }
+    return nullptr;
+}
+
+#endif // SYNTHMARK_NOTE_EVENT_QUEUE_H
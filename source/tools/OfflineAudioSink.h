@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_OFFLINE_AUDIO_SINK_H
+#define SYNTHMARK_OFFLINE_AUDIO_SINK_H
+
+#include <cstdint>
+
+#include "AudioSinkBase.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+
+/**
+ * An audio sink that consumes each burst as soon as it is rendered.
+ * The callback runs on the calling thread with no sleeps, no thread
+ * promotion and no CPU governor hints. So the render loop only measures
+ * the cost of the DSP.
+ */
+class OfflineAudioSink : public AudioSinkBase
+{
+public:
+    OfflineAudioSink() {}
+
+    virtual ~OfflineAudioSink() {
+        delete[] mBurstBuffer;
+    }
+
+    int32_t open(int32_t sampleRate, int32_t samplesPerFrame,
+            int32_t framesPerBurst) override {
+        int32_t result = AudioSinkBase::open(sampleRate, samplesPerFrame, framesPerBurst);
+        if (result < 0) {
+            return result;
+        }
+        delete[] mBurstBuffer;
+        mBurstBuffer = new float[samplesPerFrame * framesPerBurst];
+        return result;
+    }
+
+    virtual int32_t start() override {
+        setFramesWritten(0);
+        return 0;
+    }
+
+    virtual int32_t stop() override {
+        return 0;
+    }
+
+    virtual int32_t close() override {
+        delete[] mBurstBuffer;
+        mBurstBuffer = nullptr;
+        return 0;
+    }
+
+    /**
+     * Render bursts back to back until the callback says we are done.
+     */
+    virtual int32_t runCallbackLoop() override {
+        int32_t result = SYNTHMARK_RESULT_SUCCESS;
+        IAudioSinkCallback::Result callbackResult
+                = IAudioSinkCallback::Result::Continue;
+        while (callbackResult == IAudioSinkCallback::Result::Continue) {
+            callbackResult = fireCallback(mBurstBuffer, mFramesPerBurst);
+            if (callbackResult == IAudioSinkCallback::Result::Continue) {
+                setFramesWritten(getFramesWritten() + mFramesPerBurst);
+            } else if (callbackResult != IAudioSinkCallback::Result::Finished) {
+                result = callbackResult;
+            }
+        }
+        return result;
+    }
+
+    virtual void setDefaultBufferSizeInBursts(int32_t numBursts) override {
+        (void) numBursts;
+    }
+
+    // There is no buffer to fill. Each burst is consumed immediately.
+    virtual int32_t setBufferSizeInFrames(int32_t numFrames) override {
+        (void) numFrames;
+        return mFramesPerBurst;
+    }
+
+    virtual int32_t getBufferSizeInFrames() override {
+        return mFramesPerBurst;
+    }
+
+    virtual int32_t getBufferCapacityInFrames() override {
+        return mFramesPerBurst;
+    }
+
+private:
+    float *mBurstBuffer = nullptr;
+};
+
+#endif // SYNTHMARK_OFFLINE_AUDIO_SINK_H
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_PERF_COUNTER_ANALYZER_H
+#define SYNTHMARK_PERF_COUNTER_ANALYZER_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "SynthMark.h"
+
+enum class PerfCounter : int32_t {
+    Cycles = 0,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+    TaskClock,       // nanoseconds
+    ContextSwitches,
+    PageFaults,
+    Count
+};
+
+constexpr int32_t kPerfCounterCount = (int32_t) PerfCounter::Count;
+
+/**
+ * Count CPU events on the render thread during each burst using perf_event_open().
+ *
+ * The counters are opened as one group on the first call to markEntry() so that
+ * they follow the render thread. They are read together at entry and exit of each
+ * burst so the counts include only the render. Counters that the kernel or the CPU
+ * does not provide are skipped. Only user space is counted if the kernel does not
+ * allow more, see /proc/sys/kernel/perf_event_paranoid.
+ *
+ * Reading the counters costs two system calls per burst, so it must be enabled with
+ * setEnabled(). When it is disabled, or on other operating systems, nothing is measured.
+ */
+class PerfCounterAnalyzer
+{
+public:
+    PerfCounterAnalyzer() {
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            mFds[i] = -1;
+            mSlots[i] = -1;
+        }
+        reset();
+    }
+
+    virtual ~PerfCounterAnalyzer() {
+        close();
+    }
+
+    static void setEnabled(bool enabled) {
+        mEnabled = enabled;
+    }
+
+    static bool isEnabled() {
+        return mEnabled;
+    }
+
+    static const char *counterToString(PerfCounter counter) {
+        switch (counter) {
+            case PerfCounter::Cycles: return "cycles";
+            case PerfCounter::Instructions: return "instructions";
+            case PerfCounter::CacheMisses: return "cache.misses";
+            case PerfCounter::BranchMisses: return "branch.misses";
+            case PerfCounter::TaskClock: return "task.clock";
+            case PerfCounter::ContextSwitches: return "context.switches";
+            case PerfCounter::PageFaults: return "page.faults";
+            case PerfCounter::Count: break;
+        }
+        return "?";
+    }
+
+    void reset() {
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            mTotals[i] = 0;
+        }
+        mBurstCount = 0;
+        mVoiceBurstCount = 0;
+        mUnscheduledCount = 0;
+        mEntryValid = false;
+        mLastValid = false;
+    }
+
+    /**
+     * Called on the render thread right before the render.
+     */
+    void markEntry() {
+        if (!mEnabled) {
+            return;
+        }
+        if (!mOpenAttempted) {
+            open();
+        }
+        mEntryValid = readGroup(mEntry);
+    }
+
+    /**
+     * Called on the render thread right after the render.
+     * @param numVoices voices rendered in this burst
+     */
+    void markExit(int32_t numVoices) {
+        mLastValid = false;
+        if (!mEntryValid) {
+            return;
+        }
+        mEntryValid = false;
+        GroupValues exitValues;
+        if (!readGroup(exitValues)) {
+            return;
+        }
+        // A group that was not on the CPU for the whole burst undercounts.
+        if (exitValues.timeRunning - mEntry.timeRunning
+                != exitValues.timeEnabled - mEntry.timeEnabled) {
+            mUnscheduledCount++;
+            return;
+        }
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            int32_t slot = mSlots[i];
+            if (slot >= 0) {
+                mLast[i] = exitValues.values[slot] - mEntry.values[slot];
+                mTotals[i] += mLast[i];
+            }
+        }
+        mLastValid = true;
+        mBurstCount++;
+        mVoiceBurstCount += numVoices;
+    }
+
+    /**
+     * Close the counters but keep the totals for dump().
+     * They will be opened again by the next markEntry().
+     */
+    void close() {
+#if defined(__linux__)
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            if (mFds[i] >= 0) {
+                ::close(mFds[i]);
+            }
+            mFds[i] = -1;
+        }
+#endif
+        mLeaderFd = -1;
+        mOpenAttempted = false;
+    }
+
+    bool isAvailable(PerfCounter counter) const {
+        return mSlots[(int32_t) counter] >= 0;
+    }
+
+    int64_t getTotal(PerfCounter counter) const {
+        return mTotals[(int32_t) counter];
+    }
+
+    int64_t getBurstCount() const {
+        return mBurstCount;
+    }
+
+    /**
+     * @return true if the last burst was counted completely
+     */
+    bool hasLastBurst() const {
+        return mLastValid;
+    }
+
+    int64_t getLastBurst(PerfCounter counter) const {
+        return mLast[(int32_t) counter];
+    }
+
+    std::string dump() {
+        std::stringstream result;
+        if (!mEnabled) {
+            return result.str();
+        }
+        result << std::endl << "Performance Counters" << std::endl;
+        if (mNumSlots == 0) {
+            result << "perf.available = 0" << std::endl;
+            result << "perf.error = " << mErrorText << std::endl;
+            return result.str();
+        }
+        result << "perf.available = 1" << std::endl;
+        result << "perf.user.only = " << (mUserOnly ? 1 : 0) << std::endl;
+        std::string unavailable;
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            if (mSlots[i] < 0) {
+                unavailable += std::string(" ") + counterToString((PerfCounter) i);
+            }
+        }
+        if (!unavailable.empty()) {
+            result << "perf.unavailable =" << unavailable << std::endl;
+        }
+        result << "perf.bursts = " << mBurstCount << std::endl;
+        result << "perf.unscheduled.bursts = " << mUnscheduledCount << std::endl;
+        if (mBurstCount == 0) {
+            return result.str();
+        }
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            if (mSlots[i] >= 0) {
+                result << "perf." << counterToString((PerfCounter) i) << ".per.burst = "
+                       << ((double) mTotals[i] / mBurstCount) << std::endl;
+            }
+        }
+        if (isAvailable(PerfCounter::Cycles) && isAvailable(PerfCounter::Instructions)
+                && getTotal(PerfCounter::Cycles) > 0) {
+            result << "perf.ipc = " << ((double) getTotal(PerfCounter::Instructions)
+                                        / getTotal(PerfCounter::Cycles)) << std::endl;
+        }
+        if (mVoiceBurstCount > 0) {
+            // Normalized by the voices rendered so runs with different loads can be compared.
+            const PerfCounter perVoice[] = {PerfCounter::Cycles, PerfCounter::Instructions,
+                                            PerfCounter::CacheMisses, PerfCounter::BranchMisses};
+            for (PerfCounter counter : perVoice) {
+                if (isAvailable(counter)) {
+                    result << "perf." << counterToString(counter) << ".per.voice.burst = "
+                           << ((double) getTotal(counter) / mVoiceBurstCount) << std::endl;
+                }
+            }
+        }
+        return result.str();
+    }
+
+private:
+    struct GroupValues {
+        uint64_t timeEnabled = 0;
+        uint64_t timeRunning = 0;
+        int64_t  values[kPerfCounterCount] = {};
+    };
+
+#if defined(__linux__)
+    static int openEvent(uint32_t type, uint64_t config, int groupFd, bool userOnly) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = (groupFd < 0) ? 1 : 0; // the leader starts the whole group
+        attr.exclude_kernel = userOnly ? 1 : 0;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP
+                | PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // Count this thread on any CPU.
+        return (int) syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    void open() {
+        static const struct {
+            PerfCounter counter;
+            uint32_t    type;
+            uint64_t    config;
+        } kEvents[] = {
+            {PerfCounter::Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PerfCounter::Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PerfCounter::CacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PerfCounter::BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PerfCounter::TaskClock, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            {PerfCounter::ContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+            {PerfCounter::PageFaults, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        };
+        mOpenAttempted = true;
+        mUserOnly = false;
+        mNumSlots = 0;
+        for (int32_t i = 0; i < kPerfCounterCount; i++) {
+            mSlots[i] = -1;
+        }
+        int firstError = 0;
+        for (const auto &event : kEvents) {
+            int fd = openEvent(event.type, event.config, mLeaderFd, mUserOnly);
+            if (fd < 0 && (errno == EACCES || errno == EPERM) && !mUserOnly) {
+                // Not allowed to count the kernel. Count user space from now on.
+                mUserOnly = true;
+                fd = openEvent(event.type, event.config, mLeaderFd, mUserOnly);
+            }
+            if (fd < 0) {
+                if (firstError == 0) {
+                    firstError = errno;
+                }
+                continue; // skip counters this machine does not have
+            }
+            int32_t index = (int32_t) event.counter;
+            mFds[index] = fd;
+            mSlots[index] = mNumSlots++;
+            if (mLeaderFd < 0) {
+                mLeaderFd = fd;
+            }
+        }
+        if (mLeaderFd < 0) {
+            mErrorText = strerror(firstError);
+            return;
+        }
+        ioctl(mLeaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(mLeaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    bool readGroup(GroupValues &group) {
+        if (mLeaderFd < 0) {
+            return false;
+        }
+        // Layout from PERF_FORMAT_GROUP with both times.
+        uint64_t buffer[3 + kPerfCounterCount];
+        ssize_t numBytes = read(mLeaderFd, buffer, sizeof(buffer));
+        if (numBytes < (ssize_t) ((3 + mNumSlots) * sizeof(uint64_t))
+                || buffer[0] != (uint64_t) mNumSlots) {
+            return false;
+        }
+        group.timeEnabled = buffer[1];
+        group.timeRunning = buffer[2];
+        for (int32_t i = 0; i < mNumSlots; i++) {
+            group.values[i] = (int64_t) buffer[3 + i];
+        }
+        return true;
+    }
+#else
+    void open() {
+        mOpenAttempted = true;
+        mErrorText = "perf_event_open() is only available on Linux";
+    }
+
+    bool readGroup(GroupValues &group) {
+        (void) group;
+        return false;
+    }
+#endif
+
+    static bool  mEnabled;
+
+    int          mFds[kPerfCounterCount];
+    int32_t      mSlots[kPerfCounterCount]; // position of each counter in a group read
+    int32_t      mNumSlots = 0;
+    int          mLeaderFd = -1;
+    bool         mOpenAttempted = false;
+    bool         mUserOnly = false;
+    std::string  mErrorText;
+
+    GroupValues  mEntry;
+    bool         mEntryValid = false;
+    int64_t      mTotals[kPerfCounterCount];
+    int64_t      mLast[kPerfCounterCount] = {};
+    bool         mLastValid = false;
+    int64_t      mBurstCount = 0;
+    int64_t      mVoiceBurstCount = 0;
+    int64_t      mUnscheduledCount = 0;
+};
+
+#endif // SYNTHMARK_PERF_COUNTER_ANALYZER_H
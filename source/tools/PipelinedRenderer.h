@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_PIPELINED_RENDERER_H
+#define SYNTHMARK_PIPELINED_RENDERER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+#include "AudioSinkBase.h"
+#include "HostTools.h"
+#include "SyncPrimitives.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+
+// This may be increased without invalidating the benchmark.
+constexpr int kPipelineMaxDepth = 16;
+
+// Must be a power of 2.
+constexpr int kPipelineCommandCapacity = 64;
+
+/**
+ * Render bursts ahead of time on a helper thread.
+ *
+ * The helper keeps up to "depth" bursts ready. The audio callback only copies
+ * out the oldest one. This absorbs render spikes shorter than the lookahead,
+ * but it adds depth bursts of latency. If the helper falls behind then
+ * the callback outputs silence and counts an underrun.
+ *
+ * The callback never locks. It passes commands to the helper through a queue
+ * and wakes it with a semaphore whose post() does not block.
+ * The render proc should apply them before rendering the next burst.
+ */
+class PipelinedRenderer
+{
+public:
+    /**
+     * Renders numFrames of interleaved audio. Returns a negative error to stop.
+     */
+    typedef std::function<int32_t(float *buffer, int32_t numFrames)> RenderProc;
+
+    ~PipelinedRenderer() {
+        stop();
+        delete mThread;
+    }
+
+    /**
+     * Start the helper thread and wait until the pipeline is full.
+     */
+    int32_t start(int32_t depth, int32_t framesPerBurst, int32_t channelCount,
+                  RenderProc renderProc) {
+        if (depth < 1 || depth > kPipelineMaxDepth) {
+            return -1;
+        }
+        mDepth = depth;
+        mFramesPerBurst = framesPerBurst;
+        mSamplesPerBurst = framesPerBurst * channelCount;
+        mChannelCount = channelCount;
+        mRenderProc = renderProc;
+        mSlots.assign(depth * mSamplesPerBurst, 0.0f);
+        mWriteCount.store(0);
+        mReadCount.store(0);
+        mCommandWriteCount.store(0);
+        mCommandReadCount.store(0);
+        mReadOffset = 0;
+        mUnderrunCount = 0;
+        mRenderNanos = 0;
+        mRenderError.store(0);
+        mEnabled.store(true);
+
+        // A HostThread cannot be restarted so use a new one for each run.
+        delete mThread;
+        mThread = new HostThread();
+        if (mThread->start(threadProcWrapper, this) != 0) {
+            mEnabled.store(false);
+            return SYNTHMARK_RESULT_THREAD_FAILURE;
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mCondition.wait(lock, [this] {
+            return getReadyBursts() == mDepth || mRenderError.load() < 0;
+        });
+        mStartTimeNanos = HostTools::getNanoTime();
+        return mRenderError.load();
+    }
+
+    void stop() {
+        if (mEnabled.exchange(false)) {
+            mSlotFreed.post();
+            mThread->join();
+            mStopTimeNanos = HostTools::getNanoTime();
+        }
+    }
+
+    /**
+     * Copy out any number of frames. Called from the audio callback.
+     * @return 0 or a negative error from the render proc
+     */
+    int32_t read(float *output, int32_t numFrames) {
+        int32_t error = mRenderError.load();
+        if (error < 0) {
+            return error;
+        }
+        bool consumed = false;
+        while (numFrames > 0) {
+            if (getReadyBursts() == 0) {
+                // The helper is late so play silence.
+                memset(output, 0, numFrames * mChannelCount * sizeof(float));
+                mUnderrunCount++;
+                break;
+            }
+            int64_t readCount = mReadCount.load(std::memory_order_relaxed);
+            const float *slot = &mSlots[(readCount % mDepth) * mSamplesPerBurst];
+            int32_t framesLeft = mFramesPerBurst - mReadOffset;
+            int32_t framesToCopy = (numFrames < framesLeft) ? numFrames : framesLeft;
+            memcpy(output, &slot[mReadOffset * mChannelCount],
+                   framesToCopy * mChannelCount * sizeof(float));
+            output += framesToCopy * mChannelCount;
+            numFrames -= framesToCopy;
+            mReadOffset += framesToCopy;
+            if (mReadOffset == mFramesPerBurst) {
+                mReadOffset = 0;
+                mReadCount.store(readCount + 1, std::memory_order_release);
+                consumed = true;
+            }
+        }
+        if (consumed) {
+            // Wake the helper so it can fill the free slot.
+            mSlotFreed.post();
+        }
+        return 0;
+    }
+
+    /**
+     * Queue a command for the render proc. Called from the audio callback.
+     * @return false if the queue is full
+     */
+    bool postCommand(int32_t command) {
+        uint32_t writeCount = mCommandWriteCount.load(std::memory_order_relaxed);
+        if (writeCount - mCommandReadCount.load(std::memory_order_acquire)
+                >= kPipelineCommandCapacity) {
+            return false;
+        }
+        mCommands[writeCount & (kPipelineCommandCapacity - 1)] = command;
+        mCommandWriteCount.store(writeCount + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Get the oldest command. Called from the render proc.
+     * @return false if there are no commands
+     */
+    bool popCommand(int32_t *command) {
+        uint32_t readCount = mCommandReadCount.load(std::memory_order_relaxed);
+        if (readCount == mCommandWriteCount.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *command = mCommands[readCount & (kPipelineCommandCapacity - 1)];
+        mCommandReadCount.store(readCount + 1, std::memory_order_release);
+        return true;
+    }
+
+    int32_t getDepth() const {
+        return mDepth;
+    }
+
+    /**
+     * @return number of callbacks that found the pipeline empty
+     */
+    int32_t getUnderrunCount() const {
+        return mUnderrunCount;
+    }
+
+    /**
+     * @return fraction of the run that the helper thread spent rendering
+     */
+    double getRenderUtilization() const {
+        int64_t elapsed = mStopTimeNanos - mStartTimeNanos;
+        return (elapsed > 0) ? ((double) mRenderNanos / elapsed) : 0.0;
+    }
+
+private:
+
+    int32_t getReadyBursts() const {
+        return (int32_t) (mWriteCount.load(std::memory_order_acquire)
+                          - mReadCount.load(std::memory_order_acquire));
+    }
+
+    void renderLoop() {
+        // Run at the same priority as the callback. This may fail if we are not root.
+        mThread->promote(SYNTHMARK_THREAD_PRIORITY_DEFAULT);
+        while (mEnabled.load()) {
+            if (getReadyBursts() == mDepth) {
+                // Posts may pile up while rendering so check again after each one.
+                mSlotFreed.wait();
+                continue;
+            }
+            int64_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+            float *slot = &mSlots[(writeCount % mDepth) * mSamplesPerBurst];
+            int64_t startTime = HostTools::getNanoTime();
+            int32_t result = mRenderProc(slot, mFramesPerBurst);
+            mRenderNanos += HostTools::getNanoTime() - startTime;
+            if (result < 0) {
+                mRenderError.store(result);
+            }
+            mWriteCount.store(writeCount + 1, std::memory_order_release);
+            {
+                // Tell start() when the pipeline is full. Only start() waits on this.
+                std::lock_guard<std::mutex> lock(mLock);
+                mCondition.notify_all();
+            }
+            if (result < 0) {
+                break;
+            }
+        }
+    }
+
+    static void * threadProcWrapper(void *arg) {
+        PipelinedRenderer *renderer = (PipelinedRenderer *) arg;
+        renderer->renderLoop();
+        return NULL;
+    }
+
+    int32_t                 mDepth = 0;
+    int32_t                 mFramesPerBurst = 0;
+    int32_t                 mSamplesPerBurst = 0;
+    int32_t                 mChannelCount = 0;
+    RenderProc              mRenderProc;
+    std::vector<float>      mSlots;
+
+    std::atomic<int64_t>    mWriteCount{0};  // bursts rendered by the helper
+    std::atomic<int64_t>    mReadCount{0};   // bursts consumed by the callback
+    int32_t                 mReadOffset = 0; // frames already copied from the current burst
+    int32_t                 mUnderrunCount = 0;
+    int64_t                 mRenderNanos = 0;
+    int64_t                 mStartTimeNanos = 0;
+    int64_t                 mStopTimeNanos = 0;
+    int32_t                 mCommands[kPipelineCommandCapacity];
+    std::atomic<uint32_t>   mCommandWriteCount{0};
+    std::atomic<uint32_t>   mCommandReadCount{0};
+    std::atomic<int32_t>    mRenderError{0};
+    std::atomic<bool>       mEnabled{false};
+
+    HostThread             *mThread = NULL;
+    HostSemaphore           mSlotFreed;      // posted by the callback, waited on by the helper
+    std::mutex              mLock;
+    std::condition_variable mCondition;
+};
+
+#endif // SYNTHMARK_PIPELINED_RENDERER_H
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_PLUGIN_HOST_HARNESS_H
+#define SYNTHMARK_PLUGIN_HOST_HARNESS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+#include "AudioSinkBase.h"
+#include "HostTools.h"
+#include "LatencyHistogram.h"
+#include "SynthMark.h"
+#include "synth/Synthesizer.h"
+#include "tools/LogTool.h"
+#include "tools/RenderThreadPool.h"
+#include "tools/TestHarnessBase.h"
+#include "TestHarnessParameters.h"
+
+constexpr int32_t kPluginHostMaxInstances = 1024;
+
+/**
+ * Render many small synthesizers, like plugins in a host, for each burst.
+ * They are spread across the callback thread and a fixed pool of worker threads.
+ * All instances must finish before the burst is mixed and written.
+ */
+class PluginPoolHarness : public TestHarnessBase {
+public:
+    PluginPoolHarness(AudioSinkBase *audioSink,
+                      SynthMarkResult *result,
+                      LogTool *logTool = NULL)
+            : TestHarnessBase(audioSink, result, logTool)
+    {
+        mTestName = "PluginPool";
+    }
+
+    virtual ~PluginPoolHarness() {
+        deleteInstances();
+    }
+
+    void setNumInstances(int32_t numInstances) {
+        mNumInstances = numInstances;
+    }
+
+    /**
+     * @param numThreads threads that render, including the callback thread
+     */
+    void setNumThreads(int32_t numThreads) {
+        mNumThreads = numThreads;
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        int32_t err = open(sampleRate, mChannelCount,
+                           kSynthmarkFramesPerRender, framesPerBurst);
+        if (err) {
+            return err;
+        }
+        err = mPool.start(mNumThreads - 1, [this](int32_t taskIndex) {
+            renderInstance(taskIndex);
+        });
+        if (err == 0) {
+            err = measure(numSeconds);
+        }
+        mPool.stop();
+        close();
+        return err;
+    };
+
+    int32_t open(int32_t sampleRate,
+                 int32_t samplesPerFrame,
+                 int32_t framesPerRender,
+                 int32_t framesPerBurst) override {
+        int32_t err = TestHarnessBase::open(sampleRate, samplesPerFrame,
+                                            framesPerRender, framesPerBurst);
+        if (err < 0) {
+            return err;
+        }
+        if (mNumInstances < 1 || mNumInstances > kPluginHostMaxInstances) {
+            mLogTool->log("ERROR in open, numInstances = %d not in [1, %d]\n",
+                          mNumInstances, kPluginHostMaxInstances);
+            return -1;
+        }
+        deleteInstances();
+        for (int32_t i = 0; i < mNumInstances; i++) {
+            Synthesizer *synth = new Synthesizer();
+            mInstances.push_back(synth);
+            if (synth->setup(sampleRate, getNumVoices(), mSampleType, mOversampling,
+                             samplesPerFrame) < 0) {
+                return -1;
+            }
+        }
+        // Callbacks may be up to two bursts when the sizes are random.
+        mSamplesPerInstance = 2 * framesPerBurst * samplesPerFrame;
+        mInstanceBuffers.assign(mNumInstances * mSamplesPerInstance, 0.0f);
+        mInstanceLatencies.assign(mNumInstances, 0);
+        return 0;
+    }
+
+    virtual void onEndMeasurement() override {
+        mUnderrunCount = mAudioSink->getUnderrunCount();
+        mResult->setResultCode(SYNTHMARK_RESULT_SUCCESS);
+    }
+
+    int32_t applyNotes(int32_t numVoices) override {
+        for (Synthesizer *synth : mInstances) {
+            if (numVoices == 0) {
+                synth->allNotesOff();
+            } else if (synth->notesOn(numVoices) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Render every instance on the pool then mix them.
+     */
+    void renderVoices(float *buffer, int32_t numFrames) override {
+        mBurstStartNanos = HostTools::getNanoTime();
+        mBurstFrames = numFrames;
+        mPool.run(mNumInstances);
+
+        int32_t numSamples = numFrames * mSamplesPerFrame;
+        float gain = 1.0f / mNumInstances;
+        memset(buffer, 0, numSamples * sizeof(float));
+        for (int32_t i = 0; i < mNumInstances; i++) {
+            const float *source = &mInstanceBuffers[i * mSamplesPerInstance];
+            for (int32_t n = 0; n < numSamples; n++) {
+                buffer[n] += gain * source[n];
+            }
+            mInstanceHistogram.record(mInstanceLatencies[i]);
+        }
+        mBurstHistogram.record(HostTools::getNanoTime() - mBurstStartNanos);
+    }
+
+    int32_t getUnderrunCount() const {
+        return mUnderrunCount;
+    }
+
+    /**
+     * @return time from the start of each burst until the instances were done and mixed
+     */
+    const LatencyHistogram &getBurstHistogram() const {
+        return mBurstHistogram;
+    }
+
+    /**
+     * @return time from the start of each burst until each instance finished rendering
+     */
+    const LatencyHistogram &getInstanceHistogram() const {
+        return mInstanceHistogram;
+    }
+
+private:
+    /**
+     * Called on a worker or the callback thread.
+     */
+    void renderInstance(int32_t instanceIndex) {
+        mInstances[instanceIndex]->render(&mInstanceBuffers[instanceIndex * mSamplesPerInstance],
+                                          mBurstFrames);
+        mInstanceLatencies[instanceIndex] = HostTools::getNanoTime() - mBurstStartNanos;
+    }
+
+    void deleteInstances() {
+        for (Synthesizer *synth : mInstances) {
+            delete synth;
+        }
+        mInstances.clear();
+    }
+
+    RenderThreadPool           mPool;
+    std::vector<Synthesizer *> mInstances;
+    std::vector<float>         mInstanceBuffers;
+    std::vector<int64_t>       mInstanceLatencies; // each entry is written by one task
+    LatencyHistogram           mBurstHistogram;
+    LatencyHistogram           mInstanceHistogram;
+    int32_t                    mNumInstances = 32;
+    int32_t                    mNumThreads = 1;
+    int32_t                    mSamplesPerInstance = 0;
+    int32_t                    mBurstFrames = 0;
+    int32_t                    mUnderrunCount = 0;
+    int64_t                    mBurstStartNanos = 0;
+};
+
+/**
+ * Run the plugin host with 1, 2, 4 ... up to the maximum number of render threads.
+ * For each thread count, estimate how many instances would fit in one burst
+ * from the 99th percentile of the time needed to render the burst.
+ */
+class PluginHostHarness : public TestHarnessParameters {
+
+public:
+    PluginHostHarness(AudioSinkBase *audioSink,
+                      SynthMarkResult *result,
+                      LogTool *logTool = nullptr)
+            : TestHarnessParameters(audioSink, result, logTool) {}
+
+    virtual ~PluginHostHarness() {}
+
+    const char *getName() const override {
+        return "PluginHost";
+    }
+
+    void setNumInstances(int32_t numInstances) {
+        mNumInstances = numInstances;
+    }
+
+    /**
+     * @param numThreads maximum threads that render, including the callback thread
+     */
+    void setMaxThreads(int32_t numThreads) {
+        mMaxThreads = numThreads;
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        int32_t err = SYNTHMARK_RESULT_SUCCESS;
+        std::stringstream resultMessage;
+        double burstMicros = (double) framesPerBurst * SYNTHMARK_MICROS_PER_SECOND / sampleRate;
+        double instancesFit = 0.0;
+        resultMessage << "plugin.instances = " << mNumInstances << std::endl;
+        resultMessage << "plugin.voices.per.instance = " << getNumVoices() << std::endl;
+        resultMessage << "burst.usec = " << burstMicros << std::endl;
+        int32_t numThreads = 1;
+        while (true) {
+            err = measureThreads(sampleRate, framesPerBurst, numSeconds, numThreads,
+                                 burstMicros, resultMessage, &instancesFit);
+            if (err != SYNTHMARK_RESULT_SUCCESS || numThreads >= mMaxThreads) {
+                break;
+            }
+            // Always finish with the maximum.
+            numThreads = std::min(numThreads * 2, mMaxThreads);
+        }
+        resultMessage << getName() << " = " << instancesFit << std::endl;
+        mResult->setTestName(getName());
+        mResult->setMeasurement(instancesFit);
+        mResult->setResultCode(err);
+        mResult->appendMessage(resultMessage.str());
+        return err;
+    }
+
+private:
+    int32_t measureThreads(int32_t sampleRate,
+                           int32_t framesPerBurst,
+                           int32_t numSeconds,
+                           int32_t numThreads,
+                           double burstMicros,
+                           std::stringstream &resultMessage,
+                           double *instancesFitPtr) {
+        SynthMarkResult result1;
+        PluginPoolHarness *harness = new PluginPoolHarness(mAudioSink, &result1, mLogTool);
+        harness->setNumInstances(mNumInstances);
+        harness->setNumThreads(numThreads);
+        harness->setNumVoices(getNumVoices());
+        copyParametersTo(harness);
+
+        mLogTool->log("---- PluginHost with %d instances on %d threads ----\n",
+                      mNumInstances, numThreads);
+        mAudioSink->setUnderrunCount(0);
+        int32_t err = harness->runTest(sampleRate, framesPerBurst, numSeconds);
+        if (err == SYNTHMARK_RESULT_SUCCESS) {
+            err = result1.getResultCode();
+        }
+        if (err == SYNTHMARK_RESULT_SUCCESS) {
+            double burstP99 = (double) harness->getBurstHistogram().getValueAtPercentile(0.99)
+                              / SYNTHMARK_NANOS_PER_MICROSECOND;
+            *instancesFitPtr = (burstP99 > 0.0) ? (mNumInstances * burstMicros / burstP99) : 0.0;
+            std::string prefix = "plugin.threads." + std::to_string(numThreads) + ".";
+            resultMessage << prefix << "underruns = " << harness->getUnderrunCount() << std::endl;
+            resultMessage << TimingAnalyzer::dumpPercentiles(prefix + "burst",
+                                                             harness->getBurstHistogram());
+            resultMessage << TimingAnalyzer::dumpPercentiles(prefix + "instance",
+                                                             harness->getInstanceHistogram());
+            resultMessage << prefix << "instances.fit = " << *instancesFitPtr << std::endl;
+        }
+        delete harness;
+        return err;
+    }
+
+    int32_t mNumInstances = 32;
+    int32_t mMaxThreads = 1;
+};
+
+#endif // SYNTHMARK_PLUGIN_HOST_HARNESS_H
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_RENDER_THREAD_POOL_H
+#define SYNTHMARK_RENDER_THREAD_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+#include "SyncPrimitives.h"
+
+constexpr int32_t kRenderThreadPoolMaxWorkers = 64;
+
+/**
+ * Run batches of independent tasks on a fixed pool of real-time worker threads.
+ *
+ * Each call to run() is one batch, for example all the plugins for one burst.
+ * Tasks are claimed by incrementing a shared atomic index, so the task queue
+ * needs no lock. The calling thread also claims tasks. Then it waits at a
+ * completion barrier until the last task is done.
+ * Idle workers wait for the next batch using the selected SyncStrategy.
+ */
+class RenderThreadPool
+{
+public:
+    /**
+     * Process one task. It may be called on any worker or the calling thread.
+     */
+    typedef std::function<void(int32_t taskIndex)> TaskProc;
+
+    ~RenderThreadPool() {
+        stop();
+    }
+
+    /**
+     * Start the workers. With zero workers the tasks run on the calling thread.
+     */
+    int32_t start(int32_t numWorkers, TaskProc taskProc) {
+        if (numWorkers < 0 || numWorkers > kRenderThreadPoolMaxWorkers) {
+            return -1;
+        }
+        stop();
+        mTaskProc = taskProc;
+        mNumTasks.store(0);
+        mNextTask.store(0);
+        mTasksRemaining.store(0);
+        mEnabled.store(true);
+        // A HostThread cannot be restarted so use new ones for each run.
+        for (int32_t i = 0; i < numWorkers; i++) {
+            Worker *worker = new Worker();
+            worker->pool = this;
+            mWorkers.push_back(worker);
+            if (worker->thread.start(threadProcWrapper, worker) != 0) {
+                stop();
+                return SYNTHMARK_RESULT_THREAD_FAILURE;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Select how the workers wait for a batch and the caller waits for the workers.
+     * Call this before start().
+     */
+    void setSyncStrategy(SyncStrategy strategy) {
+        mBatchCount.setStrategy(strategy);
+        mDone.setStrategy(strategy);
+    }
+
+    void stop() {
+        if (mEnabled.exchange(false)) {
+            mBatchCount.word().fetch_add(1);
+            mBatchCount.wakeAll();
+        }
+        for (Worker *worker : mWorkers) {
+            worker->thread.join();
+            delete worker;
+        }
+        mWorkers.clear();
+    }
+
+    /**
+     * Run tasks 0 to numTasks - 1 and return when they are all finished.
+     * Called from the audio callback.
+     */
+    void run(int32_t numTasks) {
+        if (numTasks <= 0) {
+            return;
+        }
+        mNumTasks.store(numTasks, std::memory_order_relaxed);
+        mTasksRemaining.store(numTasks, std::memory_order_relaxed);
+        mNextTask.store(0, std::memory_order_release);
+        if (!mWorkers.empty()) {
+            mBatchCount.word().fetch_add(1);
+            mBatchCount.wakeAll();
+        }
+        runTasks();
+        // Completion barrier. Whoever finishes the last task posts once.
+        mDone.wait();
+    }
+
+    int32_t getNumWorkers() const {
+        return (int32_t) mWorkers.size();
+    }
+
+private:
+
+    struct Worker {
+        RenderThreadPool *pool = nullptr;
+        HostThread        thread;
+    };
+
+    /**
+     * Claim and run tasks until none are left in the current batch.
+     */
+    void runTasks() {
+        while (true) {
+            int32_t taskIndex = mNextTask.fetch_add(1, std::memory_order_acq_rel);
+            if (taskIndex >= mNumTasks.load(std::memory_order_relaxed)) {
+                break;
+            }
+            mTaskProc(taskIndex);
+            if (mTasksRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                mDone.post();
+            }
+        }
+    }
+
+    void workerLoop(Worker *worker) {
+        // Run at the same priority as the callback. This may fail if we are not root.
+        worker->thread.promote(SYNTHMARK_THREAD_PRIORITY_DEFAULT);
+        int32_t batchesSeen = mBatchCount.word().load(std::memory_order_acquire);
+        while (true) {
+            mBatchCount.waitWhileEqual(batchesSeen);
+            batchesSeen = mBatchCount.word().load(std::memory_order_acquire);
+            if (!mEnabled.load()) {
+                break;
+            }
+            runTasks();
+        }
+    }
+
+    static void * threadProcWrapper(void *arg) {
+        Worker *worker = (Worker *) arg;
+        worker->pool->workerLoop(worker);
+        return NULL;
+    }
+
+    TaskProc                  mTaskProc;
+    std::vector<Worker *>     mWorkers;
+
+    std::atomic<int32_t>      mNumTasks{0};
+    std::atomic<int32_t>      mNextTask{0};
+    std::atomic<int32_t>      mTasksRemaining{0};
+    std::atomic<bool>         mEnabled{false};
+    SyncWord                  mBatchCount;
+    HostSemaphore             mDone;
+};
+
+#endif // SYNTHMARK_RENDER_THREAD_POOL_H
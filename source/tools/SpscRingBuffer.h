@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_SPSC_RING_BUFFER_H
+#define SYNTHMARK_SPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Lock-free ring buffer of samples with a single writer thread and a
+ * single reader thread. Neither side ever blocks. The capacity is rounded
+ * up to a power of two so the indices can simply wrap.
+ */
+class SpscRingBuffer
+{
+public:
+    SpscRingBuffer() {}
+
+    /**
+     * Allocate the buffer. This must not be called while another thread is using it.
+     * @return actual capacity in samples
+     */
+    int32_t setup(int32_t capacityInSamples) {
+        int32_t capacity = 1;
+        while (capacity < capacityInSamples) {
+            capacity <<= 1;
+        }
+        mBuffer.assign(capacity, 0.0f);
+        mMask = (uint32_t) (capacity - 1);
+        reset();
+        return capacity;
+    }
+
+    void reset() {
+        mWriteIndex.store(0);
+        mReadIndex.store(0);
+    }
+
+    int32_t getCapacity() const {
+        return (int32_t) mBuffer.size();
+    }
+
+    int32_t getFullSamples() const {
+        return (int32_t) (mWriteIndex.load(std::memory_order_acquire)
+                          - mReadIndex.load(std::memory_order_acquire));
+    }
+
+    int32_t getEmptySamples() const {
+        return getCapacity() - getFullSamples();
+    }
+
+    /**
+     * Write all of the samples or none of them. Only call from the writer thread.
+     * @return true if the samples were written
+     */
+    bool write(const float *buffer, int32_t numSamples) {
+        uint32_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        uint32_t readIndex = mReadIndex.load(std::memory_order_acquire);
+        if ((int32_t) (getCapacity() - (writeIndex - readIndex)) < numSamples) {
+            return false;
+        }
+        for (int32_t i = 0; i < numSamples; i++) {
+            mBuffer[(writeIndex + i) & mMask] = buffer[i];
+        }
+        mWriteIndex.store(writeIndex + numSamples, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Read up to maxSamples. Only call from the reader thread.
+     * @return number of samples read
+     */
+    int32_t read(float *buffer, int32_t maxSamples) {
+        uint32_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+        uint32_t writeIndex = mWriteIndex.load(std::memory_order_acquire);
+        int32_t numSamples = (int32_t) (writeIndex - readIndex);
+        if (numSamples > maxSamples) {
+            numSamples = maxSamples;
+        }
+        for (int32_t i = 0; i < numSamples; i++) {
+            buffer[i] = mBuffer[(readIndex + i) & mMask];
+        }
+        mReadIndex.store(readIndex + numSamples, std::memory_order_release);
+        return numSamples;
+    }
+
+private:
+    std::vector<float>    mBuffer;
+    uint32_t              mMask = 0;
+    std::atomic<uint32_t> mWriteIndex{0};
+    std::atomic<uint32_t> mReadIndex{0};
+};
+
+#endif // SYNTHMARK_SPSC_RING_BUFFER_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_SYNC_MARK_HARNESS_H
+#define SYNTHMARK_SYNC_MARK_HARNESS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "AudioSinkBase.h"
+#include "HandoffPingPong.h"
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "SyncPrimitives.h"
+#include "TestHarnessParameters.h"
+
+constexpr int32_t kSyncMarkMaxPairs = 8;
+
+/**
+ * Measure how long it takes to wake another thread with each SyncStrategy,
+ * and with a condition variable for comparison.
+ *
+ * A leader thread and a follower thread are pinned to a pair of CPUs
+ * and pass a token back and forth. See HandoffPingPong.
+ * No audio is rendered.
+ */
+class SyncMarkHarness : public TestHarnessParameters {
+
+public:
+    SyncMarkHarness(AudioSinkBase *audioSink,
+                    SynthMarkResult *result,
+                    LogTool *logTool = nullptr)
+            : TestHarnessParameters(audioSink, result, logTool) {}
+
+    virtual ~SyncMarkHarness() {}
+
+    const char *getName() const override {
+        return "SyncMark";
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        const SyncStrategy strategies[] = {
+                SyncStrategy::Spin, SyncStrategy::SpinThenFutex, SyncStrategy::Futex};
+        const int32_t numStrategies = sizeof(strategies) / sizeof(strategies[0]);
+        int cpuCount = HostTools::getCpuCount();
+        int32_t numPairs = (cpuCount > 0) ? std::min(cpuCount, kSyncMarkMaxPairs) : 1;
+        int32_t numMeasurements = (numStrategies + 1) * numPairs;
+        mIterations = calculateHandoffIterations(numSeconds, numMeasurements);
+
+        std::stringstream resultMessage;
+        resultMessage << "sync.iterations = " << mIterations << std::endl;
+        resultMessage << "sync.gap.usec = "
+                      << (kHandoffGapNanos / SYNTHMARK_NANOS_PER_MICROSECOND) << std::endl;
+        double worstMicros = 0.0;
+        int32_t err = SYNTHMARK_RESULT_SUCCESS;
+        for (int32_t pair = 0; pair < numPairs && err == SYNTHMARK_RESULT_SUCCESS; pair++) {
+            // The leader stays on the first CPU. With one CPU both threads share it.
+            int leaderCpu = (cpuCount > 0) ? 0 : SYNTHMARK_CPU_UNSPECIFIED;
+            int followerCpu = (cpuCount > 0) ? pair : SYNTHMARK_CPU_UNSPECIFIED;
+            for (SyncStrategy strategy : strategies) {
+                HandoffPingPong<HostSemaphore> pingPong(mIterations, leaderCpu, followerCpu);
+                pingPong.toFollower.setStrategy(strategy);
+                pingPong.toLeader.setStrategy(strategy);
+                mLogTool->log("---- SyncMark %s on CPUs %d and %d ----\n",
+                              syncStrategyToString(strategy), leaderCpu, followerCpu);
+                err = pingPong.run();
+                if (err != SYNTHMARK_RESULT_SUCCESS) {
+                    break;
+                }
+                pingPong.report(makePrefix(syncStrategyToString(strategy), leaderCpu,
+                                           followerCpu), resultMessage);
+                if (strategy == SyncStrategy::SpinThenFutex) {
+                    worstMicros = std::max(worstMicros, pingPong.getFanOutMicros(0.99));
+                }
+            }
+            if (err == SYNTHMARK_RESULT_SUCCESS) {
+                HandoffPingPong<CondVarSemaphore> pingPong(mIterations, leaderCpu, followerCpu);
+                mLogTool->log("---- SyncMark condvar on CPUs %d and %d ----\n",
+                              leaderCpu, followerCpu);
+                err = pingPong.run();
+                if (err == SYNTHMARK_RESULT_SUCCESS) {
+                    pingPong.report(makePrefix("condvar", leaderCpu, followerCpu),
+                                    resultMessage);
+                }
+            }
+        }
+        resultMessage << getName() << " = " << worstMicros << std::endl;
+        mResult->setTestName(getName());
+        mResult->setMeasurement(worstMicros);
+        mResult->setResultCode(err);
+        mResult->appendMessage(resultMessage.str());
+        return err;
+    }
+
+private:
+    static std::string makePrefix(const char *name, int leaderCpu, int followerCpu) {
+        std::stringstream prefix;
+        prefix << "sync." << name << ".cpu" << leaderCpu << ".cpu" << followerCpu << ".";
+        return prefix.str();
+    }
+
+    int32_t mIterations = kHandoffMinIterations;
+};
+
+#endif // SYNTHMARK_SYNC_MARK_HARNESS_H
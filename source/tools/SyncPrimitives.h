@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_SYNC_PRIMITIVES_H
+#define SYNTHMARK_SYNC_PRIMITIVES_H
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sched.h>
+
+#if !defined(__APPLE__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "HostTools.h"
+
+// Long enough to catch a worker that is just finishing, short compared to a burst.
+constexpr int64_t kDefaultSyncSpinNanos = 20 * kNanosPerMicrosecond;
+
+// Let other threads on the same CPU run now and then while spinning.
+constexpr int32_t kSyncSpinsPerYield = 256;
+
+/**
+ * How a thread waits for another thread.
+ */
+enum class SyncStrategy {
+    Spin,          // busy wait, lowest latency but burns the CPU
+    SpinThenFutex, // busy wait briefly then sleep in the kernel
+    Futex,         // sleep in the kernel right away
+};
+
+inline const char *syncStrategyToString(SyncStrategy strategy) {
+    switch (strategy) {
+        case SyncStrategy::Spin: return "spin";
+        case SyncStrategy::SpinThenFutex: return "spin.futex";
+        case SyncStrategy::Futex: return "futex";
+    }
+    return "unknown";
+}
+
+/**
+ * Sleep on a 32-bit word in the kernel.
+ * On hosts without futexes this just yields, so it degrades to spinning.
+ */
+class HostFutex
+{
+public:
+    /**
+     * Sleep if the word still holds the expected value. This may return early.
+     */
+    static void wait(std::atomic<int32_t> *word, int32_t expected) {
+#if defined(__APPLE__)
+        sched_yield();
+#else
+        syscall(SYS_futex, reinterpret_cast<int32_t *>(word), FUTEX_WAIT_PRIVATE,
+                expected, NULL, NULL, 0);
+#endif
+    }
+
+    /**
+     * Wake up to count threads sleeping on the word.
+     */
+    static void wake(std::atomic<int32_t> *word, int32_t count) {
+#if !defined(__APPLE__)
+        syscall(SYS_futex, reinterpret_cast<int32_t *>(word), FUTEX_WAKE_PRIVATE,
+                count, NULL, NULL, 0);
+#endif
+    }
+};
+
+/**
+ * Wait for a word to change using one of the strategies.
+ * The waker should call wake() after changing the word.
+ * The kernel is only entered when a thread is actually asleep.
+ */
+class SyncWord
+{
+public:
+    explicit SyncWord(int32_t initialValue = 0,
+                      SyncStrategy strategy = SyncStrategy::SpinThenFutex,
+                      int64_t spinNanos = kDefaultSyncSpinNanos)
+            : mWord(initialValue)
+            , mStrategy(strategy)
+            , mSpinNanos(spinNanos) {}
+
+    void setStrategy(SyncStrategy strategy, int64_t spinNanos = kDefaultSyncSpinNanos) {
+        mStrategy = strategy;
+        mSpinNanos = spinNanos;
+    }
+
+    SyncStrategy getStrategy() const {
+        return mStrategy;
+    }
+
+    std::atomic<int32_t> &word() {
+        return mWord;
+    }
+
+    /**
+     * Wait until the word is no longer equal to value.
+     */
+    void waitWhileEqual(int32_t value) {
+        if (spinWhile([this, value] { return mWord.load(std::memory_order_acquire) == value; })) {
+            return;
+        }
+        mSleepers.fetch_add(1);
+        while (mWord.load() == value) {
+            HostFutex::wait(&mWord, value);
+        }
+        mSleepers.fetch_sub(1);
+    }
+
+    /**
+     * Wake every thread waiting for the word to change.
+     */
+    void wakeAll() {
+        if (mSleepers.load() > 0) {
+            HostFutex::wake(&mWord, INT_MAX);
+        }
+    }
+
+    void wakeOne() {
+        if (mSleepers.load() > 0) {
+            HostFutex::wake(&mWord, 1);
+        }
+    }
+
+    /**
+     * Spin while the condition is true, according to the strategy.
+     * @return true if the condition became false, false if the caller should sleep
+     */
+    template <typename Condition>
+    bool spinWhile(Condition condition) {
+        if (mStrategy == SyncStrategy::Futex) {
+            return !condition();
+        }
+        int64_t deadline = HostTools::getNanoTime() + mSpinNanos;
+        int32_t spins = 0;
+        while (condition()) {
+            if (++spins == kSyncSpinsPerYield) {
+                spins = 0;
+                if (mStrategy == SyncStrategy::SpinThenFutex
+                        && HostTools::getNanoTime() > deadline) {
+                    return false;
+                }
+                sched_yield();
+            }
+        }
+        return true;
+    }
+
+private:
+    std::atomic<int32_t> mWord;
+    std::atomic<int32_t> mSleepers{0};
+    SyncStrategy         mStrategy;
+    int64_t              mSpinNanos;
+};
+
+/**
+ * Counting semaphore built on SyncWord.
+ */
+class HostSemaphore
+{
+public:
+    explicit HostSemaphore(SyncStrategy strategy = SyncStrategy::SpinThenFutex,
+                           int64_t spinNanos = kDefaultSyncSpinNanos)
+            : mCount(0, strategy, spinNanos) {}
+
+    void setStrategy(SyncStrategy strategy, int64_t spinNanos = kDefaultSyncSpinNanos) {
+        mCount.setStrategy(strategy, spinNanos);
+    }
+
+    void post() {
+        mCount.word().fetch_add(1);
+        mCount.wakeOne();
+    }
+
+    void wait() {
+        while (!tryWait()) {
+            mCount.waitWhileEqual(0);
+        }
+    }
+
+    bool tryWait() {
+        std::atomic<int32_t> &count = mCount.word();
+        int32_t value = count.load(std::memory_order_acquire);
+        while (value > 0) {
+            if (count.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    SyncWord mCount;
+};
+
+/**
+ * Reusable barrier for a fixed number of threads.
+ * The last thread to arrive releases the others by advancing the generation.
+ */
+class HostBarrier
+{
+public:
+    explicit HostBarrier(int32_t numThreads,
+                         SyncStrategy strategy = SyncStrategy::SpinThenFutex,
+                         int64_t spinNanos = kDefaultSyncSpinNanos)
+            : mNumThreads(numThreads)
+            , mGeneration(0, strategy, spinNanos) {}
+
+    void arriveAndWait() {
+        int32_t generation = mGeneration.word().load(std::memory_order_acquire);
+        if (mArrived.fetch_add(1, std::memory_order_acq_rel) + 1 == mNumThreads) {
+            mArrived.store(0, std::memory_order_relaxed);
+            mGeneration.word().fetch_add(1);
+            mGeneration.wakeAll();
+        } else {
+            mGeneration.waitWhileEqual(generation);
+        }
+    }
+
+private:
+    int32_t              mNumThreads;
+    std::atomic<int32_t> mArrived{0};
+    SyncWord             mGeneration;
+};
+
+/**
+ * Semaphore using a mutex and condition variable, for comparison.
+ */
+class CondVarSemaphore
+{
+public:
+    void post() {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCount++;
+        mCondition.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCondition.wait(lock, [this] { return mCount > 0; });
+        mCount--;
+    }
+
+private:
+    std::mutex              mLock;
+    std::condition_variable mCondition;
+    int32_t                 mCount = 0;
+};
+
+#endif // SYNTHMARK_SYNC_PRIMITIVES_H
@@ -61,20 +61,22 @@ public:
         }
     }
 
-    static void mixBuffers(const synth_float_t *input1,
-                           synth_float_t gain1,
-                           const synth_float_t *input2,
-                           synth_float_t gain2,
-                           synth_float_t *output,
+    template <typename T = synth_float_t>
+    static void mixBuffers(const T *input1,
+                           T gain1,
+                           const T *input2,
+                           T gain2,
+                           T *output,
                            int32_t numSamples) {
         for (int i = 0; i < numSamples; i++) {
             *output++ = (*input1++ * gain1) + (*input2++ * gain2);
         }
     }
 
-    static void multiplyBuffers(const synth_float_t *input1,
-                                       const synth_float_t *input2,
-                                       synth_float_t *output,
+    template <typename T = synth_float_t>
+    static void multiplyBuffers(const T *input1,
+                                       const T *input2,
+                                       T *output,
                                        int32_t numSamples) {
         for (int i = 0; i < numSamples; i++) {
             *output++ = *input1++ * *input2;
@@ -140,26 +142,44 @@ public:
                 1 + (x2 * (x2 * (x2 * (x2 * ((x2 * (-IF10)) + IF8) - IF6) + IF4) - IF2));
         return cosine * negate;
     }
+};
+
+/**
+ * Random numbers using the linear-congruential method.
+ * Each synthesizer owns one so that independent instances do not share state.
+ */
+class PseudoRandom
+{
+public:
+    static constexpr uint64_t kDefaultSeed = 99887766;
 
+    explicit PseudoRandom(uint64_t seed = kDefaultSeed)
+    : mSeed(seed)
+    {}
+
+    void setSeed(uint64_t seed) {
+        mSeed = seed;
+    }
 
     /**
-     * Calculate random 32 bit number using linear-congruential method.
+     * Calculate random 32 bit number.
      */
-    static uint32_t nextRandomInteger() {
-        static uint64_t seed = 99887766;
+    uint32_t nextRandomInteger() {
         // Use values for 64-bit sequence from MMIX by Donald Knuth.
-        seed = (seed * 6364136223846793005L) + 1442695040888963407L;
-        return (uint32_t) (seed >> 32); // The higher bits have a longer sequence.
+        mSeed = (mSeed * 6364136223846793005L) + 1442695040888963407L;
+        return (uint32_t) (mSeed >> 32); // The higher bits have a longer sequence.
     }
 
     /**
      * @return a random double between 0.0 and 1.0
      */
-    static double nextRandomDouble() {
+    double nextRandomDouble() {
         const double scaler = 1.0 / (((uint64_t)1) << 32);
         return nextRandomInteger() * scaler;
     }
 
+private:
+    uint64_t mSeed;
 };
 
 #endif // SYNTHMARK_SYNTHTOOLS_H
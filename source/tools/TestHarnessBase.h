@@ -17,26 +17,39 @@
 #ifndef SYNTHMARK_SYNTHMARK_HARNESS_H
 #define SYNTHMARK_SYNTHMARK_HARNESS_H
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <memory>
+#include <sstream>
 
 #include "AudioSinkBase.h"
-#include "BinCounter.h"
 #include "HostTools.h"
 #include "IAudioSinkCallback.h"
 #include "SynthMark.h"
 #include "SynthMarkResult.h"
+#include "synth/EffectsChain.h"
 #include "synth/Synthesizer.h"
 #include "tools/CpuAnalyzer.h"
+#include "tools/CpuFrequencyEstimator.h"
+#include "tools/FlightRecorder.h"
 #include "tools/LogTool.h"
+#include "tools/MidiFilePlayer.h"
+#include "tools/PerfCounterAnalyzer.h"
+#include "tools/NoteEventGenerator.h"
+#include "tools/NoteEventQueue.h"
+#include "tools/PipelinedRenderer.h"
 #include "tools/ITestHarness.h"
 #include "tools/TimingAnalyzer.h"
+#include "tools/WorkloadTrace.h"
 #include "tools/TestHarnessBase.h"
 #include "HostThreadFactory.h"
 #include "TestHarnessParameters.h"
 
 constexpr int JITTER_BINS_PER_MSEC  = 10;
-constexpr int JITTER_MAX_MSEC       = 100;
+
+// Note events applied in one burst. Any more wait for the next burst.
+constexpr int32_t kNoteEventsPerBurst = 64;
 
 /**
  * Base class for running a test.
@@ -59,12 +72,11 @@ public:
     }
 
     void setupHistograms() {
-        // set resolution and size of histogram
+        // set resolution of the printed histogram, the percentiles are not limited by it
         int32_t nanosPerMilli = (int32_t) (SYNTHMARK_NANOS_PER_SECOND /
                                            SYNTHMARK_MILLIS_PER_SECOND);
         mNanosPerBin = nanosPerMilli / JITTER_BINS_PER_MSEC;
-        int32_t numBins = JITTER_MAX_MSEC * JITTER_BINS_PER_MSEC;
-        mTimer.setupHistograms(mNanosPerBin, numBins);
+        mTimer.setupHistograms(mNanosPerBin);
     }
 
     // Customize the test by defining these virtual methods.
@@ -77,7 +89,7 @@ public:
 
     // Run the benchmark.
     int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
-        int32_t err = open(sampleRate, SAMPLES_PER_FRAME,
+        int32_t err = open(sampleRate, mChannelCount,
                            kSynthmarkFramesPerRender, framesPerBurst);
         if (err) {
             return err;
@@ -91,53 +103,60 @@ public:
     virtual IAudioSinkCallback::Result onRenderAudio(float *buffer,
                                                      int32_t numFrames) override {
         // mLogTool->log("onRenderAudio() callback called\n");
-        int32_t result;
         if (mFrameCounter >= mFramesNeeded) {
             return IAudioSinkCallback::Result::Finished;
         }
 
-        // Only start turning notes on and off after the initial delay
-        if (mFrameCounter >= mDelayNotesOnUntilFrame){
-            // Turn notes on and off so they never stop sounding.
-            if (mBurstCountdown <= 0) {
-                if (mAreNotesOn) {
-                    mSynth.allNotesOff();
-                    mBurstCountdown = mBurstsOff;
-                    mAreNotesOn = false;
-                    mNoteCounter++;
-                } else {
-                    result = onBeforeNoteOn();
-                    if (result < 0) {
-                        mLogTool->log("%s() onBeforeNoteOn() returned %d\n", __func__, result);
-                        mResult->setResultCode(result);
-                        return IAudioSinkCallback::Result::Finished;
-                    }
-                    int32_t currentNumVoices = getCurrentNumVoices();
-                    HostCpuManager::getInstance()->setApplicationLoad(currentNumVoices,
-                                                                      kSynthmarkMaxVoices);
-                    result = mSynth.notesOn(currentNumVoices);
-                    if (result < 0) {
-                        mLogTool->log("%s() allNotesOn() returned %d\n", __func__, result);
-                        mResult->setResultCode(result);
-                        return IAudioSinkCallback::Result::Finished;
-                    }
-                    mBurstCountdown = mBurstsOn;
-                    mAreNotesOn = true;
-                }
-            }
-            mBurstCountdown--;
+        IAudioSinkCallback::Result result = updateNotes(mFrameCounter);
+        if (result != IAudioSinkCallback::Result::Continue) {
+            return result;
         }
 
         // Gather timing information.
         // mLogTool->log("onRenderAudio() call the synthesizer\n");
         // Calculate time when we ideally should have woken up.
-        int64_t fullFramePosition = mAudioSink->getFramesWritten()
-                                    - mAudioSink->getBufferSizeInFrames()
-                                    - mFramesPerBurst;
-        int64_t idealTime = mAudioSink->convertFrameToTime(fullFramePosition);
+        int64_t idealTime = mAudioSink->getIdealCallbackTime();
+        mPerfAnalyzer.markEntry(); // outside the timer so the reads are not in the render time
         mTimer.markEntry(idealTime);
-        mSynth.renderStereo(buffer, numFrames);  // DO THE MATH!
+        if (mPipelineDepth > 0) {
+            // The audio was rendered ahead of time by the helper thread.
+            int32_t err = mPipeline.read(buffer, numFrames);
+            if (err < 0) {
+                mResult->setResultCode(err);
+                return IAudioSinkCallback::Result::Finished;
+            }
+        } else if (mNoteQueue || mMidiPlayer) {
+            renderWithEvents(buffer, numFrames);
+        } else {
+            renderSynth(buffer, numFrames);  // DO THE MATH!
+        }
         mTimer.markExit();
+        mPerfAnalyzer.markExit(mSynth.getActiveVoiceCount());
+        if (CpuFrequencyEstimator::isEnabled()) {
+            int32_t cpuSpeedMHz = mFrequencyEstimator.estimate(mPerfAnalyzer);
+            mTimer.recordFrequency(cpuSpeedMHz);
+            mAudioSink->getCpuManager()->setMeasuredCpuSpeedMHz(
+                    cpuSpeedMHz, mFrequencyEstimator.getMaxCpuSpeedMHz());
+        }
+        if (mPipelineDepth == 0) {
+            int64_t renderNanos = mTimer.getLastRenderDurationNanos();
+            mRenderNanos += renderNanos;
+            recordBurstCost(renderNanos);
+            if (mTraceWriter) {
+                mTraceWriter->write(TraceRecordType::Burst, mSynth.getActiveVoiceCount(),
+                                    numFrames, 0.0f, 0.0f, renderNanos);
+            }
+        }
+        if (mFlightRecorder) {
+            recordFlight(idealTime);
+        }
+        mRenderCount++;
+        if (numFrames < mMinCallbackFrames) {
+            mMinCallbackFrames = numFrames;
+        }
+        if (numFrames > mMaxCallbackFrames) {
+            mMaxCallbackFrames = numFrames;
+        }
 
         mCpuAnalyzer.recordCpu(); // at end so we have less affect on timing
 
@@ -168,36 +187,581 @@ public:
         mBurstsOn = (int) (0.2 * mSampleRate / mFramesPerBurst);
         mBurstsOff = (int) (0.3 * mSampleRate / mFramesPerBurst);
 
+        mRenderNanos = 0;
+        mEffectsNanos = 0;
+        mEffects.resetTiming();
+        mRenderCount = 0;
+        mPerfAnalyzer.reset();
+        mFrequencyEstimator.reset();
+        mMinCallbackFrames = INT32_MAX;
+        mMaxCallbackFrames = 0;
+        mBurstHasEvents = false;
+        mWithEvents = BurstCost();
+        mWithoutEvents = BurstCost();
+        int64_t startingPartialBlocks = mSynth.getPartialBlockCount();
+        int64_t startingShortBlocks = mSynth.getShortBlockCount();
+
         onBeginMeasurement();
 
+        if (mPipelineDepth > 0) {
+            // Fill the pipeline before the audio starts.
+            result = mPipeline.start(mPipelineDepth, mFramesPerBurst, mSamplesPerFrame,
+                                     [this](float *buffer, int32_t numFrames) {
+                                         return renderAhead(buffer, numFrames);
+                                     });
+            if (result < 0) {
+                mLogTool->log("ERROR pipeline start() failed, returned %d\n", result);
+                mResult->setResultCode(result);
+                return result;
+            }
+        }
+
+        mEventsApplied = 0;
+        mEventsIgnored = 0;
+        startFlightRecorder();
+        result = startTrace();
+        if (result == 0) {
+            result = startMidiFile();
+        }
+        if (result == 0) {
+            result = startNoteEvents();
+        }
+        if (result < 0) {
+            mPipeline.stop();
+            mTraceWriter.reset();
+            mResult->setResultCode(result);
+            return result;
+        }
+
         mAudioSink->setCallback(this);
 
         result = mAudioSink->start();
         if (result < 0){
+            mAudioSink->stop();
+            mPipeline.stop();
+            stopNoteEvents();
+            mTraceWriter.reset();
             mResult->setResultCode(SYNTHMARK_RESULT_AUDIO_SINK_START_FAILURE);
             return result;
         }
 
         // Run the test or wait for it to finish.
         result = mAudioSink->runCallbackLoop();
+        mPerfAnalyzer.close();
+        mPipeline.stop();
+        stopNoteEvents();
+        if (mTraceWriter) {
+            mTraceWriter->close();
+            mResult->appendMessage(dumpTrace());
+            mTraceWriter.reset();
+        }
+        if (mFlightRecorder) {
+            mResult->appendMessage(saveFlightRecorder());
+            mFlightRecorder.reset();
+        }
         if (result < 0) {
             mLogTool->log("ERROR runCallbackLoop() failed, returned %d\n", result);
+            mAudioSink->stop();
             mResult->setResultCode(result);
             return result;
         }
 
         mAudioSink->stop();
         onEndMeasurement();
+        if (mEffects.isEnabled()) {
+            mResult->appendMessage(dumpEffectsTiming());
+        }
+        if (mPipelineDepth > 0) {
+            mResult->appendMessage(dumpPipeline());
+        }
+        // Only the event path splits blocks, so only report the split when it was measured.
+        if ((mNoteQueue || mMidiPlayer) && mWithEvents.count > 0) {
+            mResult->appendMessage(dumpBurstCost(
+                    mSynth.getShortBlockCount() - startingShortBlocks));
+        }
+        if (mNoteQueue) {
+            mResult->appendMessage(dumpNoteEvents());
+            mNoteQueue.reset();
+        }
+        if (mMidiPlayer) {
+            mResult->appendMessage(dumpMidiFile());
+            mSynth.setPolyphony(0);
+            mMidiPlayer.reset();
+        }
+        if (mMaxCallbackFrames > mMinCallbackFrames) {
+            mResult->appendMessage(dumpCallbackSizes(
+                    mSynth.getPartialBlockCount() - startingPartialBlocks));
+        }
 
         mResult->setResultCode(result);
         return result;
     }
 
+    /**
+     * Turn notes on and off so they never stop sounding.
+     * This is called from the audio callback before each render.
+     */
+    virtual IAudioSinkCallback::Result updateNotes(int64_t framePosition) {
+        int32_t result;
+        // Only start turning notes on and off after the initial delay
+        if (framePosition >= mDelayNotesOnUntilFrame){
+            // Turn notes on and off so they never stop sounding.
+            if (mBurstCountdown <= 0) {
+                if (mAreNotesOn) {
+                    // The MIDI file turns its own notes off.
+                    if (!mMidiPlayer) {
+                        setNotes(0);
+                        mBurstHasEvents = true;
+                        traceNotes(TraceRecordType::AllNotesOff, 0);
+                    }
+                    mBurstCountdown = mBurstsOff;
+                    mAreNotesOn = false;
+                    mNoteCounter++;
+                } else {
+                    result = onBeforeNoteOn();
+                    if (result < 0) {
+                        mLogTool->log("%s() onBeforeNoteOn() returned %d\n", __func__, result);
+                        mResult->setResultCode(result);
+                        return IAudioSinkCallback::Result::Finished;
+                    }
+                    int32_t currentNumVoices = getCurrentNumVoices();
+                    mAudioSink->getCpuManager()->setApplicationLoad(currentNumVoices,
+                                                                     kSynthmarkMaxVoices);
+                    if (mMidiPlayer) {
+                        // Only limit the polyphony of the music.
+                        result = mSynth.setPolyphony(currentNumVoices);
+                        traceNotes(TraceRecordType::Polyphony, currentNumVoices);
+                    } else {
+                        result = setNotes(currentNumVoices);
+                        mBurstHasEvents = true;
+                        traceNotes(TraceRecordType::NotesOn, currentNumVoices);
+                    }
+                    if (result < 0) {
+                        mLogTool->log("%s() allNotesOn() returned %d\n", __func__, result);
+                        mResult->setResultCode(result);
+                        return IAudioSinkCallback::Result::Finished;
+                    }
+                    mBurstCountdown = mBurstsOn;
+                    mAreNotesOn = true;
+                }
+            }
+            mBurstCountdown--;
+        }
+        return IAudioSinkCallback::Result::Continue;
+    }
+
+    /**
+     * Turn on numVoices notes, or turn all notes off if numVoices is zero.
+     * When pipelined, the change is applied by the helper before its next burst.
+     */
+    int32_t setNotes(int32_t numVoices) {
+        if (mPipelineDepth > 0) {
+            if (numVoices > kSynthmarkMaxVoices) {
+                return -1;
+            }
+            return mPipeline.postCommand(numVoices) ? 0 : -1;
+        }
+        return applyNotes(numVoices);
+    }
+
+    virtual int32_t applyNotes(int32_t numVoices) {
+        if (numVoices == 0) {
+            mSynth.allNotesOff();
+            return 0;
+        }
+        return mSynth.notesOn(numVoices);
+    }
+
+    /**
+     * Render the synthesizer and the master effects.
+     */
+    void renderSynth(float *buffer, int32_t numFrames) {
+        renderVoices(buffer, numFrames);
+        applyEffects(buffer, numFrames);
+    }
+
+    void applyEffects(float *buffer, int32_t numFrames) {
+        if (mEffects.isEnabled()) {
+            int64_t effectsStart = HostTools::getNanoTime();
+            mEffects.process(buffer, numFrames);
+            mEffectsNanos += HostTools::getNanoTime() - effectsStart;
+        }
+    }
+
+    /**
+     * Render the voices before the master effects. Override to use other synthesizers.
+     */
+    virtual void renderVoices(float *buffer, int32_t numFrames) {
+        mSynth.render(buffer, numFrames);
+    }
+
+    /**
+     * Load the MIDI file, if requested, and let the synthesizer allocate voices for it.
+     */
+    int32_t startMidiFile() {
+        mMidiPlayer.reset();
+        if (mMidiFileName.empty()) {
+            return 0;
+        }
+        if (mPipelineDepth > 0) {
+            mLogTool->log("the MIDI file is not played when the render is pipelined\n");
+            return 0;
+        }
+        mMidiPlayer.reset(new MidiFilePlayer());
+        if (mMidiPlayer->setup(mMidiFileName, mMidiTempoPercent * 0.01, true) < 0) {
+            mLogTool->log("ERROR %s\n", mMidiPlayer->getFile().getErrorText().c_str());
+            mMidiPlayer.reset();
+            return SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+        }
+        mMidiPlayer->reset(mSampleRate);
+        traceNotes(TraceRecordType::Polyphony, getNumVoices());
+        return mSynth.setPolyphony(getNumVoices());
+    }
+
+    /**
+     * Open the trace file, if requested, and start its writer thread.
+     */
+    int32_t startTrace() {
+        mTraceWriter.reset();
+        if (mTraceFileName.empty()) {
+            return 0;
+        }
+        if (mPipelineDepth > 0) {
+            mLogTool->log("the trace is not saved when the render is pipelined\n");
+            return 0;
+        }
+        mTraceWriter.reset(new WorkloadTraceWriter());
+        int32_t result = mTraceWriter->open(mTraceFileName, mSampleRate, mFramesPerBurst);
+        if (result < 0) {
+            mLogTool->log("ERROR could not write trace %s\n", mTraceFileName.c_str());
+            mTraceWriter.reset();
+        }
+        return result;
+    }
+
+    void startFlightRecorder() {
+        mFlightRecorder.reset();
+        if (!mFlightFileName.empty()) {
+            mFlightRecorder.reset(new FlightRecorder());
+            mFlightUnderruns = mAudioSink->getUnderrunCount() + mPipeline.getUnderrunCount();
+        }
+    }
+
+    void recordFlight(int64_t idealTime) {
+        FlightRecord record;
+        record.idealNanos = (idealTime > 0) ? idealTime : 0; // the sink clock may not be running
+        record.entryNanos = mTimer.getLastEntryTime();
+        record.exitNanos = record.entryNanos + mTimer.getLastRenderDurationNanos();
+        record.sleepTargetNanos = mAudioSink->getLastSleepTargetNanos();
+        record.cpu = HostThread::getCpu();
+        record.numVoices = (int16_t) mSynth.getActiveVoiceCount();
+        record.flags = 0;
+        int32_t underruns = mAudioSink->getUnderrunCount() + mPipeline.getUnderrunCount();
+        if (underruns != mFlightUnderruns) {
+            record.flags |= kFlightRecordUnderrun;
+            mFlightUnderruns = underruns;
+        }
+        mFlightRecorder->record(record);
+    }
+
+    /**
+     * Save the flight recorder, unless it is only wanted after a glitch.
+     */
+    std::string saveFlightRecorder() {
+        std::stringstream resultMessage;
+        if (mFlightOnlyOnGlitch && !mFlightRecorder->hasGlitch()) {
+            return resultMessage.str();
+        }
+        int32_t result = mFlightRecorder->save(mFlightFileName, mSampleRate, mFramesPerBurst);
+        if (result < 0) {
+            mLogTool->log("ERROR could not write flight recorder %s\n", mFlightFileName.c_str());
+            return resultMessage.str();
+        }
+        resultMessage << "flight.file = " << mFlightFileName << std::endl;
+        resultMessage << "flight.records = " << result << std::endl;
+        resultMessage << "flight.glitched = " << (mFlightRecorder->hasGlitch() ? 1 : 0)
+                      << std::endl;
+        return resultMessage.str();
+    }
+
+    void traceNotes(TraceRecordType type, int32_t numVoices) {
+        if (mTraceWriter) {
+            mTraceWriter->write(type, numVoices);
+        }
+    }
+
+    std::string dumpTrace() {
+        std::stringstream resultMessage;
+        resultMessage << "trace.file = " << mTraceFileName << std::endl;
+        resultMessage << "trace.records = " << mTraceWriter->getRecordCount() << std::endl;
+        resultMessage << "trace.dropped = " << mTraceWriter->getDroppedCount() << std::endl;
+        return resultMessage.str();
+    }
+
+    /**
+     * Start the control threads that send note events, if requested.
+     */
+    int32_t startNoteEvents() {
+        mNoteQueue.reset();
+        if (mEventsPerSecond <= 0) {
+            return 0;
+        }
+        if (mPipelineDepth > 0) {
+            mLogTool->log("note events are not sent when the render is pipelined\n");
+            return 0;
+        }
+        mNoteQueue.reset(NoteEventQueueBase::create(mNoteQueueType, kNoteEventQueueCapacity));
+        mEventsLate = 0;
+        mMaxEventDelayNanos = 0;
+        mDrainNanos = 0;
+        mMaxDrainNanos = 0;
+        mLastDrainNanos = HostTools::getNanoTime();
+        int32_t result = mNoteGenerator.start(mNoteQueue.get(), mNumEventProducers,
+                                              mEventsPerSecond, getNumVoices());
+        if (result < 0) {
+            mLogTool->log("ERROR could not start %d note event threads\n", mNumEventProducers);
+            mNoteQueue.reset();
+        }
+        return result;
+    }
+
+    void stopNoteEvents() {
+        mNoteGenerator.stop();
+    }
+
+    /**
+     * Apply the note events that arrived during the previous burst at the
+     * matching frame in this burst, so their timing is kept with a fixed
+     * delay of one burst. The synthesizer splits its blocks at the events.
+     */
+    void renderWithEvents(float *buffer, int32_t numFrames) {
+        int64_t drainStart = HostTools::getNanoTime();
+        int32_t numEvents = 0;
+        NoteEvent event;
+        while (mNoteQueue && numEvents < kNoteEventsPerBurst && mNoteQueue->pop(&event)) {
+            int64_t offsetNanos = event.timestampNanos - mLastDrainNanos;
+            int32_t offset = (int32_t) (offsetNanos * mSampleRate / SYNTHMARK_NANOS_PER_SECOND);
+            if (offset < 0) {
+                offset = 0;
+                mEventsLate++; // left over from an earlier burst
+            } else if (offset >= numFrames) {
+                offset = numFrames - 1;
+            }
+            mMaxEventDelayNanos = std::max(mMaxEventDelayNanos,
+                                           drainStart - event.timestampNanos);
+            addBurstEvent(event, offset, numEvents++);
+        }
+        int64_t drainNanos = HostTools::getNanoTime() - drainStart;
+        mDrainNanos += drainNanos;
+        mMaxDrainNanos = std::max(mMaxDrainNanos, drainNanos);
+        mLastDrainNanos = drainStart;
+
+        if (mMidiPlayer && mFrameCounter >= mDelayNotesOnUntilFrame) {
+            int32_t numMidiEvents = mMidiPlayer->advance(numFrames, mMidiEvents, mMidiOffsets,
+                                                         kNoteEventsPerBurst - numEvents);
+            for (int32_t i = 0; i < numMidiEvents; i++) {
+                addBurstEvent(mMidiEvents[i], mMidiOffsets[i], numEvents++);
+            }
+        }
+
+        if (numEvents == 0) {
+            renderSynth(buffer, numFrames);
+            return;
+        }
+        mBurstHasEvents = true;
+        if (mTraceWriter) {
+            for (int32_t i = 0; i < numEvents; i++) {
+                const NoteEvent &burstEvent = mBurstEvents[i];
+                mTraceWriter->write((burstEvent.type == NoteEventType::NoteOn)
+                                    ? TraceRecordType::NoteOn : TraceRecordType::NoteOff,
+                                    burstEvent.voiceIndex, mBurstOffsets[i],
+                                    burstEvent.pitch, burstEvent.velocity);
+            }
+        }
+        int32_t applied = mSynth.renderWithEvents(buffer, numFrames, mBurstEvents,
+                                                  mBurstOffsets, numEvents);
+        mEventsApplied += applied;
+        mEventsIgnored += numEvents - applied; // voices not sounding
+        applyEffects(buffer, numFrames);
+    }
+
+    /**
+     * Insert an event so the events stay sorted by offset.
+     * Different threads may interleave.
+     * @param index number of events already in the burst
+     */
+    void addBurstEvent(const NoteEvent &event, int32_t offset, int32_t index) {
+        int32_t i = index;
+        while (i > 0 && mBurstOffsets[i - 1] > offset) {
+            mBurstOffsets[i] = mBurstOffsets[i - 1];
+            mBurstEvents[i] = mBurstEvents[i - 1];
+            i--;
+        }
+        mBurstOffsets[i] = offset;
+        mBurstEvents[i] = event;
+    }
+
+    /**
+     * Report what was played from the MIDI file.
+     */
+    std::string dumpMidiFile() {
+        std::stringstream resultMessage;
+        const MidiFile &file = mMidiPlayer->getFile();
+        resultMessage << "midi.file = " << mMidiFileName << std::endl;
+        resultMessage << "midi.notes = " << file.getNotes().size() << std::endl;
+        resultMessage << "midi.duration.seconds = " << file.getDurationSeconds() << std::endl;
+        resultMessage << "midi.tempo.percent = " << mMidiTempoPercent << std::endl;
+        resultMessage << "midi.loops = " << mMidiPlayer->getLoopCount() << std::endl;
+        resultMessage << "midi.events.applied = " << mEventsApplied << std::endl;
+        resultMessage << "midi.voices.peak = " << mSynth.getPeakVoiceCount() << std::endl;
+        resultMessage << "midi.voice.steals = " << mSynth.getStealCount() << std::endl;
+        return resultMessage.str();
+    }
+
+    /**
+     * Keep separate totals for bursts that changed notes and bursts that did not.
+     */
+    void recordBurstCost(int64_t renderNanos) {
+        BurstCost &cost = mBurstHasEvents ? mWithEvents : mWithoutEvents;
+        cost.count++;
+        cost.totalNanos += renderNanos;
+        cost.maxNanos = std::max(cost.maxNanos, renderNanos);
+        mBurstHasEvents = false;
+    }
+
+    /**
+     * Report the render cost of bursts with note changes separately from the others.
+     */
+    std::string dumpBurstCost(int64_t shortBlocks) {
+        std::stringstream resultMessage;
+        const BurstCost *costs[] = {&mWithEvents, &mWithoutEvents};
+        const char *names[] = {"with.events", "without.events"};
+        for (int i = 0; i < 2; i++) {
+            const BurstCost &cost = *costs[i];
+            int64_t count = (cost.count > 0) ? cost.count : 1;
+            resultMessage << "burst." << names[i] << ".count = " << cost.count << std::endl;
+            resultMessage << "burst." << names[i] << ".nanos.mean = "
+                          << (cost.totalNanos / count) << std::endl;
+            resultMessage << "burst." << names[i] << ".nanos.max = " << cost.maxNanos
+                          << std::endl;
+        }
+        resultMessage << "synth.short.blocks = " << shortBlocks << std::endl;
+        return resultMessage.str();
+    }
+
+    /**
+     * Report how many note events were delivered and what it cost the render thread.
+     */
+    std::string dumpNoteEvents() {
+        std::stringstream resultMessage;
+        int32_t count = (mRenderCount > 0) ? mRenderCount : 1;
+        resultMessage << "events.queue = " << noteQueueTypeToString(mNoteQueueType)
+                      << std::endl;
+        resultMessage << "events.producers = " << mNumEventProducers << std::endl;
+        resultMessage << "events.per.second = " << mEventsPerSecond << std::endl;
+        resultMessage << "events.posted = " << mNoteGenerator.getPostedCount() << std::endl;
+        resultMessage << "events.dropped = " << mNoteGenerator.getDroppedCount() << std::endl;
+        resultMessage << "events.applied = " << mEventsApplied << std::endl;
+        resultMessage << "events.ignored = " << mEventsIgnored << std::endl;
+        resultMessage << "events.late = " << mEventsLate << std::endl;
+        resultMessage << "events.delay.max.usec = "
+                      << ((double) mMaxEventDelayNanos / SYNTHMARK_NANOS_PER_MICROSECOND)
+                      << std::endl;
+        resultMessage << "events.drain.nanos.mean = " << (mDrainNanos / count) << std::endl;
+        resultMessage << "events.drain.nanos.max = " << mMaxDrainNanos << std::endl;
+        return resultMessage.str();
+    }
+
+    /**
+     * Called by the pipeline thread to render one burst ahead of the callback.
+     */
+    int32_t renderAhead(float *buffer, int32_t numFrames) {
+        int32_t numVoices;
+        while (mPipeline.popCommand(&numVoices)) {
+            int32_t result = applyNotes(numVoices);
+            if (result < 0) {
+                return result;
+            }
+        }
+        int64_t startTime = HostTools::getNanoTime();
+        renderSynth(buffer, numFrames);
+        mRenderNanos += HostTools::getNanoTime() - startTime;
+        return 0;
+    }
+
     std::string dumpJitter() {
-        return mTimer.dumpJitter();
+        return mTimer.dumpJitter() + mFrequencyEstimator.dump();
+    }
+
+    /**
+     * Report the time spent in the master effects separately from the synthesizer.
+     */
+    std::string dumpEffectsTiming() {
+        std::stringstream resultMessage;
+        int32_t count = (mRenderCount > 0) ? mRenderCount : 1;
+        int64_t synthNanos = mRenderNanos - mEffectsNanos;
+        resultMessage << "effects = " << EffectsChain::flagsToString(mEffects.getFlags())
+                      << std::endl;
+        resultMessage << "synth.nanos.per.burst = " << (synthNanos / count) << std::endl;
+        resultMessage << "effects.nanos.per.burst = " << (mEffectsNanos / count) << std::endl;
+        for (int32_t stage = 0; stage < kEffectsNumStages; stage++) {
+            if (mEffects.getFlags() & (1 << stage)) {
+                resultMessage << EffectsChain::stageToString(stage) << ".nanos.per.burst = "
+                              << (mEffects.getStageNanos(stage) / count) << std::endl;
+            }
+        }
+        if (mRenderNanos > 0) {
+            resultMessage << "effects.fraction.of.render = "
+                          << ((double) mEffectsNanos / mRenderNanos) << std::endl;
+        }
+        ConvolutionReverb *convolution = mEffects.getConvolution();
+        if (convolution != NULL) {
+            resultMessage << "convolution.tail.nanos.per.block = "
+                          << convolution->getTailNanosPerBlock() << std::endl;
+            resultMessage << "convolution.deadline.misses = "
+                          << convolution->getDeadlineMisses() << std::endl;
+        }
+        return resultMessage.str();
     }
 
 
+    /**
+     * Report the latency added by the pipeline and the load on each thread.
+     */
+    std::string dumpPipeline() {
+        std::stringstream resultMessage;
+        int32_t latencyFrames = mPipelineDepth * mFramesPerBurst;
+        resultMessage << "pipeline.depth = " << mPipelineDepth << std::endl;
+        resultMessage << "pipeline.latency.frames = " << latencyFrames << std::endl;
+        resultMessage << "pipeline.latency.msec = "
+                      << (1000.0 * latencyFrames / mSampleRate) << std::endl;
+        resultMessage << "pipeline.underrun.count = " << mPipeline.getUnderrunCount() << std::endl;
+        resultMessage << "pipeline.render.utilization = " << mPipeline.getRenderUtilization()
+                      << std::endl;
+        resultMessage << "pipeline.callback.utilization = " << mTimer.getDutyCycle() << std::endl;
+        return resultMessage.str();
+    }
+
+    int32_t getPipelineUnderrunCount() const {
+        return mPipeline.getUnderrunCount();
+    }
+
+    /**
+     * Report the range of callback sizes and how often a render block had to be split.
+     */
+    std::string dumpCallbackSizes(int64_t partialBlocks) {
+        std::stringstream resultMessage;
+        int32_t count = (mRenderCount > 0) ? mRenderCount : 1;
+        resultMessage << "callback.frames.min = " << mMinCallbackFrames << std::endl;
+        resultMessage << "callback.frames.max = " << mMaxCallbackFrames << std::endl;
+        resultMessage << "callback.frames.mean = " << ((double) mFrameCounter / count)
+                      << std::endl;
+        resultMessage << "render.fifo.partial.blocks = " << partialBlocks << std::endl;
+        resultMessage << "render.fifo.partial.fraction = " << ((double) partialBlocks / count)
+                      << std::endl;
+        return resultMessage.str();
+    }
+
     virtual int32_t getCurrentNumVoices() {
         return getNumVoices();
     }
@@ -222,8 +786,14 @@ public:
             mLogTool->log("ERROR in open, sampleRate too low = %d < 8000\n", sampleRate);
             return -1;
         }
-        if (samplesPerFrame != 2) {
-            mLogTool->log("ERROR in open, samplesPerFrame = %d != 2\n", samplesPerFrame);
+        if (samplesPerFrame < 1 || samplesPerFrame > kSynthmarkMaxChannels) {
+            mLogTool->log("ERROR in open, samplesPerFrame = %d not in [1, %d]\n",
+                          samplesPerFrame, kSynthmarkMaxChannels);
+            return -1;
+        }
+        if (mEffectsFlags != EFFECTS_NONE && samplesPerFrame != SAMPLES_PER_FRAME) {
+            mLogTool->log("ERROR in open, effects need %d channels, not %d\n",
+                          SAMPLES_PER_FRAME, samplesPerFrame);
             return -1;
         }
         if (framesPerRender < 1) {
@@ -243,7 +813,13 @@ public:
         mSamplesPerFrame = samplesPerFrame;
         mFramesPerBurst = framesPerBurst;
 
-        mSynth.setup(sampleRate, kSynthmarkMaxVoices);
+        if (mSynth.setup(sampleRate, kSynthmarkMaxVoices, mSampleType, mOversampling,
+                         samplesPerFrame) < 0) {
+            mLogTool->log("ERROR in open, oversampling = %d, samplesPerFrame = %d\n",
+                          mOversampling, samplesPerFrame);
+            return -1;
+        }
+        mEffects.setup(sampleRate, mEffectsFlags, mImpulseSeconds);
         return mAudioSink->open(sampleRate, samplesPerFrame, framesPerBurst);
     }
 
@@ -269,8 +845,12 @@ public:
 
 protected:
     Synthesizer      mSynth;
+    EffectsChain     mEffects;
+    PipelinedRenderer mPipeline;
     TimingAnalyzer   mTimer;
     CpuAnalyzer      mCpuAnalyzer;
+    PerfCounterAnalyzer mPerfAnalyzer;
+    CpuFrequencyEstimator mFrequencyEstimator;
     std::string      mTestName;
 
     int32_t          mSampleRate = 0;
@@ -288,6 +868,44 @@ protected:
     int32_t          mBurstsOn = 0;
     int32_t          mBurstsOff = 0;
 
+    // Render time of the whole measurement, used to report the cost of the effects.
+    int64_t          mRenderNanos = 0;
+    int64_t          mEffectsNanos = 0;
+    int32_t          mRenderCount = 0;
+
+    // Note events from the control threads, only when requested.
+    std::unique_ptr<NoteEventQueueBase> mNoteQueue;
+    NoteEventGenerator mNoteGenerator;
+    NoteEvent        mBurstEvents[kNoteEventsPerBurst];
+    int32_t          mBurstOffsets[kNoteEventsPerBurst];
+    int64_t          mLastDrainNanos = 0;
+    std::unique_ptr<MidiFilePlayer> mMidiPlayer;
+    std::unique_ptr<WorkloadTraceWriter> mTraceWriter;
+    std::unique_ptr<FlightRecorder> mFlightRecorder;
+    int32_t          mFlightUnderruns = 0;
+    NoteEvent        mMidiEvents[kNoteEventsPerBurst];
+    int32_t          mMidiOffsets[kNoteEventsPerBurst];
+    int64_t          mEventsApplied = 0;
+    int64_t          mEventsIgnored = 0;
+    int64_t          mEventsLate = 0;
+    int64_t          mMaxEventDelayNanos = 0;
+    int64_t          mDrainNanos = 0;
+    int64_t          mMaxDrainNanos = 0;
+
+    // Render cost of bursts that turned notes on or off, and of the other bursts.
+    struct BurstCost {
+        int64_t count = 0;
+        int64_t totalNanos = 0;
+        int64_t maxNanos = 0;
+    };
+    bool             mBurstHasEvents = false;
+    BurstCost        mWithEvents;
+    BurstCost        mWithoutEvents;
+
+    // Range of frame counts requested by the audio sink.
+    int32_t          mMinCallbackFrames = 0;
+    int32_t          mMaxCallbackFrames = 0;
+
 private:
     bool             mVerbose = false;
 };
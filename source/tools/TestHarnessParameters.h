@@ -18,11 +18,13 @@
 #define ANDROID_TEST_HARNESS_PARAMETERS_H
 
 #include <cstdint>
+#include <string>
 #include "AudioSinkBase.h"
 #include "BinCounter.h"
 #include "HostTools.h"
 #include "IAudioSinkCallback.h"
 #include "SynthMarkResult.h"
+#include "synth/EffectsChain.h"
 #include "synth/Synthesizer.h"
 #include "tools/CpuAnalyzer.h"
 #include "tools/LogTool.h"
@@ -99,6 +101,150 @@ public:
         return mNumVoicesHigh;
     }
 
+    void setSampleType(SampleType sampleType) override {
+        mSampleType = sampleType;
+    }
+
+    SampleType getSampleType() const {
+        return mSampleType;
+    }
+
+    /**
+     * Render the voices at this multiple of the sample rate, 1, 2, 4 or 8.
+     */
+    void setOversampling(int32_t oversampling) override {
+        mOversampling = oversampling;
+    }
+
+    int32_t getOversampling() const {
+        return mOversampling;
+    }
+
+    /**
+     * @param effectsFlags bits from EffectsFlags for the master effects
+     */
+    void setEffects(int32_t effectsFlags) override {
+        mEffectsFlags = effectsFlags;
+    }
+
+    int32_t getEffects() const {
+        return mEffectsFlags;
+    }
+
+    /**
+     * Length of the synthetic impulse response used by the convolution effect.
+     */
+    void setImpulseSeconds(float seconds) override {
+        mImpulseSeconds = seconds;
+    }
+
+    float getImpulseSeconds() const {
+        return mImpulseSeconds;
+    }
+
+    /**
+     * Number of interleaved output channels, 1 to kSynthmarkMaxChannels.
+     */
+    void setChannelCount(int32_t channelCount) override {
+        mChannelCount = channelCount;
+    }
+
+    int32_t getChannelCount() const {
+        return mChannelCount;
+    }
+
+    /**
+     * Number of bursts rendered ahead on a helper thread, or 0 to render in the callback.
+     */
+    void setPipelineDepth(int32_t depth) override {
+        mPipelineDepth = depth;
+    }
+
+    int32_t getPipelineDepth() const {
+        return mPipelineDepth;
+    }
+
+    /**
+     * Send note events from control threads to the render thread while measuring.
+     * @param eventsPerSecond rate for each control thread, or 0 for no events
+     */
+    void setNoteEvents(int32_t eventsPerSecond, NoteQueueType queueType,
+                       int32_t numProducers) override {
+        mEventsPerSecond = eventsPerSecond;
+        mNoteQueueType = queueType;
+        mNumEventProducers = numProducers;
+    }
+
+    int32_t getEventsPerSecond() const {
+        return mEventsPerSecond;
+    }
+
+    NoteQueueType getNoteQueueType() const {
+        return mNoteQueueType;
+    }
+
+    int32_t getNumEventProducers() const {
+        return mNumEventProducers;
+    }
+
+    /**
+     * Play a Standard MIDI File instead of turning all the notes on and off.
+     * The number of voices limits the polyphony. The file loops until the end.
+     * @param fileName empty for no file
+     * @param tempoPercent 200 plays twice as fast
+     */
+    void setMidiFile(const std::string &fileName, int32_t tempoPercent) override {
+        mMidiFileName = fileName;
+        mMidiTempoPercent = tempoPercent;
+    }
+
+    const std::string &getMidiFileName() const {
+        return mMidiFileName;
+    }
+
+    /**
+     * Save a trace of the voices, note events and render time of each burst.
+     * @param fileName empty for no trace
+     */
+    void setTraceFile(const std::string &fileName) {
+        mTraceFileName = fileName;
+    }
+
+    const std::string &getTraceFileName() const {
+        return mTraceFileName;
+    }
+
+    /**
+     * Keep a history of the recent bursts and save it when the test ends.
+     * @param fileName empty for no flight recorder
+     * @param onlyOnGlitch save only if the audio glitched
+     */
+    void setFlightRecorderFile(const std::string &fileName, bool onlyOnGlitch = false) {
+        mFlightFileName = fileName;
+        mFlightOnlyOnGlitch = onlyOnGlitch;
+    }
+
+    const std::string &getFlightRecorderFileName() const {
+        return mFlightFileName;
+    }
+
+    /**
+     * Pass the options shared by every test to a harness that this one runs.
+     * The voice count is not copied because each caller chooses its own.
+     */
+    void copyParametersTo(ITestHarness *harness) const {
+        harness->setDelayNoteOnSeconds(mDelayNotesOn);
+        harness->setThreadType(mThreadType);
+        harness->setSampleType(mSampleType);
+        harness->setOversampling(mOversampling);
+        harness->setEffects(mEffectsFlags);
+        harness->setImpulseSeconds(mImpulseSeconds);
+        harness->setChannelCount(mChannelCount);
+        harness->setPipelineDepth(mPipelineDepth);
+        harness->setNoteEvents(mEventsPerSecond, mNoteQueueType, mNumEventProducers);
+        harness->setMidiFile(mMidiFileName, mMidiTempoPercent);
+    }
+
     SynthMarkResult *getResult() {
         return mResult;
     }
@@ -117,6 +263,20 @@ protected:
     int32_t          mNumVoicesHigh = 0;
 
     VoicesMode       mVoicesMode = VOICES_SWITCH;
+    SampleType       mSampleType = SampleType::Float;
+    int32_t          mOversampling = 1;
+    int32_t          mEffectsFlags = EFFECTS_NONE;
+    float            mImpulseSeconds = kDefaultImpulseSeconds;
+    int32_t          mChannelCount = SAMPLES_PER_FRAME;
+    int32_t          mPipelineDepth = 0;
+    int32_t          mEventsPerSecond = 0;
+    NoteQueueType    mNoteQueueType = NoteQueueType::LockFree;
+    int32_t          mNumEventProducers = 1;
+    std::string      mMidiFileName;
+    int32_t          mMidiTempoPercent = 100;
+    std::string      mTraceFileName;
+    std::string      mFlightFileName;
+    bool             mFlightOnlyOnGlitch = false;
 
     AudioSinkBase   *mAudioSink = nullptr;
     SynthMarkResult *mResult = nullptr;
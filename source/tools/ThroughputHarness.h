@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_THROUGHPUT_HARNESS_H
+#define SYNTHMARK_THROUGHPUT_HARNESS_H
+
+#include <cstdint>
+#include <sstream>
+
+#include "AudioSinkBase.h"
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "synth/Synthesizer.h"
+#include "tools/LogTool.h"
+#include "tools/TestHarnessBase.h"
+#include "TestHarnessParameters.h"
+
+/**
+ * Render a fixed amount of audio as fast as possible and report how many
+ * voice-seconds were rendered per wall-clock second and per CPU second.
+ * This should be used with an OfflineAudioSink so the result does not
+ * depend on the scheduler. It is intended for tracking DSP regressions.
+ */
+class ThroughputHarness : public TestHarnessBase {
+public:
+    ThroughputHarness(AudioSinkBase *audioSink,
+                      SynthMarkResult *result,
+                      LogTool *logTool = NULL)
+            : TestHarnessBase(audioSink, result, logTool)
+    {
+        mTestName = "Throughput";
+    }
+
+    virtual ~ThroughputHarness() {
+    }
+
+    virtual void onBeginMeasurement() override {
+        mResult->setTestName(mTestName);
+        mLogTool->log("---- Starting %s ----\n", mTestName.c_str());
+        mStartWallNanos = HostTools::getNanoTime();
+        mStartCpuNanos = HostTools::getThreadCpuNanoTime();
+    }
+
+    virtual void onEndMeasurement() override {
+        // The offline sink renders on this thread so its CPU time is the render cost.
+        int64_t wallNanos = HostTools::getNanoTime() - mStartWallNanos;
+        int64_t cpuNanos = HostTools::getThreadCpuNanoTime() - mStartCpuNanos;
+        double wallSeconds = (double) wallNanos / SYNTHMARK_NANOS_PER_SECOND;
+        double cpuSeconds = (double) cpuNanos / SYNTHMARK_NANOS_PER_SECOND;
+        double audioSeconds = (double) mFrameCounter / mSampleRate;
+        double voiceSeconds = audioSeconds * getNumVoices();
+
+        double perWallSecond = (wallSeconds > 0.0) ? (voiceSeconds / wallSeconds) : 0.0;
+        double perCpuSecond = (cpuSeconds > 0.0) ? (voiceSeconds / cpuSeconds) : 0.0;
+
+        std::stringstream resultMessage;
+        resultMessage << "audio.seconds = " << audioSeconds << std::endl;
+        resultMessage << "voice.seconds = " << voiceSeconds << std::endl;
+        resultMessage << "wall.seconds = " << wallSeconds << std::endl;
+        resultMessage << "cpu.seconds = " << cpuSeconds << std::endl;
+        if (wallSeconds > 0.0) {
+            resultMessage << "realtime.factor = " << (audioSeconds / wallSeconds) << std::endl;
+        }
+        resultMessage << "voice.seconds.per.wall.second = " << perWallSecond << std::endl;
+        resultMessage << "voice.seconds.per.cpu.second = " << perCpuSecond << std::endl;
+        resultMessage << mTestName << " = " << perCpuSecond << std::endl;
+
+        mResult->setMeasurement(perCpuSecond);
+        mResult->setResultCode(SYNTHMARK_RESULT_SUCCESS);
+        mResult->appendMessage(resultMessage.str());
+    }
+
+private:
+    int64_t mStartWallNanos = 0;
+    int64_t mStartCpuNanos = 0;
+};
+
+#endif // SYNTHMARK_THROUGHPUT_HARNESS_H
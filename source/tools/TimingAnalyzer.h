@@ -17,13 +17,18 @@
 #ifndef SYNTHMARK_TIMING_ANALYZER_H
 #define SYNTHMARK_TIMING_ANALYZER_H
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <ctime>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
 
-#include "BinCounter.h"
 #include "HostTools.h"
+#include "LatencyHistogram.h"
 #include "SynthMark.h"
 
 #if defined(__APPLE__)
@@ -34,24 +39,16 @@
 class TimingAnalyzer
 {
 public:
-    TimingAnalyzer()
-            : mWakeupBins(NULL)
-            , mRenderBins(NULL)
-            , mDeliveryBins(NULL)
-    {
+    TimingAnalyzer() {
         reset();
     }
 
-    virtual ~TimingAnalyzer() {
-        delete mWakeupBins;
-        delete mRenderBins;
-        delete mDeliveryBins;
-    }
+    virtual ~TimingAnalyzer() = default;
 
-    void setupHistograms(int32_t nanosPerBin, int32_t numBins) {
-        mWakeupBins = new BinCounter(numBins);
-        mRenderBins = new BinCounter(numBins);
-        mDeliveryBins = new BinCounter(numBins);
+    /**
+     * @param nanosPerBin width of the rows in the CSV printed by dumpJitter()
+     */
+    void setupHistograms(int32_t nanosPerBin) {
         mNanosPerBin = nanosPerBin;
     }
 
@@ -69,14 +66,14 @@ public:
         mIdealTime = idealTime;
         mEntryTime = now;
         if (mCallCount > 0) {
-            if (mWakeupBins != NULL) {
-                // Be fair. We can't wake up before we go to sleep.
-                int64_t realisticWakeTime = (mExitTime > idealTime) ? mExitTime : idealTime;
-                int64_t wakeupDelay = now - realisticWakeTime;
-                mTotalWakeupDelay += wakeupDelay;
-                int32_t binIndex = wakeupDelay / mNanosPerBin;
-                mWakeupBins->increment(binIndex);
+            // Be fair. We can't wake up before we go to sleep.
+            int64_t realisticWakeTime = (mExitTime > idealTime) ? mExitTime : idealTime;
+            int64_t wakeupDelay = now - realisticWakeTime;
+            mTotalWakeupDelay += wakeupDelay;
+            if (wakeupDelay > mMaxWakeupDelay) {
+                mMaxWakeupDelay = wakeupDelay;
             }
+            mWakeupHistogram.record(wakeupDelay);
         }
     }
 
@@ -88,19 +85,25 @@ public:
         // Calculate jitter delay values for histogram.
         mExitTime = now;
         if (mCallCount > 0) {
-            if (mRenderBins != NULL) {
-                int32_t binIndex = mLastRenderDuration / mNanosPerBin;
-                mRenderBins->increment(binIndex);
-            }
-            if (mDeliveryBins != NULL) {
-                int64_t deliveryTime = now - mIdealTime;
-                int32_t binIndex = deliveryTime / mNanosPerBin;
-                mDeliveryBins->increment(binIndex);
-            }
+            mRenderHistogram.record(mLastRenderDuration);
+            mDeliveryHistogram.record(now - mIdealTime);
         }
         mCallCount++;
     }
 
+    /**
+     * Called after markExit() with the effective CPU frequency of that render.
+     * The mean frequency is printed next to each row of the render histogram.
+     */
+    void recordFrequency(int32_t cpuSpeedMHz) {
+        if (mCallCount > 1 && cpuSpeedMHz > 0) {
+            int32_t index = LatencyHistogram::indexOf(mLastRenderDuration);
+            mRenderMHzSums[index] += cpuSpeedMHz;
+            mRenderMHzCounts[index]++;
+            mFrequencyCount++;
+        }
+    }
+
     void reset() {
         mBaseTime = 0;
         mIdealTime = 0;
@@ -109,9 +112,13 @@ public:
         mActiveTime = 0;
         mCallCount = 0;
         mTotalWakeupDelay = 0;
-        delete mWakeupBins;
-        delete mRenderBins;
-        delete mDeliveryBins;
+        mMaxWakeupDelay = 0;
+        mWakeupHistogram.reset();
+        mRenderHistogram.reset();
+        mDeliveryHistogram.reset();
+        mRenderMHzSums.assign(LatencyHistogram::kNumBuckets, 0);
+        mRenderMHzCounts.assign(LatencyHistogram::kNumBuckets, 0);
+        mFrequencyCount = 0;
     }
 
     int64_t getActiveTime() {
@@ -126,6 +133,10 @@ public:
         return mTotalWakeupDelay;
     }
 
+    int64_t getMaxWakeupDelayNanos() {
+        return mMaxWakeupDelay;
+    }
+
     int64_t getLastRenderDurationNanos() {
         return mLastRenderDuration;
     }
@@ -151,79 +162,155 @@ public:
         }
     }
 
-    BinCounter *getWakeupBins() {
-        return mWakeupBins;
+    const LatencyHistogram &getWakeupHistogram() const {
+        return mWakeupHistogram;
+    }
+    const LatencyHistogram &getRenderHistogram() const {
+        return mRenderHistogram;
     }
-    BinCounter *getRenderBins() {
-        return mRenderBins;
+    const LatencyHistogram &getDeliveryHistogram() const {
+        return mDeliveryHistogram;
     }
-    BinCounter *getDeliveryBins() {
-        return mDeliveryBins;
+
+    /**
+     * Report the tail percentiles of a histogram in microseconds.
+     */
+    static std::string dumpPercentiles(const std::string &prefix,
+                                       const LatencyHistogram &histogram) {
+        static const struct {
+            const char *name;
+            double      fraction;
+        } kPercentiles[] = {
+            {"p50", 0.50}, {"p90", 0.90}, {"p99", 0.99}, {"p999", 0.999}, {"p9999", 0.9999},
+        };
+        std::stringstream resultMessage;
+        for (const auto &percentile : kPercentiles) {
+            resultMessage << prefix << "." << percentile.name << ".usec = "
+                          << nanosToMicros(histogram.getValueAtPercentile(percentile.fraction))
+                          << std::endl;
+        }
+        resultMessage << prefix << ".max.usec = " << nanosToMicros(histogram.getMaxNanos())
+                      << std::endl;
+        return resultMessage.str();
     }
 
     std::string dumpJitter() {
         const bool showDeliveryTime = false;
+        const bool showFrequency = (mFrequencyCount > 0);
         std::stringstream resultMessage;
-        // Print jitter histogram
-        if (mWakeupBins != NULL && mRenderBins != NULL && mDeliveryBins != NULL) {
+        // Print jitter histogram with one row per mNanosPerBin.
+        if (mNanosPerBin > 0) {
+            std::map<int64_t, JitterRow> rows;
+            addRows(rows, mWakeupHistogram, &JitterRow::wakeup);
+            addRows(rows, mRenderHistogram, &JitterRow::render);
+            if (showDeliveryTime) {
+                addRows(rows, mDeliveryHistogram, &JitterRow::delivery);
+            }
+            if (showFrequency) {
+                addFrequencies(rows);
+            }
             resultMessage << TEXT_CSV_BEGIN << std::endl;
-            int32_t numBins = mDeliveryBins->getNumBins();
-            const int32_t *wakeupCounts = mWakeupBins->getBins();
-            const int32_t *wakeupLast = mWakeupBins->getLastMarkers();
-            const int32_t *renderCounts = mRenderBins->getBins();
-            const int32_t *renderLast = mRenderBins->getLastMarkers();
-            const int32_t *deliveryCounts = mDeliveryBins->getBins();
-            const int32_t *deliveryLast = mDeliveryBins->getLastMarkers();
             resultMessage << " bin#,  msec,"
                           << "   wakeup#,  wlast,"
                           << "   render#,  rlast";
             if (showDeliveryTime) {
                 resultMessage << " delivery#,  dlast";
             }
+            if (showFrequency) {
+                resultMessage << ",  rmhz";
+            }
             resultMessage << std::endl;
-            for (int i = 0; i < numBins; i++) {
-                if (wakeupCounts[i] > 0 || renderCounts[i] > 0
-                    || (deliveryCounts[i] > 0 && showDeliveryTime)) {
-                    double msec = (double) i * mNanosPerBin * SYNTHMARK_MILLIS_PER_SECOND
-                                  / SYNTHMARK_NANOS_PER_SECOND;
-                    resultMessage << "  " << std::setw(3) << i
-                                  << ", " << std::fixed << std::setw(5) << std::setprecision(2)
-                                  << msec
-                                  << ", " << std::setw(9) << wakeupCounts[i]
-                                  << ", " << std::setw(6) << wakeupLast[i]
-                                  << ", " << std::setw(9) << renderCounts[i]
-                                  << ", " << std::setw(6) << renderLast[i];
-                    if (showDeliveryTime) {
-                        resultMessage << ", " << std::setw(9) << deliveryCounts[i]
-                                      << ", " << std::setw(6) << deliveryLast[i];
-                    }
-                    resultMessage << std::endl;
+            for (const auto &entry : rows) {
+                const JitterRow &row = entry.second;
+                double msec = (double) entry.first * mNanosPerBin * SYNTHMARK_MILLIS_PER_SECOND
+                              / SYNTHMARK_NANOS_PER_SECOND;
+                resultMessage << "  " << std::setw(3) << entry.first
+                              << ", " << std::fixed << std::setw(5) << std::setprecision(2)
+                              << msec
+                              << ", " << std::setw(9) << row.wakeup.count
+                              << ", " << std::setw(6) << row.wakeup.last
+                              << ", " << std::setw(9) << row.render.count
+                              << ", " << std::setw(6) << row.render.last;
+                if (showDeliveryTime) {
+                    resultMessage << ", " << std::setw(9) << row.delivery.count
+                                  << ", " << std::setw(6) << row.delivery.last;
                 }
+                if (showFrequency) {
+                    int64_t mhz = (row.mhzCount > 0) ? (row.mhzSum / row.mhzCount) : 0;
+                    resultMessage << ", " << std::setw(5) << mhz;
+                }
+                resultMessage << std::endl;
             }
             resultMessage << TEXT_CSV_END << std::endl;
-
-            double averageWakeupDelayMicros = getTotalWakeupDelayNanos()
-                    / (double) (mCallCount * SYNTHMARK_NANOS_PER_MICROSECOND);
-            resultMessage << "average.wakeup.delay.micros = " << averageWakeupDelayMicros
-                          << std::endl;
-        } else {
-            resultMessage << "ERROR NULL BinCounter!\n";
         }
+
+        double averageWakeupDelayMicros = getTotalWakeupDelayNanos()
+                / (double) (mCallCount * SYNTHMARK_NANOS_PER_MICROSECOND);
+        resultMessage << std::fixed << std::setprecision(2);
+        resultMessage << "average.wakeup.delay.micros = " << averageWakeupDelayMicros
+                      << std::endl;
+        resultMessage << dumpPercentiles("wakeup", mWakeupHistogram);
+        resultMessage << dumpPercentiles("render", mRenderHistogram);
+        resultMessage << dumpPercentiles("delivery", mDeliveryHistogram);
         return resultMessage.str();
     }
 
 private:
+    struct JitterCell {
+        int64_t count = 0;
+        int32_t last = 0;
+    };
+
+    struct JitterRow {
+        JitterCell wakeup;
+        JitterCell render;
+        JitterCell delivery;
+        int64_t    mhzSum = 0;   // CPU frequency of the renders in this row
+        int64_t    mhzCount = 0;
+    };
+
+    // Sum the log-linear buckets into linear rows for the CSV.
+    void addRows(std::map<int64_t, JitterRow> &rows, const LatencyHistogram &histogram,
+                 JitterCell JitterRow::*cell) const {
+        for (int32_t i = 0; i < LatencyHistogram::kNumBuckets; i++) {
+            int64_t count = histogram.getCount(i);
+            if (count > 0) {
+                JitterCell &target = rows[LatencyHistogram::getLowestValue(i) / mNanosPerBin].*cell;
+                target.count += count;
+                target.last = std::max(target.last, histogram.getLastMarker(i));
+            }
+        }
+    }
+
+    void addFrequencies(std::map<int64_t, JitterRow> &rows) const {
+        for (int32_t i = 0; i < LatencyHistogram::kNumBuckets; i++) {
+            if (mRenderMHzCounts[i] > 0) {
+                JitterRow &row = rows[LatencyHistogram::getLowestValue(i) / mNanosPerBin];
+                row.mhzSum += mRenderMHzSums[i];
+                row.mhzCount += mRenderMHzCounts[i];
+            }
+        }
+    }
+
+    static double nanosToMicros(int64_t nanos) {
+        return (double) nanos / SYNTHMARK_NANOS_PER_MICROSECOND;
+    }
+
     int64_t  mBaseTime;
     int64_t  mIdealTime;
     int64_t  mEntryTime;
     int64_t  mExitTime;
     int64_t  mActiveTime;
     int64_t  mTotalWakeupDelay;
+    int64_t  mMaxWakeupDelay;
     int64_t  mLastRenderDuration = 0;
-    BinCounter *mWakeupBins;
-    BinCounter *mRenderBins;
-    BinCounter *mDeliveryBins;
-    int32_t  mNanosPerBin;
+    LatencyHistogram mWakeupHistogram;
+    LatencyHistogram mRenderHistogram;
+    LatencyHistogram mDeliveryHistogram;
+    std::vector<int64_t> mRenderMHzSums;
+    std::vector<int64_t> mRenderMHzCounts;
+    int64_t  mFrequencyCount = 0;
+    int32_t  mNanosPerBin = 0;
     int32_t  mCallCount;
 };
 
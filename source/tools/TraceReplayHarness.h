@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_TRACE_REPLAY_HARNESS_H
+#define SYNTHMARK_TRACE_REPLAY_HARNESS_H
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "AudioSinkBase.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+#include "tools/LogTool.h"
+#include "tools/TestHarnessBase.h"
+#include "tools/WorkloadTrace.h"
+
+/**
+ * Drive the synthesizer from a workload trace, burst by burst, so that
+ * a load pattern captured with -Y can be reproduced exactly in the lab.
+ *
+ * Before each burst the voice count recorded for it is passed to
+ * HostCpuManager::setApplicationLoad() as a workload hint. The trace
+ * loops if the test is longer. Use the same burst size as the capture.
+ *
+ * The result is the mean render time of the replay divided by the mean
+ * render time in the trace.
+ */
+class TraceReplayHarness : public TestHarnessBase {
+public:
+    TraceReplayHarness(AudioSinkBase *audioSink,
+                       SynthMarkResult *result,
+                       LogTool *logTool = nullptr)
+            : TestHarnessBase(audioSink, result, logTool) {
+        mTestName = "TraceReplay";
+    }
+
+    virtual ~TraceReplayHarness() {}
+
+    /**
+     * Read the trace before running the test.
+     */
+    int32_t loadTrace(const std::string &fileName) {
+        int32_t result = mTrace.load(fileName);
+        if (result < 0) {
+            mLogTool->log("ERROR %s\n", mTrace.getErrorText().c_str());
+        }
+        return result;
+    }
+
+    void onBeginMeasurement() override {
+        mResult->setTestName(mTestName);
+        const WorkloadTraceHeader &header = mTrace.getHeader();
+        mLogTool->log("---- Replay %d bursts captured at %d Hz, %d frames per burst ----\n",
+                      (int) mTrace.getBurstCount(), header.sampleRate, header.framesPerBurst);
+        if (header.framesPerBurst != mFramesPerBurst || header.sampleRate != mSampleRate) {
+            mLogTool->log("WARNING the trace was not captured with this burst size and rate\n");
+        }
+        setupHistograms();
+        mNextRecord = 0;
+        mLoopCount = 0;
+        mLastHint = -1;
+        mTraceRenderNanos = 0;
+        mNumEvents = 0;
+    }
+
+    /**
+     * Apply the notes recorded for the next burst instead of turning notes on and off.
+     */
+    IAudioSinkCallback::Result updateNotes(int64_t framePosition) override {
+        const std::vector<WorkloadTraceRecord> &records = mTrace.getRecords();
+        mNumEvents = 0;
+        for (;;) {
+            if (mNextRecord >= records.size()) {
+                mNextRecord = 0;
+                mLoopCount++;
+            }
+            const WorkloadTraceRecord &record = records[mNextRecord++];
+            if (applyRecord(record) < 0) {
+                mResult->setResultCode(SYNTHMARK_RESULT_UNRECOVERABLE_ERROR);
+                return IAudioSinkCallback::Result::Finished;
+            }
+            if (record.type == (uint32_t) TraceRecordType::Burst) {
+                break;
+            }
+        }
+        return IAudioSinkCallback::Result::Continue;
+    }
+
+    void renderVoices(float *buffer, int32_t numFrames) override {
+        if (mNumEvents == 0) {
+            mSynth.render(buffer, numFrames);
+            return;
+        }
+        // The burst may be shorter than when it was captured.
+        for (int32_t i = 0; i < mNumEvents; i++) {
+            mOffsets[i] = std::min(mOffsets[i], numFrames - 1);
+        }
+        mSynth.renderWithEvents(buffer, numFrames, mEvents, mOffsets, mNumEvents);
+    }
+
+    void onEndMeasurement() override {
+        std::stringstream resultMessage;
+        int64_t count = (mRenderCount > 0) ? mRenderCount : 1;
+        double replayMean = (double) mRenderNanos / count;
+        double traceMean = (double) mTraceRenderNanos / count;
+        double measurement = (traceMean > 0.0) ? (replayMean / traceMean) : 0.0;
+        resultMessage << mTestName << " = " << measurement << std::endl;
+        resultMessage << "trace.bursts = " << mTrace.getBurstCount() << std::endl;
+        resultMessage << "trace.loops = " << mLoopCount << std::endl;
+        resultMessage << "trace.render.nanos.mean = " << (int64_t) traceMean << std::endl;
+        resultMessage << "replay.render.nanos.mean = " << (int64_t) replayMean << std::endl;
+        resultMessage << dumpJitter();
+        resultMessage << "underrun.count = " << mAudioSink->getUnderrunCount() << std::endl;
+        resultMessage << mCpuAnalyzer.dump();
+        resultMessage << mPerfAnalyzer.dump();
+        mResult->setMeasurement(measurement);
+        mResult->appendMessage(resultMessage.str());
+    }
+
+private:
+    int32_t applyRecord(const WorkloadTraceRecord &record) {
+        switch ((TraceRecordType) record.type) {
+            case TraceRecordType::Burst:
+                mTraceRenderNanos += record.nanos;
+                if (record.value != mLastHint) {
+                    mAudioSink->getCpuManager()->setApplicationLoad(record.value,
+                                                                     kSynthmarkMaxVoices);
+                    mLastHint = record.value;
+                }
+                return 0;
+            case TraceRecordType::NoteOn:
+            case TraceRecordType::NoteOff:
+                if (mNumEvents < kNoteEventsPerBurst) {
+                    NoteEvent &event = mEvents[mNumEvents];
+                    event.timestampNanos = 0;
+                    event.type = ((TraceRecordType) record.type == TraceRecordType::NoteOn)
+                            ? NoteEventType::NoteOn : NoteEventType::NoteOff;
+                    event.voiceIndex = record.value;
+                    event.pitch = record.pitch;
+                    event.velocity = record.velocity;
+                    mOffsets[mNumEvents] = std::max(record.frames, 0);
+                    mNumEvents++;
+                }
+                return 0;
+            case TraceRecordType::NotesOn:
+                return mSynth.notesOn(std::min(record.value, (int32_t) kSynthmarkMaxVoices));
+            case TraceRecordType::AllNotesOff:
+                mSynth.allNotesOff();
+                return 0;
+            case TraceRecordType::Polyphony:
+                return mSynth.setPolyphony(std::min(record.value, (int32_t) kSynthmarkMaxVoices));
+        }
+        return 0; // skip records from newer versions
+    }
+
+    WorkloadTraceReader mTrace;
+    size_t              mNextRecord = 0;
+    int32_t             mLoopCount = 0;
+    int32_t             mLastHint = -1;
+    int64_t             mTraceRenderNanos = 0;
+    NoteEvent           mEvents[kNoteEventsPerBurst];
+    int32_t             mOffsets[kNoteEventsPerBurst];
+    int32_t             mNumEvents = 0;
+};
+
+#endif // SYNTHMARK_TRACE_REPLAY_HARNESS_H
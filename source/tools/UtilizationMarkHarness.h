@@ -90,6 +90,7 @@ public:
         mResult->setResultCode(resultCode);
 
         resultMessage << mCpuAnalyzer.dump();
+        resultMessage << mPerfAnalyzer.dump();
 
         mResult->setMeasurement(measurement);
         mResult->appendMessage(resultMessage.str());
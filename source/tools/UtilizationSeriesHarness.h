@@ -84,8 +84,7 @@ public:
         VoiceMarkHarness *harness = new VoiceMarkHarness(mAudioSink, &result1);
         harness->setTargetCpuLoad(fractionUtilization);
         harness->setInitialVoiceCount(getNumVoices());
-        harness->setDelayNoteOnSeconds(mDelayNotesOn);
-        harness->setThreadType(mThreadType);
+        copyParametersTo(harness);
 
         int32_t err = harness->runTest(sampleRate, framesPerBurst, 15);
         delete harness;
@@ -110,8 +109,7 @@ public:
         SynthMarkResult result1;
         UtilizationMarkHarness *harness = new UtilizationMarkHarness(mAudioSink, &result1);
         harness->setNumVoices(numVoices);
-        harness->setDelayNoteOnSeconds(mDelayNotesOn);
-        harness->setThreadType(mThreadType);
+        copyParametersTo(harness);
 
         int32_t err = harness->runTest(sampleRate, framesPerBurst, numSeconds);
         delete harness;
@@ -22,11 +22,13 @@
 #include <unistd.h>
 
 #include "AudioSinkBase.h"
+#include "HardwareTimingModel.h"
 #include "HostTools.h"
 #include "HostThreadFactory.h"
 #include "LogTool.h"
 #include "SynthMark.h"
 #include "SynthMarkResult.h"
+#include "SynthTools.h"
 
 constexpr int kMaxBufferCapacityInBursts = 128;
 
@@ -68,13 +70,15 @@ public:
 
         int64_t nanosPerBurst = mFramesPerBurst * SYNTHMARK_NANOS_PER_SECOND / mSampleRate;
         mNanosPerBurst = (int32_t) nanosPerBurst;
-        HostCpuManager::getInstance()->setNanosPerBurst(nanosPerBurst);
+        getCpuManager()->setNanosPerBurst(nanosPerBurst);
 
         delete[] mBurstBuffer;
         mBurstBuffer = nullptr;
-        mBurstBuffer = new float[samplesPerFrame * framesPerBurst];
+        // Random callback sizes may be up to twice the burst size.
+        mBurstBuffer = new float[samplesPerFrame * framesPerBurst * 2];
 
         mNextHardwareReadTimeNanos = 0;
+        mLastHardwareReadTimeNanos = 0;
         mFramesConsumed = 0;
         mStartTimeNanos = 0;
         return result;
@@ -84,6 +88,14 @@ public:
         return (int64_t) (mStartTimeNanos + (framePosition * mNanosPerBurst / mFramesPerBurst));
     }
 
+    /**
+     * Use the simulated read schedule so that callbacks of any size share the same reference.
+     * @return time of the last simulated hardware read, or zero before the first read
+     */
+    int64_t getIdealCallbackTime() override {
+        return mLastHardwareReadTimeNanos;
+    }
+
     int32_t getEmptyFramesAvailable() {
         return getBufferSizeInFrames() - getFullFramesAvailable();
     }
@@ -100,6 +112,10 @@ public:
         mDefaultBufferSizeInBursts = numBursts;
     }
 
+    int32_t getDefaultBufferSizeInBursts() const {
+        return mDefaultBufferSizeInBursts;
+    }
+
     /**
      * Set the amount of the buffer that will be used. Determines latency.
      */
@@ -121,12 +137,13 @@ public:
         return mMaxBufferCapacityInFrames;
     }
 
-    virtual void writeBurst(const float *buffer) {
+    virtual void writeBurst(const float *buffer, int32_t numFrames) {
         (void) buffer; // discard the audio data
 
         if (mStartTimeNanos == 0) {
             mStartTimeNanos = HostTools::getNanoTime();
-            mNextHardwareReadTimeNanos = mStartTimeNanos;
+            mTimingModel.start(mStartTimeNanos, mSampleRate, mFramesPerBurst);
+            mNextHardwareReadTimeNanos = mTimingModel.getNextReadTime();
         }
 
         int32_t availableData = getFullFramesAvailable();
@@ -138,17 +155,48 @@ public:
         updateHardwareSimulator();
         int32_t availableRoom = getEmptyFramesAvailable();
 
-        // If there is not enough room then sleep until the hardware reads another burst.
-        if (availableRoom < mFramesPerBurst) {
-            HostCpuManager::getInstance()->sleepAndTuneCPU(mNextHardwareReadTimeNanos);
-            updateHardwareSimulator();
+        // If there is not enough room then sleep until the hardware reads more.
+        // A write bigger than the whole buffer only waits for the buffer to empty.
+        int32_t roomNeeded = (numFrames < getBufferSizeInFrames())
+                ? numFrames : getBufferSizeInFrames();
+        mLastSleepTargetNanos = 0;
+        if (availableRoom < roomNeeded) {
+            while (availableRoom < roomNeeded) {
+                mLastSleepTargetNanos = mNextHardwareReadTimeNanos;
+                getCpuManager()->sleepAndTuneCPU(mNextHardwareReadTimeNanos);
+                updateHardwareSimulator();
+                availableRoom = getEmptyFramesAvailable();
+            }
         } else {
             // Just let CPU Manager know that a burst has occurred.
-            HostCpuManager::getInstance()->sleepAndTuneCPU(0);
+            getCpuManager()->sleepAndTuneCPU(0);
         }
 
         // Simulate writing to a buffer.
-        setFramesWritten(getFramesWritten() + mFramesPerBurst);
+        setFramesWritten(getFramesWritten() + numFrames);
+    }
+
+    /**
+     * Request a random number of frames in each callback, like some real drivers.
+     * The sizes average to one burst. Default is exactly one burst per callback.
+     */
+    void setRandomCallbackSizes(bool enabled) {
+        mRandomCallbackSizes = enabled;
+    }
+
+    bool isRandomCallbackSizes() const {
+        return mRandomCallbackSizes;
+    }
+
+    /**
+     * Set how the simulated hardware reads the buffer. Default is one burst per period.
+     */
+    void setTimingModel(const HardwareTimingModel &model) {
+        mTimingModel = model;
+    }
+
+    const HardwareTimingModel &getTimingModel() const {
+        return mTimingModel;
     }
 
     HostThread *getHostThread() {
@@ -159,6 +207,10 @@ public:
     }
 
     virtual int32_t start() override {
+        int32_t result = fitBufferToFramesPerRead();
+        if (result < 0) {
+            return result;
+        }
         setFramesWritten(getBufferSizeInFrames());  // start full and primed
 
         if (mUseRealThread) {
@@ -189,6 +241,27 @@ public:
         mThreadType = threadType;
     }
 
+protected:
+
+    /**
+     * The simulated device cannot read more than the buffer holds.
+     * Grow the buffer to fit one read, or fail if that is more than the capacity.
+     */
+    int32_t fitBufferToFramesPerRead() {
+        int32_t framesPerRead = mTimingModel.getRequestedFramesPerRead();
+        if (framesPerRead > mMaxBufferCapacityInFrames) {
+            printf("ERROR in VirtualAudioSink, frames per read = %d > capacity = %d\n",
+                   framesPerRead, mMaxBufferCapacityInFrames);
+            return SYNTHMARK_RESULT_AUDIO_SINK_START_FAILURE;
+        }
+        if (framesPerRead > getBufferSizeInFrames()) {
+            setBufferSizeInFrames(framesPerRead);
+            printf("VirtualAudioSink: buffer size raised to %d frames to fit one read\n",
+                   getBufferSizeInFrames());
+        }
+        return SYNTHMARK_RESULT_SUCCESS;
+    }
+
 private:
 
     /**
@@ -206,7 +279,7 @@ private:
                 if (HostCpuManager::areWorkloadHintsEnabled()) {
                     double initial_bw = BW_MAX;
 
-                    int err = static_cast<CustomHostCpuManager *>(HostCpuManager::getInstance())->updateDeadlineParams(
+                    int err = static_cast<CustomHostCpuManager *>(getCpuManager())->updateDeadlineParams(
                             mNanosPerBurst * initial_bw,
                             mNanosPerBurst,
                             mNanosPerBurst);
@@ -240,15 +313,17 @@ private:
             // Write in a loop until the callback says we are done.
             IAudioSinkCallback::Result callbackResult
                     = IAudioSinkCallback::Result::Continue;
+            mCallbackSizeRandom.setSeed(kInitialCallbackSizeSeed);
             while (callbackResult == IAudioSinkCallback::Result::Continue
                    && result == SYNTHMARK_RESULT_SUCCESS) {
 
                 // Call the synthesizer to render the audio data.
-                callbackResult = fireCallback(mBurstBuffer, mFramesPerBurst);
+                int32_t numFrames = nextCallbackSize();
+                callbackResult = fireCallback(mBurstBuffer, numFrames);
 
                 if (callbackResult == IAudioSinkCallback::Result::Continue) {
                     // Output the audio using a blocking write.
-                    writeBurst(mBurstBuffer);
+                    writeBurst(mBurstBuffer, numFrames);
                 } else if (callbackResult != IAudioSinkCallback::Result::Finished) {
                     result = callbackResult;
                 }
@@ -258,6 +333,17 @@ private:
         return result;
     }
 
+    /**
+     * @return mFramesPerBurst, or a random size between 1 and (2 * mFramesPerBurst) - 1
+     */
+    int32_t nextCallbackSize() {
+        if (!mRandomCallbackSizes) {
+            return mFramesPerBurst;
+        }
+        uint32_t random = mCallbackSizeRandom.nextRandomInteger();
+        return 1 + (int32_t) (random % (uint32_t) ((2 * mFramesPerBurst) - 1));
+    }
+
     static void * threadProcWrapper(void *arg) {
         VirtualAudioSink *sink = (VirtualAudioSink *) arg;
         sink->innerCallbackLoop();
@@ -286,6 +372,7 @@ private:
     int64_t mStartTimeNanos = 0;
     int32_t mNanosPerBurst = 1; // set in open
     int64_t mNextHardwareReadTimeNanos = 0;
+    int64_t mLastHardwareReadTimeNanos = 0;
     int32_t mBufferSizeInFrames = 0;
     int32_t mMaxBufferCapacityInFrames = 0;
     int32_t mDefaultBufferSizeInBursts = kBufferSizeInBursts;
@@ -296,6 +383,11 @@ private:
     int32_t mCallbackLoopResult = 0;
     HostThread * mThread = NULL;
     HostThreadFactory::ThreadType mThreadType = HostThreadFactory::ThreadType::Audio;
+    HardwareTimingModel mTimingModel;
+    bool    mRandomCallbackSizes = false;
+    // Each run uses the same sequence of sizes so the results are repeatable.
+    static constexpr uint64_t kInitialCallbackSizeSeed = 87654321;
+    PseudoRandom mCallbackSizeRandom{kInitialCallbackSizeSeed};
 
     LogTool    * mLogTool = NULL;
 
@@ -305,8 +397,10 @@ private:
         int countdown = 32; // Avoid spinning like crazy.
         // Is it time to consume a block?
         while ((currentTime >= mNextHardwareReadTimeNanos) && (countdown-- > 0)) {
-            mFramesConsumed += mFramesPerBurst; // fake read
-            mNextHardwareReadTimeNanos += mNanosPerBurst; // avoid drift
+            mFramesConsumed += mTimingModel.getFramesPerRead(); // fake read
+            mLastHardwareReadTimeNanos = mNextHardwareReadTimeNanos;
+            mTimingModel.advance();
+            mNextHardwareReadTimeNanos = mTimingModel.getNextReadTime();
         }
     }
 
@@ -131,6 +131,7 @@ public:
         mResult->setResultCode(resultCode);
 
         resultMessage << mCpuAnalyzer.dump();
+        resultMessage << mPerfAnalyzer.dump();
 
         mResult->setMeasurement(measurement);
         mResult->appendMessage(resultMessage.str());
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VOICEMARK_SERIES_HARNESS_H
+#define ANDROID_VOICEMARK_SERIES_HARNESS_H
+
+#include <sstream>
+
+#include "synth/SampleTraits.h"
+#include "TestHarnessParameters.h"
+#include "VoiceMarkHarness.h"
+
+/**
+ * Run VoiceMark once for each sample type and/or oversampling factor so that
+ * the scores can be compared. Types or factors that are not swept use the
+ * values set by setSampleType() and setOversampling().
+ */
+class VoiceMarkSeriesHarness : public TestHarnessParameters {
+
+public:
+    VoiceMarkSeriesHarness(AudioSinkBase *audioSink,
+                           SynthMarkResult *result,
+                           LogTool *logTool = nullptr)
+            : TestHarnessParameters(audioSink, result, logTool) {}
+
+    virtual ~VoiceMarkSeriesHarness() {}
+
+    const char *getName() const override {
+        return "VoiceMark Series";
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        int32_t err = SYNTHMARK_RESULT_SUCCESS;
+        std::stringstream resultMessage;
+        int firstType = mSweepSampleTypes ? 0 : (int) mSampleType;
+        int lastType = mSweepSampleTypes ? (kNumSampleTypes - 1) : (int) mSampleType;
+        int firstFactor = mSweepOversampling ? 1 : mOversampling;
+        int lastFactor = mSweepOversampling ? kSynthmarkMaxOversampling : mOversampling;
+        for (int type = firstType; type <= lastType && err == SYNTHMARK_RESULT_SUCCESS; type++) {
+            SampleType sampleType = (SampleType) type;
+            for (int factor = firstFactor; factor <= lastFactor; factor *= 2) {
+                double voiceMark = 0.0;
+                err = measureVoiceMark(sampleRate, framesPerBurst, numSeconds,
+                                       sampleType, factor, &voiceMark);
+                if (err != SYNTHMARK_RESULT_SUCCESS) {
+                    break;
+                }
+                resultMessage << "voice.mark." << sampleTypeToString(sampleType);
+                if (mSweepOversampling || factor != 1) {
+                    resultMessage << ".x" << factor;
+                }
+                resultMessage << " = " << voiceMark << std::endl;
+            }
+        }
+        mResult->setResultCode(err);
+        mResult->appendMessage(resultMessage.str());
+        return err;
+    }
+
+    void setTargetCpuLoad(double load) {
+        mFractionOfCpu = load;
+    }
+
+    void setSweepSampleTypes(bool enabled) {
+        mSweepSampleTypes = enabled;
+    }
+
+    void setSweepOversampling(bool enabled) {
+        mSweepOversampling = enabled;
+    }
+
+private:
+    int32_t measureVoiceMark(int32_t sampleRate,
+                             int32_t framesPerBurst,
+                             int32_t numSeconds,
+                             SampleType sampleType,
+                             int32_t oversampling,
+                             double *voiceMarkPtr) {
+        SynthMarkResult result1;
+        VoiceMarkHarness *harness = new VoiceMarkHarness(mAudioSink, &result1);
+        harness->setTargetCpuLoad(mFractionOfCpu);
+        harness->setInitialVoiceCount(getNumVoices());
+        copyParametersTo(harness);
+        harness->setSampleType(sampleType);
+        harness->setOversampling(oversampling);
+
+        mLogTool->log("---- VoiceMark using %s samples, oversampling x%d ----\n",
+                      sampleTypeToString(sampleType), oversampling);
+        int32_t err = harness->runTest(sampleRate, framesPerBurst, numSeconds);
+        delete harness;
+        if (err != SYNTHMARK_RESULT_SUCCESS) {
+            return err;
+        }
+        err = result1.getResultCode();
+        *voiceMarkPtr = result1.getMeasurement();
+        return err;
+    }
+
+    double mFractionOfCpu = 0.5;
+    bool   mSweepSampleTypes = false;
+    bool   mSweepOversampling = false;
+};
+
+#endif // ANDROID_VOICEMARK_SERIES_HARNESS_H
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_WAKEUP_MARK_HARNESS_H
+#define SYNTHMARK_WAKEUP_MARK_HARNESS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "AudioSinkBase.h"
+#include "HandoffChannels.h"
+#include "HandoffPingPong.h"
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "TestHarnessParameters.h"
+
+constexpr int32_t kWakeupMarkNumMechanisms = 7;
+constexpr int32_t kWakeupMarkNumPolicies = 2;
+constexpr int32_t kWakeupMarkNumPlacements = 2;
+
+/**
+ * Compare the ways one thread can wake another: condition variable, futex,
+ * eventfd, pipe, POSIX semaphore, signal and busy polling.
+ *
+ * Each mechanism is measured with SCHED_OTHER and with SCHED_FIFO,
+ * with both threads on the same CPU and on different CPUs.
+ * SCHED_FIFO is skipped if it cannot be granted, and the cross core case
+ * is skipped on a single CPU host. See HandoffPingPong for the measurement.
+ * No audio is rendered.
+ *
+ * The result is the p99 fan-out latency of the futex under SCHED_FIFO on
+ * different CPUs, or the closest case that could be run.
+ */
+class WakeupMarkHarness : public TestHarnessParameters {
+
+public:
+    WakeupMarkHarness(AudioSinkBase *audioSink,
+                      SynthMarkResult *result,
+                      LogTool *logTool = nullptr)
+            : TestHarnessParameters(audioSink, result, logTool) {}
+
+    virtual ~WakeupMarkHarness() {}
+
+    const char *getName() const override {
+        return "WakeupMark";
+    }
+
+    int32_t runTest(int32_t sampleRate, int32_t framesPerBurst, int32_t numSeconds) override {
+        int cpuCount = HostTools::getCpuCount();
+        int32_t numPlacements = (cpuCount > 1) ? kWakeupMarkNumPlacements : 1;
+        mIterations = calculateHandoffIterations(numSeconds,
+                kWakeupMarkNumMechanisms * kWakeupMarkNumPolicies * numPlacements);
+        mFifoAvailable = true;
+        mHeadlineMicros = 0.0;
+        mHeadlineRank = -1;
+
+        std::stringstream resultMessage;
+        resultMessage << "wakeup.iterations = " << mIterations << std::endl;
+        resultMessage << "wakeup.gap.usec = "
+                      << (kHandoffGapNanos / SYNTHMARK_NANOS_PER_MICROSECOND) << std::endl;
+        int32_t err = SYNTHMARK_RESULT_SUCCESS;
+        for (int32_t placement = 0; placement < numPlacements; placement++) {
+            // With no affinity support let the scheduler place the threads.
+            int leaderCpu = (cpuCount > 0) ? 0 : SYNTHMARK_CPU_UNSPECIFIED;
+            int followerCpu = (cpuCount > 0) ? placement : SYNTHMARK_CPU_UNSPECIFIED;
+            for (int32_t policy = 0; policy < kWakeupMarkNumPolicies; policy++) {
+                bool useFifo = (policy == 1);
+                if (useFifo && !mFifoAvailable) {
+                    continue;
+                }
+                Scenario scenario;
+                scenario.leaderCpu = leaderCpu;
+                scenario.followerCpu = followerCpu;
+                scenario.useFifo = useFifo;
+                scenario.placement = (placement == 0) ? "same.core" : "cross.core";
+                err = runScenario<CondVarChannel>("condvar", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+                err = runScenario<FutexChannel>("futex", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+                err = runScenario<EventFdChannel>("eventfd", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+                err = runScenario<PipeChannel>("pipe", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+                err = runScenario<PosixSemaphoreChannel>("posix.sem", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+                err = runScenario<SignalChannel>("signal", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+                err = runScenario<BusyPollChannel>("busy.poll", scenario, resultMessage);
+                if (err != SYNTHMARK_RESULT_SUCCESS) break;
+            }
+            if (err != SYNTHMARK_RESULT_SUCCESS) break;
+        }
+        resultMessage << "wakeup.fifo.available = " << (mFifoAvailable ? 1 : 0) << std::endl;
+        resultMessage << "wakeup.cross.core.available = " << ((numPlacements > 1) ? 1 : 0)
+                      << std::endl;
+        resultMessage << getName() << " = " << mHeadlineMicros << std::endl;
+        mResult->setTestName(getName());
+        mResult->setMeasurement(mHeadlineMicros);
+        mResult->setResultCode(err);
+        mResult->appendMessage(resultMessage.str());
+        return err;
+    }
+
+private:
+    struct Scenario {
+        int         leaderCpu;
+        int         followerCpu;
+        bool        useFifo;
+        const char *placement;
+    };
+
+    template <typename Channel>
+    int32_t runScenario(const char *name, const Scenario &scenario,
+                        std::stringstream &resultMessage) {
+        const char *policyName = scenario.useFifo ? "fifo" : "other";
+        std::stringstream prefixStream;
+        prefixStream << "wakeup." << name << "." << policyName << "." << scenario.placement
+                     << ".";
+        std::string prefix = prefixStream.str();
+
+        HandoffPingPong<Channel> pingPong(mIterations, scenario.leaderCpu,
+                                          scenario.followerCpu, scenario.useFifo);
+        if (!pingPong.toFollower.isValid() || !pingPong.toLeader.isValid()) {
+            resultMessage << prefix << "available = 0" << std::endl;
+            return SYNTHMARK_RESULT_SUCCESS;
+        }
+        mLogTool->log("---- WakeupMark %s, SCHED_%s, %s ----\n", name,
+                      scenario.useFifo ? "FIFO" : "OTHER", scenario.placement);
+        int32_t err = pingPong.run();
+        if (err != SYNTHMARK_RESULT_SUCCESS) {
+            return err;
+        }
+        if (scenario.useFifo && !pingPong.wasFifoUsed()) {
+            // Results under SCHED_OTHER would be mislabeled so drop them.
+            mFifoAvailable = false;
+            mLogTool->log("SCHED_FIFO not granted, skipping\n");
+            return SYNTHMARK_RESULT_SUCCESS;
+        }
+        pingPong.report(prefix, resultMessage);
+
+        if (std::string(name) == "futex") {
+            // Prefer FIFO, then cross core.
+            int32_t rank = (scenario.useFifo ? 2 : 0)
+                           + ((scenario.leaderCpu != scenario.followerCpu) ? 1 : 0);
+            if (rank > mHeadlineRank) {
+                mHeadlineRank = rank;
+                mHeadlineMicros = pingPong.getFanOutMicros(0.99);
+            }
+        }
+        return SYNTHMARK_RESULT_SUCCESS;
+    }
+
+    int32_t mIterations = kHandoffMinIterations;
+    bool    mFifoAvailable = true;
+    double  mHeadlineMicros = 0.0;
+    int32_t mHeadlineRank = -1;
+};
+
+#endif // SYNTHMARK_WAKEUP_MARK_HARNESS_H
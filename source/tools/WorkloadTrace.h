@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHMARK_WORKLOAD_TRACE_H
+#define SYNTHMARK_WORKLOAD_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "HostTools.h"
+#include "SynthMark.h"
+#include "SynthMarkResult.h"
+
+/**
+ * Binary trace of the work done by the render thread, burst by burst.
+ *
+ * The file starts with a WorkloadTraceHeader followed by WorkloadTraceRecords,
+ * all in the byte order of the host. The note records for a burst come before
+ * the Burst record that ends it. Other engines can write the same format
+ * so their load can be replayed with -tr.
+ */
+constexpr char     kWorkloadTraceMagic[4] = {'S', 'M', 'W', 'T'};
+constexpr uint32_t kWorkloadTraceVersion = 1;
+
+// Records the render thread may get ahead of the writer thread.
+constexpr int32_t kWorkloadTraceRingCapacity = 64 * 1024;
+
+// How often the writer thread checks for more records.
+constexpr int64_t kWorkloadTracePollNanos = 2 * SYNTHMARK_NANOS_PER_MILLISECOND;
+
+enum class TraceRecordType : uint32_t {
+    Burst = 1,   // value = voices rendered, frames = burst size, nanos = render time
+    NoteOn,      // value = voice index, frames = offset in the burst, pitch, velocity
+    NoteOff,     // value = voice index, frames = offset in the burst, pitch
+    NotesOn,     // value = number of voices turned on together
+    AllNotesOff,
+    Polyphony,   // value = voices available to the voice allocator
+};
+
+struct WorkloadTraceHeader {
+    char     magic[4];
+    uint32_t version;
+    int32_t  sampleRate;
+    int32_t  framesPerBurst;
+};
+
+struct WorkloadTraceRecord {
+    uint32_t type;
+    int32_t  value;
+    int32_t  frames;
+    float    pitch;
+    float    velocity;
+    int32_t  reserved;
+    int64_t  nanos;
+};
+
+static_assert(sizeof(WorkloadTraceHeader) == 16, "trace header must be 16 bytes");
+static_assert(sizeof(WorkloadTraceRecord) == 32, "trace record must be 32 bytes");
+
+/**
+ * Save trace records without blocking the render thread.
+ *
+ * The render thread puts records in a lock-free ring. A normal priority
+ * writer thread drains the ring to the file. If the writer falls behind
+ * then the record is dropped and counted.
+ */
+class WorkloadTraceWriter
+{
+public:
+    ~WorkloadTraceWriter() {
+        close();
+    }
+
+    int32_t open(const std::string &fileName, int32_t sampleRate, int32_t framesPerBurst) {
+        close();
+        mFile = fopen(fileName.c_str(), "wb");
+        if (mFile == nullptr) {
+            return SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+        }
+        WorkloadTraceHeader header;
+        memcpy(header.magic, kWorkloadTraceMagic, sizeof(header.magic));
+        header.version = kWorkloadTraceVersion;
+        header.sampleRate = sampleRate;
+        header.framesPerBurst = framesPerBurst;
+        if (fwrite(&header, sizeof(header), 1, mFile) != 1) {
+            close();
+            return SYNTHMARK_RESULT_UNRECOVERABLE_ERROR;
+        }
+        mRing.resize(kWorkloadTraceRingCapacity);
+        mWriteIndex.store(0);
+        mReadIndex.store(0);
+        mRecordCount = 0;
+        mDroppedCount = 0;
+        mWriterEnabled.store(true);
+        mWriterThread = new HostThread();
+        if (mWriterThread->start(writerProc, this) != 0) {
+            mWriterEnabled.store(false);
+            close();
+            return SYNTHMARK_RESULT_THREAD_FAILURE;
+        }
+        return SYNTHMARK_RESULT_SUCCESS;
+    }
+
+    /**
+     * Save everything in the ring and close the file.
+     */
+    void close() {
+        if (mWriterEnabled.exchange(false)) {
+            mWriterThread->join();
+        }
+        delete mWriterThread;
+        mWriterThread = nullptr;
+        if (mFile != nullptr) {
+            fclose(mFile);
+            mFile = nullptr;
+        }
+    }
+
+    /**
+     * Only call from the render thread.
+     */
+    void write(TraceRecordType type, int32_t value, int32_t frames = 0,
+               float pitch = 0.0f, float velocity = 0.0f, int64_t nanos = 0) {
+        uint32_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        uint32_t readIndex = mReadIndex.load(std::memory_order_acquire);
+        if (writeIndex - readIndex >= (uint32_t) mRing.size()) {
+            mDroppedCount++; // the writer thread fell behind
+            return;
+        }
+        WorkloadTraceRecord &record = mRing[writeIndex % mRing.size()];
+        record.type = (uint32_t) type;
+        record.value = value;
+        record.frames = frames;
+        record.pitch = pitch;
+        record.velocity = velocity;
+        record.reserved = 0;
+        record.nanos = nanos;
+        mWriteIndex.store(writeIndex + 1, std::memory_order_release);
+    }
+
+    int64_t getRecordCount() const {
+        return mRecordCount;
+    }
+
+    int64_t getDroppedCount() const {
+        return mDroppedCount;
+    }
+
+private:
+    void writerLoop() {
+        bool enabled = true;
+        while (enabled) {
+            // Read the flag before draining so nothing is left behind when we exit.
+            enabled = mWriterEnabled.load();
+            uint32_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+            uint32_t writeIndex = mWriteIndex.load(std::memory_order_acquire);
+            while (readIndex != writeIndex) {
+                // Write the contiguous part of the ring in one call.
+                uint32_t start = readIndex % mRing.size();
+                uint32_t count = std::min(writeIndex - readIndex,
+                                          (uint32_t) mRing.size() - start);
+                mRecordCount += fwrite(&mRing[start], sizeof(WorkloadTraceRecord), count, mFile);
+                readIndex += count;
+                mReadIndex.store(readIndex, std::memory_order_release);
+            }
+            if (enabled) {
+                HostTools::sleepForNanoseconds(kWorkloadTracePollNanos);
+            }
+        }
+        fflush(mFile);
+    }
+
+    static void *writerProc(void *arg) {
+        ((WorkloadTraceWriter *) arg)->writerLoop();
+        return NULL;
+    }
+
+    FILE                            *mFile = nullptr;
+    HostThread                      *mWriterThread = nullptr;
+    std::atomic<bool>                mWriterEnabled{false};
+    std::vector<WorkloadTraceRecord> mRing;
+    std::atomic<uint32_t>            mWriteIndex{0};
+    std::atomic<uint32_t>            mReadIndex{0};
+    int64_t                          mRecordCount = 0;  // written by the writer thread
+    int64_t                          mDroppedCount = 0; // written by the render thread
+};
+
+/**
+ * Read a whole trace into memory.
+ */
+class WorkloadTraceReader
+{
+public:
+    /**
+     * @return 0 on success, or -1 with a message from getErrorText()
+     */
+    int32_t load(const std::string &fileName) {
+        mRecords.clear();
+        mBurstCount = 0;
+        FILE *file = fopen(fileName.c_str(), "rb");
+        if (file == nullptr) {
+            return fail("could not open " + fileName);
+        }
+        size_t numRead = fread(&mHeader, sizeof(mHeader), 1, file);
+        if (numRead != 1 || memcmp(mHeader.magic, kWorkloadTraceMagic, 4) != 0) {
+            fclose(file);
+            return fail(fileName + " is not a workload trace");
+        }
+        if (mHeader.version != kWorkloadTraceVersion) {
+            fclose(file);
+            return fail("unsupported trace version " + std::to_string(mHeader.version));
+        }
+        WorkloadTraceRecord record;
+        while (fread(&record, sizeof(record), 1, file) == 1) {
+            mRecords.push_back(record);
+            if (record.type == (uint32_t) TraceRecordType::Burst) {
+                mBurstCount++;
+            }
+        }
+        fclose(file);
+        if (mBurstCount == 0) {
+            return fail(fileName + " has no bursts");
+        }
+        return 0;
+    }
+
+    const WorkloadTraceHeader &getHeader() const {
+        return mHeader;
+    }
+
+    const std::vector<WorkloadTraceRecord> &getRecords() const {
+        return mRecords;
+    }
+
+    int64_t getBurstCount() const {
+        return mBurstCount;
+    }
+
+    const std::string &getErrorText() const {
+        return mErrorText;
+    }
+
+private:
+    int32_t fail(const std::string &text) {
+        mErrorText = text;
+        mRecords.clear();
+        mBurstCount = 0;
+        return -1;
+    }
+
+    WorkloadTraceHeader              mHeader = {};
+    std::vector<WorkloadTraceRecord> mRecords;
+    int64_t                          mBurstCount = 0;
+    std::string                      mErrorText;
+};
+
+#endif // SYNTHMARK_WORKLOAD_TRACE_H